@@ -0,0 +1,251 @@
+#!/usr/bin/env python3
+"""Gera as tabelas de animação da matriz 5x5 a partir dos arquivos .anim.
+
+Uso: gerar_animacoes.py <pasta de saída> <arquivo.anim>...
+
+Cada arquivo vira uma animação const (fica na flash) indexada por paleta: os quadros
+guardam só o índice da cor de cada LED, com 2 bits (até 4 cores) ou 4 bits (até 16),
+já na ordem física dos LEDs, com a correção da ligação em zigue-zague aplicada. A
+paleta vem em GRB, a ordem do fio, então o firmware só troca índice por cor.
+
+Formato do .anim (o que vem depois de '#' é comentário):
+
+    quadro_ms 500         tempo de cada quadro
+    quadros 5             número de quadros (conferido com os quadros do arquivo)
+    cor . 000000          símbolo e cor RRGGBB usados nos desenhos; a ordem das
+    cor r ff0033          cores é a ordem da paleta (índice 0, 1, ...)
+    quadro Seta           começa um quadro (o resto da linha é a descrição)
+    . . r . .             5 linhas de 5 símbolos, de cima para baixo,
+    ...                   como a matriz é vista de frente
+
+Qualquer inconsistência (contagem de quadros, linha com tamanho errado, símbolo sem
+cor, tempo inválido) interrompe a compilação com arquivo:linha da causa.
+"""
+
+import os
+import re
+import sys
+
+LADO = 5
+NUM_LEDS = LADO * LADO
+MAX_CORES = 16
+
+
+class ErroAnimacao(Exception):
+    pass
+
+
+def correcao_index(index):
+    """Mesma conversão de led_matrix.c: posição na leitura -> LED na fita."""
+    if 5 <= index < 10 or 15 <= index < 20:
+        return index + 10 if index < 10 else index - 10
+    return NUM_LEDS - index - 1
+
+
+class Animacao:
+    def __init__(self, caminho):
+        self.caminho = caminho
+        base = os.path.splitext(os.path.basename(caminho))[0]
+        if not re.fullmatch(r"[a-z][a-z0-9_]*", base):
+            raise ErroAnimacao(f"{caminho}: nome deve ser um identificador C em minúsculas")
+        self.nome = base
+        self.quadro_ms = None
+        self.num_quadros = None
+        self.cores = {}
+        self.quadros = []  # (descrição, [símbolo por posição de leitura])
+
+    def erro(self, linha, mensagem):
+        raise ErroAnimacao(f"{self.caminho}:{linha}: erro: {mensagem}")
+
+    def ler(self):
+        linhas_quadro = None
+        with open(self.caminho, encoding="utf-8") as arquivo:
+            for numero, texto in enumerate(arquivo, 1):
+                texto = texto.split("#", 1)[0].strip()
+                if not texto:
+                    continue
+                palavras = texto.split()
+                comando = palavras[0]
+                if linhas_quadro is not None and len(linhas_quadro) < LADO and comando != "quadro":
+                    if len(palavras) != LADO:
+                        self.erro(numero, f"linha do quadro com {len(palavras)} símbolos, esperado {LADO}")
+                    for simbolo in palavras:
+                        if simbolo not in self.cores:
+                            self.erro(numero, f"símbolo '{simbolo}' sem cor definida")
+                    linhas_quadro.append(palavras)
+                    continue
+                if linhas_quadro is not None and len(linhas_quadro) < LADO:
+                    self.erro(numero, f"quadro {len(self.quadros)} com só {len(linhas_quadro)} linhas")
+
+                if comando == "quadro_ms":
+                    self.quadro_ms = self.inteiro(numero, palavras, 1, 65535)
+                elif comando == "quadros":
+                    self.num_quadros = self.inteiro(numero, palavras, 1, 65535)
+                elif comando == "cor":
+                    if len(palavras) != 3 or not re.fullmatch(r"[0-9a-fA-F]{6}", palavras[2]):
+                        self.erro(numero, "uso: cor <símbolo> <RRGGBB>")
+                    if palavras[1] in self.cores:
+                        self.erro(numero, f"cor '{palavras[1]}' definida duas vezes")
+                    if len(self.cores) == MAX_CORES:
+                        self.erro(numero, f"mais de {MAX_CORES} cores na paleta")
+                    valor = int(palavras[2], 16)
+                    self.cores[palavras[1]] = ((valor >> 16) & 0xFF, (valor >> 8) & 0xFF, valor & 0xFF)
+                elif comando == "quadro":
+                    linhas_quadro = []
+                    self.quadros.append((" ".join(palavras[1:]), linhas_quadro))
+                else:
+                    self.erro(numero, f"comando desconhecido '{comando}'")
+        if self.quadros and len(self.quadros[-1][1]) < LADO:
+            self.erro("fim", f"último quadro com só {len(self.quadros[-1][1])} linhas")
+        if self.quadro_ms is None:
+            self.erro("fim", "falta quadro_ms")
+        if self.num_quadros is None:
+            self.erro("fim", "falta quadros")
+        if self.num_quadros != len(self.quadros):
+            self.erro("fim", f"declarados {self.num_quadros} quadros, mas o arquivo tem {len(self.quadros)}")
+
+    def inteiro(self, numero, palavras, minimo, maximo):
+        if len(palavras) != 2 or not palavras[1].isdigit():
+            self.erro(numero, f"uso: {palavras[0]} <número>")
+        valor = int(palavras[1])
+        if not minimo <= valor <= maximo:
+            self.erro(numero, f"{palavras[0]} fora do intervalo {minimo}..{maximo}")
+        return valor
+
+    @property
+    def bits(self):
+        return 2 if len(self.cores) <= 4 else 4
+
+    @property
+    def bytes_por_quadro(self):
+        return (NUM_LEDS * self.bits + 7) // 8
+
+    def paleta_grb(self):
+        return [(g, r, b) for (r, g, b) in self.cores.values()]
+
+    def quadro_empacotado(self, linhas):
+        """Índices de cor na ordem da fita, do bit menos significativo para o mais."""
+        indice = {simbolo: n for n, simbolo in enumerate(self.cores)}
+        fio = [0] * NUM_LEDS
+        for i, simbolo in enumerate(s for linha in linhas for s in linha):
+            fio[correcao_index(i)] = indice[simbolo]
+        empacotado = [0] * self.bytes_por_quadro
+        for i, valor in enumerate(fio):
+            bit = i * self.bits
+            empacotado[bit // 8] |= valor << (bit % 8)
+        return empacotado
+
+
+def gerar_cabecalho(animacoes):
+    saida = [
+        "// Gerado por animacoes/gerar_animacoes.py a partir de animacoes/*.anim. Não editar.",
+        "#ifndef ANIMACOES_H",
+        "#define ANIMACOES_H",
+        "",
+        "#include <stdint.h>",
+        "",
+        f"#define ANIMACAO_LEDS {NUM_LEDS}",
+        f"#define ANIMACAO_MAX_CORES {MAX_CORES}",
+        "",
+        "// Quadros indexados por paleta: o LED i do quadro q está nos bits [i*bits, i*bits + bits)",
+        "// de indices + q*bytes_por_quadro, contados a partir do bit menos significativo",
+        "typedef struct {",
+        "    const char *nome;",
+        "    const uint8_t *indices;",
+        "    const uint8_t (*paleta)[3]; // Cores em G, R, B",
+        "    uint16_t num_quadros;",
+        "    uint16_t quadro_ms;",
+        "    uint8_t bits;               // 2 ou 4",
+        "    uint8_t num_cores;",
+        "    uint8_t bytes_por_quadro;",
+        "} animacao_t;",
+    ]
+    for a in animacoes:
+        macro = "ANIM_" + a.nome.upper()
+        saida += [
+            "",
+            f"#define {macro}_QUADROS {a.num_quadros}",
+            f"#define {macro}_QUADRO_MS {a.quadro_ms}",
+            f"#define {macro}_DURACAO_MS {a.num_quadros * a.quadro_ms}",
+            f"extern const animacao_t anim_{a.nome};",
+        ]
+    saida += [
+        "",
+        "// Todas as animações, em ordem alfabética (para ferramentas que percorrem todas)",
+        f"#define NUM_ANIMACOES {len(animacoes)}",
+        "extern const animacao_t *const animacoes[NUM_ANIMACOES];",
+        "",
+        "#endif",
+        "",
+    ]
+    return "\n".join(saida)
+
+
+def gerar_fonte(animacoes):
+    saida = [
+        "// Gerado por animacoes/gerar_animacoes.py a partir de animacoes/*.anim. Não editar.",
+        '#include "animacoes.h"',
+    ]
+    for a in animacoes:
+        saida += ["", f"static const uint8_t paleta_{a.nome}[{len(a.cores)}][3] = {{"]
+        for simbolo, (g, r, b) in zip(a.cores, a.paleta_grb()):
+            saida.append(f"    {{0x{g:02X}, 0x{r:02X}, 0x{b:02X}}}, // '{simbolo}'")
+        saida += ["};", "", f"static const uint8_t indices_{a.nome}[{a.num_quadros}][{a.bytes_por_quadro}] = {{"]
+        for n, (descricao, linhas) in enumerate(a.quadros, 1):
+            titulo = f"Quadro {n}" + (f" - {descricao}" if descricao else "")
+            bytes_quadro = ", ".join(f"0x{v:02X}" for v in a.quadro_empacotado(linhas))
+            saida.append(f"    {{{bytes_quadro}}}, // {titulo}")
+        saida += [
+            "};",
+            "",
+            f"const animacao_t anim_{a.nome} = {{",
+            f"    .nome = \"{a.nome}\",",
+            f"    .indices = &indices_{a.nome}[0][0],",
+            f"    .paleta = paleta_{a.nome},",
+            f"    .num_quadros = {a.num_quadros},",
+            f"    .quadro_ms = {a.quadro_ms},",
+            f"    .bits = {a.bits},",
+            f"    .num_cores = {len(a.cores)},",
+            f"    .bytes_por_quadro = {a.bytes_por_quadro},",
+            "};",
+        ]
+    saida += ["", "const animacao_t *const animacoes[NUM_ANIMACOES] = {"]
+    saida += [f"    &anim_{a.nome}," for a in animacoes]
+    saida += ["};", ""]
+    return "\n".join(saida)
+
+
+def escrever_se_mudou(caminho, conteudo):
+    # Não mexe na data do arquivo quando nada mudou, para não recompilar à toa
+    try:
+        with open(caminho, encoding="utf-8") as arquivo:
+            if arquivo.read() == conteudo:
+                return
+    except FileNotFoundError:
+        pass
+    with open(caminho, "w", encoding="utf-8") as arquivo:
+        arquivo.write(conteudo)
+
+
+def main(argv):
+    if len(argv) < 3:
+        print(__doc__.splitlines()[2], file=sys.stderr)
+        return 2
+    pasta = argv[1]
+    try:
+        animacoes = []
+        for caminho in sorted(argv[2:]):
+            animacao = Animacao(caminho)
+            animacao.ler()
+            animacoes.append(animacao)
+    except ErroAnimacao as erro:
+        print(erro, file=sys.stderr)
+        return 1
+    os.makedirs(pasta, exist_ok=True)
+    escrever_se_mudou(os.path.join(pasta, "animacoes.h"), gerar_cabecalho(animacoes))
+    escrever_se_mudou(os.path.join(pasta, "animacoes.c"), gerar_fonte(animacoes))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
@@ -0,0 +1,667 @@
+// Benchmark do caminho de renderização e transmissão da matriz. Roda no RP2040 (alvo
+// led_matrix_benchmark, saída pela serial) e no computador (host/), com o mesmo código do
+// firmware. Cada medição sai numa linha JSON, para guardar o resultado de cada versão e
+// comparar com benchmark/comparar.py.
+#define LED_MATRIX_SEM_MAIN
+#include "led_matrix.c"
+
+#include <string.h>
+
+#if PICO_ON_DEVICE
+#include "hardware/regs/addressmap.h"
+#include "hardware/structs/systick.h"
+#include "hardware/structs/xip_ctrl.h"
+#else
+#include <time.h>
+#endif
+
+#ifndef BENCHMARK_VERSAO
+#define BENCHMARK_VERSAO "desconhecida"
+#endif
+
+#define ITERACOES 50       // Repetições de cada quadro em cada etapa
+
+// Cronômetro: no RP2040, o SysTick conta ciclos de clk_sys (24 bits, até ~134 ms a
+// 125 MHz, bem mais que uma etapa); no computador, nanossegundos do relógio monotônico.
+#if PICO_ON_DEVICE
+static void cronometro_iniciar(void) {
+    systick_hw->rvr = 0xFFFFFF;
+    systick_hw->cvr = 0;
+    systick_hw->csr = 0x5; // Habilitado, clock do processador
+}
+
+static inline uint32_t cronometro_ler(void) {
+    return systick_hw->cvr;
+}
+
+// Ciclos desde 'inicio' (o SysTick conta para baixo)
+static inline uint64_t cronometro_decorrido(uint32_t inicio) {
+    return (inicio - systick_hw->cvr) & 0xFFFFFF;
+}
+
+static double cronometro_para_us(uint64_t unidades) {
+    return unidades / (clock_get_hz(clk_sys) / 1e6);
+}
+#else
+static void cronometro_iniciar(void) {}
+
+static inline uint64_t cronometro_ler(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000u + t.tv_nsec;
+}
+
+static inline uint64_t cronometro_decorrido(uint64_t inicio) {
+    return cronometro_ler() - inicio;
+}
+
+static double cronometro_para_us(uint64_t unidades) {
+    return unidades / 1e3;
+}
+#endif
+
+// Quadros sintéticos: animações montadas na hora com o pior caso de cada coisa (todos os
+// LEDs acesos, 16 cores, valores que exercitam o dithering e o limitador de corrente)
+static uint8_t sintetico_paleta[ANIMACAO_MAX_CORES][3];
+static uint8_t sintetico_indices[3][(NUM_LEDS * 4 + 7) / 8];
+static const uint8_t paleta_branco[2][3] = {{0x00, 0x00, 0x00}, {0xFF, 0xFF, 0xFF}};
+
+static const animacao_t sintetico_branco = {
+    "sintetico_branco", sintetico_indices[0], paleta_branco, 1, 100, 2, 2, (NUM_LEDS * 2 + 7) / 8
+};
+static const animacao_t sintetico_gradiente = {
+    "sintetico_gradiente", sintetico_indices[1], sintetico_paleta, 1, 100, 4, 16, (NUM_LEDS * 4 + 7) / 8
+};
+static const animacao_t sintetico_aleatorio = {
+    "sintetico_aleatorio", sintetico_indices[2], sintetico_paleta, 1, 100, 4, 16, (NUM_LEDS * 4 + 7) / 8
+};
+
+static void sinteticos_preparar(void) {
+    uint32_t semente = 12345;
+    for (int c = 0; c < ANIMACAO_MAX_CORES; c++) {
+        semente = semente * 1103515245u + 12345u;
+        sintetico_paleta[c][0] = semente >> 24;
+        sintetico_paleta[c][1] = semente >> 16;
+        sintetico_paleta[c][2] = c * 17;
+    }
+    // Branco: índice 1 em todos os LEDs. Gradiente: as 16 cores em sequência.
+    for (int i = 0; i < NUM_LEDS; i++) {
+        sintetico_indices[0][(i * 2) >> 3] |= 1 << ((i * 2) & 7);
+        sintetico_indices[1][(i * 4) >> 3] |= (i % 16) << ((i * 4) & 7);
+        semente = semente * 1103515245u + 12345u;
+        sintetico_indices[2][(i * 4) >> 3] |= (semente >> 28) << ((i * 4) & 7);
+    }
+}
+
+// Etapas medidas. 'preparar' roda fora da medição (deixa o estado como estaria antes da
+// etapa no firmware); 'executar' é a parte cronometrada.
+typedef struct {
+    const char *nome;
+    void (*preparar)(const animacao_t *animacao, uint quadro);
+    void (*executar)(const animacao_t *animacao, uint quadro);
+} etapa_t;
+
+static double quadro_double[NUM_LEDS][3];
+static npLED16_t quadro16[NUM_LEDS];
+static volatile uint sumidouro;
+
+// Cores de um quadro no formato antigo (double de 0 a 1), para definir_intensidade
+static void preparar_double(const animacao_t *animacao, uint quadro) {
+    const uint8_t *indices = quadro_empacotado(animacao, quadro);
+    for (int i = 0; i < NUM_LEDS; i++) {
+        const uint8_t *cor = animacao->paleta[indice_cor(indices, animacao->bits, i)];
+        quadro_double[i][0] = cor[1] / 255.0;
+        quadro_double[i][1] = cor[0] / 255.0;
+        quadro_double[i][2] = cor[2] / 255.0;
+    }
+}
+
+static void preparar_nada(const animacao_t *animacao, uint quadro) {
+    (void)animacao;
+    (void)quadro;
+}
+
+// Deixa o quadro no framebuffer e espera o DMA anterior e o reset do fio, para medir só a CPU
+static void preparar_framebuffer(const animacao_t *animacao, uint quadro) {
+    carregar_quadro16(animacao, quadro, animacao->paleta, quadro16);
+    for (int i = 0; i < NUM_LEDS; i++)
+        np_desenhar(i, quadro16[i].R, quadro16[i].G, quadro16[i].B);
+    if (compositor_ativo)
+        camadas[CAMADA_FUNDO].alterada = true;
+    npPublicar(); // Para npTransmitir_dither, que manda o quadro publicado
+    dma_channel_wait_for_finish_blocking(np_dma);
+    busy_wait_until(np_livre_em);
+}
+
+static void preparar_transmissao(const animacao_t *animacao, uint quadro) {
+    (void)animacao;
+    (void)quadro;
+    dma_channel_wait_for_finish_blocking(np_dma);
+    busy_wait_until(np_livre_em);
+}
+
+static void executar_correcao_index(const animacao_t *animacao, uint quadro) {
+    (void)animacao;
+    (void)quadro;
+    uint soma = 0;
+    for (int i = 0; i < NUM_LEDS; i++)
+        soma += correcao_index(i);
+    sumidouro = soma;
+}
+
+static void __not_in_flash_func(executar_definir_intensidade)(const animacao_t *animacao, uint quadro) {
+    (void)animacao;
+    (void)quadro;
+    for (int i = 0; i < NUM_LEDS; i++)
+        definir_intensidade(i, quadro_double[i][0], quadro_double[i][1], quadro_double[i][2]);
+}
+
+static void executar_decodificar(const animacao_t *animacao, uint quadro) {
+    carregar_quadro16(animacao, quadro, animacao->paleta, quadro16);
+}
+
+static void __not_in_flash_func(executar_gerar_frame)(const animacao_t *animacao, uint quadro) {
+    gerar_frame(animacao, quadro, animacao->paleta);
+}
+
+static void __not_in_flash_func(executar_npWrite)(const animacao_t *animacao, uint quadro) {
+    (void)animacao;
+    (void)quadro;
+    npWrite();
+}
+
+static void __not_in_flash_func(executar_transmitir_dither)(const animacao_t *animacao, uint quadro) {
+    (void)animacao;
+    (void)quadro;
+    npTransmitir(true);
+}
+
+// Cada empacotador especializado, não só o do FORMATO_PIXEL: quanto custa mudar de chipset
+static pixel_grb_t destino_grb[NUM_LEDS];
+static pixel_rgb_t destino_rgb[NUM_LEDS];
+static pixel_grbw_t destino_grbw[NUM_LEDS];
+static uint8_t erro3[NUM_LEDS][3], erro4[NUM_LEDS][4];
+
+static void executar_empacotar_grb(const animacao_t *animacao, uint quadro) {
+    (void)animacao;
+    (void)quadro;
+    empacotar_grb(destino_grb, leds_hd, NUM_LEDS, escala_consumo(), erro3, true);
+}
+
+static void executar_empacotar_rgb(const animacao_t *animacao, uint quadro) {
+    (void)animacao;
+    (void)quadro;
+    empacotar_rgb(destino_rgb, leds_hd, NUM_LEDS, escala_consumo(), erro3, true);
+}
+
+static void executar_empacotar_grbw(const animacao_t *animacao, uint quadro) {
+    (void)animacao;
+    (void)quadro;
+    empacotar_grbw(destino_grbw, leds_hd, NUM_LEDS, escala_consumo(), erro4, true);
+}
+
+static const etapa_t etapas[] = {
+    {"correcao_index", preparar_nada, executar_correcao_index},
+    {"definir_intensidade", preparar_double, executar_definir_intensidade},
+    {"decodificar_paleta", preparar_nada, executar_decodificar},
+    {"gerar_frame", preparar_transmissao, executar_gerar_frame},
+    {"npWrite", preparar_framebuffer, executar_npWrite},
+    {"npTransmitir_dither", preparar_framebuffer, executar_transmitir_dither},
+    {"empacotar_grb", preparar_framebuffer, executar_empacotar_grb},
+    {"empacotar_rgb", preparar_framebuffer, executar_empacotar_rgb},
+    {"empacotar_grbw", preparar_framebuffer, executar_empacotar_grbw},
+};
+
+// Limite de quadros por segundo: a CPU e o fio trabalham em paralelo (DMA), então manda o
+// mais lento dos dois. O tempo no fio é o mesmo que o firmware espera em npTransmitir, com o
+// quadro proporcional ao número de LEDs.
+static double fps_maximo(double us_cpu, uint num_leds) {
+    double us_fio = (double)QUADRO_WS2812_US * num_leds / NUM_LEDS + RESET_WS2812_US;
+    return 1e6 / (us_cpu > us_fio ? us_cpu : us_fio);
+}
+
+static void medir(const etapa_t *etapa, const animacao_t *animacao, bool compositor) {
+    uint64_t total = 0, pior = 0;
+    uint amostras = 0;
+    for (uint q = 0; q < animacao->num_quadros; q++) {
+        for (int k = 0; k < ITERACOES; k++) {
+            etapa->preparar(animacao, q);
+            uint64_t inicio = cronometro_ler();
+            etapa->executar(animacao, q);
+            uint64_t decorrido = cronometro_decorrido(inicio);
+            total += decorrido;
+            if (decorrido > pior)
+                pior = decorrido;
+            amostras++;
+        }
+    }
+    double us = cronometro_para_us(total) / amostras;
+    printf("{\"tipo\":\"etapa\",\"etapa\":\"%s\",\"animacao\":\"%s\",\"compositor\":%s,\"leds\":%d,"
+           "\"quadros\":%u,\"amostras\":%u,\"us_por_quadro\":%.3f,\"us_pior\":%.3f,",
+           etapa->nome, animacao->nome, compositor ? "true" : "false", NUM_LEDS,
+           animacao->num_quadros, amostras, us, cronometro_para_us(pior));
+#if PICO_ON_DEVICE
+    printf("\"ciclos_por_quadro\":%.1f,", (double)total / amostras);
+#else
+    printf("\"ciclos_por_quadro\":null,");
+#endif
+    printf("\"fps_max\":%.1f}\n", fps_maximo(us, NUM_LEDS));
+}
+
+static void medir_tudo(bool compositor) {
+    const animacao_t *sinteticos[] = {&sintetico_branco, &sintetico_gradiente, &sintetico_aleatorio};
+    for (uint e = 0; e < sizeof(etapas) / sizeof(etapas[0]); e++) {
+        // Sem compositor só as etapas que dependem dele mudam; as outras não se repetem
+        if (compositor && etapas[e].executar != executar_gerar_frame && etapas[e].executar != executar_npWrite)
+            continue;
+        for (int a = 0; a < NUM_ANIMACOES; a++)
+            medir(&etapas[e], animacoes[a], compositor);
+        for (uint s = 0; s < sizeof(sinteticos) / sizeof(sinteticos[0]); s++)
+            medir(&etapas[e], sinteticos[s], compositor);
+    }
+}
+
+// Custo por LED do quadro completo (gerar_frame com o quadro aleatório), extrapolado para
+// matrizes maiores: útil para saber até onde o mesmo código aguenta sem mudar de algoritmo
+static void extrapolar(void) {
+    uint64_t total = 0;
+    for (int k = 0; k < ITERACOES; k++) {
+        preparar_transmissao(&sintetico_aleatorio, 0);
+        uint64_t inicio = cronometro_ler();
+        executar_gerar_frame(&sintetico_aleatorio, 0);
+        total += cronometro_decorrido(inicio);
+    }
+    double us_por_led = cronometro_para_us(total) / ITERACOES / NUM_LEDS;
+    static const uint tamanhos[] = {64, 256, 1024};
+    for (uint i = 0; i < sizeof(tamanhos) / sizeof(tamanhos[0]); i++) {
+        printf("{\"tipo\":\"extrapolacao\",\"etapa\":\"gerar_frame\",\"leds\":%u,\"us_por_quadro\":%.3f,"
+               "\"fps_max\":%.1f}\n",
+               tamanhos[i], us_por_led * tamanhos[i], fps_maximo(us_por_led * tamanhos[i], tamanhos[i]));
+    }
+}
+
+// Quadro completo em cada perfil de clock (clock_perfil_aplicar). Na placa, cada perfil
+// também fica JANELA_CONSUMO_S segundos com o dithering ligado, a carga normal da matriz,
+// para ler o consumo num medidor USB: o RP2040 não mede a própria corrente. Esse consumo
+// ainda não foi medido; o benchmark só mede o tempo por quadro.
+#define JANELA_CONSUMO_S 10
+
+static const etapa_t *etapa_por_nome(const char *nome) {
+    for (uint e = 0; e < sizeof(etapas) / sizeof(etapas[0]); e++)
+        if (!strcmp(etapas[e].nome, nome))
+            return &etapas[e];
+    return NULL;
+}
+
+static void medir_perfis(void) {
+    const etapa_t *medidas[] = {etapa_por_nome("gerar_frame"), etapa_por_nome("npTransmitir_dither")};
+    for (int p = 0; p < NUM_PERFIS_CLOCK; p++) {
+        if (!clock_perfil_aplicar(p)) {
+            printf("{\"tipo\":\"perfil\",\"perfil\":\"%s\",\"erro\":\"clk_sys impossivel\"}\n", perfis_clock[p].nome);
+            continue;
+        }
+        for (uint m = 0; m < sizeof(medidas) / sizeof(medidas[0]); m++) {
+            uint64_t total = 0;
+            for (int k = 0; k < ITERACOES; k++) {
+                medidas[m]->preparar(&sintetico_aleatorio, 0);
+                uint64_t inicio = cronometro_ler();
+                medidas[m]->executar(&sintetico_aleatorio, 0);
+                total += cronometro_decorrido(inicio);
+            }
+            double us = cronometro_para_us(total) / ITERACOES;
+            printf("{\"tipo\":\"perfil\",\"perfil\":\"%s\",\"clk_sys_hz\":%u,\"etapa\":\"%s\","
+                   "\"us_por_quadro\":%.3f,\"fps_max\":%.1f}\n",
+                   perfis_clock[p].nome, (uint)clock_get_hz(clk_sys), medidas[m]->nome, us, fps_maximo(us, NUM_LEDS));
+        }
+#if PICO_ON_DEVICE
+        printf("{\"tipo\":\"consumo\",\"perfil\":\"%s\",\"segundos\":%d}\n", perfis_clock[p].nome, JANELA_CONSUMO_S);
+        npSetDither(true);
+        sleep_ms(JANELA_CONSUMO_S * 1000);
+        npSetDither(false);
+#endif
+    }
+    clock_perfil_aplicar(PERFIL_NORMAL);
+}
+
+// Cache do XIP: as etapas do caminho quente com o cache como fica no laço (quente) e logo
+// depois de esvaziado (frio), como quando o USB, o lwIP ou um jogo tiraram o código delas do
+// cache. Na placa, os contadores do XIP dão os acessos à flash e a taxa de acerto por quadro;
+// o jitter é a distância entre o melhor e o pior quadro. O que mede (esta função e as
+// executar_* dessas etapas) fica sempre na SRAM, para que só o firmware mude entre uma
+// compilação com MEMORIA_SRAM=1 e outra com MEMORIA_SRAM=0.
+typedef struct {
+    uint64_t total, melhor, pior, acessos, acertos;
+    uint amostras;
+} amostras_xip_t;
+
+static void __not_in_flash_func(amostrar_xip)(const etapa_t *etapa, uint quadro, bool frio, amostras_xip_t *a) {
+    etapa->preparar(&sintetico_aleatorio, quadro);
+#if PICO_ON_DEVICE
+    if (frio) {
+        xip_ctrl_hw->flush = 1;
+        (void)xip_ctrl_hw->flush; // A leitura só volta com o cache já vazio
+    }
+    xip_ctrl_hw->ctr_hit = 0; // Qualquer escrita zera os contadores
+    xip_ctrl_hw->ctr_acc = 0;
+#endif
+    uint64_t inicio = cronometro_ler();
+    etapa->executar(&sintetico_aleatorio, quadro);
+    uint64_t decorrido = cronometro_decorrido(inicio);
+#if PICO_ON_DEVICE
+    a->acessos += xip_ctrl_hw->ctr_acc;
+    a->acertos += xip_ctrl_hw->ctr_hit;
+#endif
+    a->total += decorrido;
+    if (decorrido < a->melhor)
+        a->melhor = decorrido;
+    if (decorrido > a->pior)
+        a->pior = decorrido;
+    a->amostras++;
+}
+
+static void medir_xip(void) {
+    static const char *const nomes[] = {"definir_intensidade", "gerar_frame", "npWrite", "npTransmitir_dither"};
+    for (uint n = 0; n < sizeof(nomes) / sizeof(nomes[0]); n++) {
+        const etapa_t *etapa = etapa_por_nome(nomes[n]);
+        for (int frio = 0; frio < 2; frio++) {
+            amostras_xip_t a = {.melhor = UINT64_MAX};
+            for (uint q = 0; q < sintetico_aleatorio.num_quadros; q++)
+                for (int k = 0; k < ITERACOES; k++)
+                    amostrar_xip(etapa, q, frio, &a);
+            printf("{\"tipo\":\"xip\",\"etapa\":\"%s\",\"cache\":\"%s\",\"memoria_sram\":%d,\"compositor\":%s,"
+                   "\"amostras\":%u,\"us_por_quadro\":%.3f,\"us_melhor\":%.3f,\"us_pior\":%.3f,\"jitter_us\":%.3f,",
+                   etapa->nome, frio ? "fria" : "quente", MEMORIA_SRAM, compositor_ativo ? "true" : "false", a.amostras,
+                   cronometro_para_us(a.total) / a.amostras, cronometro_para_us(a.melhor), cronometro_para_us(a.pior),
+                   cronometro_para_us(a.pior - a.melhor));
+#if PICO_ON_DEVICE
+            printf("\"ciclos_por_quadro\":%.1f,\"xip_acessos_por_quadro\":%.1f,\"xip_acertos_pct\":%.1f}\n",
+                   (double)a.total / a.amostras, (double)a.acessos / a.amostras,
+                   a.acessos ? 100.0 * a.acertos / a.acessos : 100.0);
+#else
+            printf("\"ciclos_por_quadro\":null,\"xip_acessos_por_quadro\":null,\"xip_acertos_pct\":null}\n");
+#endif
+        }
+    }
+}
+
+// Custo de despacho da VM de scripts: cada tick de cada script, e dois piores casos que só
+// terminam o tick pelo orçamento (instruções simples e instruções que percorrem a tela). Na
+// placa, o pior tick tem que ficar bem abaixo de LIMITE_TICK_US.
+#define LIMITE_TICK_US 100
+
+static const uint8_t codigo_orcamento_simples[] = {
+    VM_SOMA, 0, 1,              // soma r0, 1
+    VM_SE_MENOR, 0x80, 0, 0, 0, // se_menor r0, 0, 0
+    VM_SALTAR, 0, 0,            // saltar 0
+};
+static const uint8_t codigo_orcamento_tela[] = {
+    VM_ROLAR, 1, 1,             // rolar 1, 1
+    VM_SALTAR, 0, 0,            // saltar 0
+};
+static const script_t script_orcamento_simples = {
+    "orcamento_simples", codigo_orcamento_simples, sizeof(codigo_orcamento_simples), paleta_branco, 2, 10, 20, 1};
+static const script_t script_orcamento_tela = {
+    "orcamento_tela", codigo_orcamento_tela, sizeof(codigo_orcamento_tela), paleta_branco, 2, 10, 20, 1};
+
+static void medir_script(const script_t *script) {
+    static vm_t vm;
+    uint64_t total = 0, pior = 0, instrucoes = 0;
+    uint amostras = 0;
+    for (int k = 0; k < ITERACOES; k++) {
+        vm_iniciar(&vm, script);
+        for (uint q = 0; q < script->num_quadros; q++) {
+            uint64_t inicio = cronometro_ler();
+            vm_tick(&vm);
+            uint64_t decorrido = cronometro_decorrido(inicio);
+            total += decorrido;
+            if (decorrido > pior)
+                pior = decorrido;
+            instrucoes += vm.instrucoes;
+            amostras++;
+        }
+    }
+    double us_pior = cronometro_para_us(pior);
+    printf("{\"tipo\":\"script\",\"script\":\"%s\",\"bytes\":%u,\"ticks\":%u,\"amostras\":%u,"
+           "\"us_por_quadro\":%.3f,\"us_pior\":%.3f,\"instrucoes_por_tick\":%.1f,",
+           script->nome, script->tamanho, script->num_quadros, amostras, cronometro_para_us(total) / amostras, us_pior,
+           (double)instrucoes / amostras);
+#if PICO_ON_DEVICE
+    printf("\"ciclos_por_quadro\":%.1f,\"ciclos_por_instrucao\":%.1f,", (double)total / amostras,
+           instrucoes ? (double)total / instrucoes : 0.0);
+#else
+    printf("\"ciclos_por_quadro\":null,\"ciclos_por_instrucao\":null,");
+#endif
+    printf("\"limite_us\":%d,\"dentro_do_limite\":%s}\n", LIMITE_TICK_US, us_pior < LIMITE_TICK_US ? "true" : "false");
+}
+
+static void medir_scripts(void) {
+    for (int s = 0; s < NUM_SCRIPTS; s++)
+        medir_script(scripts[s]);
+    medir_script(&script_orcamento_simples);
+    medir_script(&script_orcamento_tela);
+}
+
+// Modo áudio: a análise (janela, FFT de AUDIO_N pontos, faixas e ganho) e o quadro inteiro,
+// com o desenho e o envio. A carga é a fração de um núcleo ocupada a AUDIO_FPS quadros por
+// segundo; o limite é metade de um núcleo.
+#define LIMITE_CARGA_AUDIO 0.5
+
+static void medir_audio(void) {
+    static const struct {
+        const char *nome;
+        bool desenhar;
+    } medidas[] = {{"audio_analisar", false}, {"audio_quadro", true}};
+    audio_ligar();
+    for (uint m = 0; m < sizeof(medidas) / sizeof(medidas[0]); m++) {
+        uint64_t total = 0, pior = 0;
+        for (int k = 0; k < ITERACOES; k++) {
+            busy_wait_until(np_livre_em);
+            uint64_t inicio = cronometro_ler();
+            audio_analisar();
+            if (medidas[m].desenhar)
+                audio_desenhar();
+            uint64_t decorrido = cronometro_decorrido(inicio);
+            total += decorrido;
+            if (decorrido > pior)
+                pior = decorrido;
+        }
+        double us = cronometro_para_us(total) / ITERACOES;
+        double carga = us * AUDIO_FPS / 1e6;
+        printf("{\"tipo\":\"audio\",\"etapa\":\"%s\",\"pontos\":%d,\"fps\":%d,\"us_por_quadro\":%.3f,\"us_pior\":%.3f,",
+               medidas[m].nome, AUDIO_N, AUDIO_FPS, us, cronometro_para_us(pior));
+#if PICO_ON_DEVICE
+        printf("\"ciclos_por_quadro\":%.1f,", (double)total / ITERACOES);
+#else
+        printf("\"ciclos_por_quadro\":null,");
+#endif
+        printf("\"carga_cpu\":%.4f,\"limite_carga\":%.1f,\"dentro_do_limite\":%s}\n", carga, LIMITE_CARGA_AUDIO,
+               carga <= LIMITE_CARGA_AUDIO ? "true" : "false");
+    }
+    audio_desligar();
+}
+
+// Jogos: o custo de um passo (com o desenho) e o de uma tecla, que é aplicada e desenhada na
+// hora. Cada medição parte do mesmo estado, o do começo da partida, para nenhuma cair no
+// fim de jogo. A latência é o pior caso até os LEDs: a tecla mais o próximo refresh do
+// dithering e o quadro no fio; tem que caber em um quadro (JOGO_LATENCIA_LIMITE_US).
+static void medir_jogo(const jogo_def_t *def) {
+    static const char teclas[] = "4268";
+    jogo_iniciar(def);
+    const jogo_t inicial = jogo;
+    uint64_t total_passo = 0, total_tecla = 0, pior_tecla = 0;
+    for (int k = 0; k < ITERACOES; k++) {
+        jogo = inicial;
+        busy_wait_until(np_livre_em);
+        uint64_t inicio = cronometro_ler();
+        jogo.def->passo();
+        jogo_mostrar();
+        total_passo += cronometro_decorrido(inicio);
+
+        jogo = inicial;
+        busy_wait_until(np_livre_em);
+        inicio = cronometro_ler();
+        if (jogo.def->tecla(teclas[k % 4]))
+            jogo_mostrar();
+        uint64_t decorrido = cronometro_decorrido(inicio);
+        total_tecla += decorrido;
+        if (decorrido > pior_tecla)
+            pior_tecla = decorrido;
+    }
+    jogo = inicial;
+    double latencia = cronometro_para_us(pior_tecla) + 1000000.0 / TAXA_DITHER_HZ + QUADRO_WS2812_US + RESET_WS2812_US;
+    printf("{\"tipo\":\"jogo\",\"jogo\":\"%s\",\"passo_ms\":%u,\"us_por_quadro\":%.3f,\"us_por_tecla\":%.3f,", def->nome,
+           def->passo_ms, cronometro_para_us(total_passo) / ITERACOES, cronometro_para_us(total_tecla) / ITERACOES);
+#if PICO_ON_DEVICE
+    printf("\"ciclos_por_quadro\":%.1f,", (double)total_passo / ITERACOES);
+#else
+    printf("\"ciclos_por_quadro\":null,");
+#endif
+    printf("\"latencia_us\":%.1f,\"limite_latencia_us\":%d,\"dentro_do_limite\":%s}\n", latencia, JOGO_LATENCIA_LIMITE_US,
+           latencia < JOGO_LATENCIA_LIMITE_US ? "true" : "false");
+    jogo_parar();
+}
+
+static void medir_jogos(void) {
+    medir_jogo(&jogo_cobra);
+    medir_jogo(&jogo_pong);
+    medir_jogo(&jogo_blocos);
+}
+
+// Entrada pela rede: um quadro inteiro num pacote E1.31 e num DDP com push, do parser até o
+// npWrite. O número de sequência avança a cada pacote para nenhum ser descartado.
+static uint montar_pacote_rede(uint8_t *p, bool ddp) {
+    static const uint8_t cabecalho_e131[E131_CABECALHO] = {
+        [1] = 0x10, [4] = 'A', 'S', 'C', '-', 'E', '1', '.', '1', '7',
+        [16] = 0x70 | (E131_CABECALHO + REDE_CANAIS - 16) >> 8, (E131_CABECALHO + REDE_CANAIS - 16) & 0xFF,
+        [21] = E131_VETOR_DADOS, [22] = 1,
+        [38] = 0x70 | (E131_CABECALHO + REDE_CANAIS - 38) >> 8, (E131_CABECALHO + REDE_CANAIS - 38) & 0xFF,
+        [43] = E131_VETOR_QUADRO, [108] = 100, [113] = REDE_UNIVERSO >> 8, REDE_UNIVERSO & 0xFF,
+        [115] = 0x70 | (E131_CABECALHO + REDE_CANAIS - 115) >> 8, (E131_CABECALHO + REDE_CANAIS - 115) & 0xFF,
+        [117] = 0x02, 0xa1, [122] = 1, [123] = (REDE_CANAIS + 1) >> 8, (REDE_CANAIS + 1) & 0xFF};
+    uint cabecalho = ddp ? DDP_CABECALHO : E131_CABECALHO;
+    if (ddp) {
+        const uint8_t cabecalho_ddp[DDP_CABECALHO] = {DDP_VERSAO | DDP_PUSH, 1, DDP_TIPO_RGB8, DDP_ID_TELA, 0, 0, 0, REDE_DDP_OFFSET,
+                                                      REDE_CANAIS >> 8, REDE_CANAIS & 0xFF};
+        memcpy(p, cabecalho_ddp, cabecalho);
+    } else {
+        memcpy(p, cabecalho_e131, cabecalho);
+    }
+    for (uint c = 0; c < REDE_CANAIS; c++)
+        p[cabecalho + c] = c * 3;
+    return cabecalho + REDE_CANAIS;
+}
+
+static void medir_rede(void) {
+    static uint8_t pacote[E131_CABECALHO + REDE_CANAIS];
+    for (int protocolo = 0; protocolo < 2; protocolo++) {
+        bool ddp = protocolo == 1;
+        uint tamanho = montar_pacote_rede(pacote, ddp);
+        uint64_t total = 0, pior = 0;
+        uint aceitos = 0;
+        for (int k = 0; k < ITERACOES; k++) {
+            if (ddp)
+                pacote[1] = k % 15 + 1;
+            else
+                pacote[111] = k;
+            busy_wait_until(np_livre_em);
+            uint64_t inicio = cronometro_ler();
+            aceitos += rede_receber(pacote, tamanho, ddp ? DDP_PORTA : SACN_PORTA) == REDE_ACEITO;
+            uint64_t decorrido = cronometro_decorrido(inicio);
+            total += decorrido;
+            if (decorrido > pior)
+                pior = decorrido;
+        }
+        double us = cronometro_para_us(total) / ITERACOES;
+        printf("{\"tipo\":\"rede\",\"protocolo\":\"%s\",\"bytes\":%u,\"aceitos\":%u,\"us_por_quadro\":%.3f,\"us_pior\":%.3f,",
+               ddp ? "ddp" : "e131", tamanho, aceitos, us, cronometro_para_us(pior));
+#if PICO_ON_DEVICE
+        printf("\"ciclos_por_quadro\":%.1f,", (double)total / ITERACOES);
+#else
+        printf("\"ciclos_por_quadro\":null,");
+#endif
+        printf("\"pacotes_por_segundo\":%.0f}\n", us > 0 ? 1e6 / us : 0.0);
+    }
+    rede_encerrar();
+}
+
+// Quadro de boot: da chamada até o DMA começar, como no início do main (sem compositor nem
+// dithering), e até o quadro travar nos LEDs
+static void medir_boot(void) {
+    uint64_t total = 0, pior = 0;
+    for (int k = 0; k < ITERACOES; k++) {
+        busy_wait_until(np_livre_em);
+        boot_num_marcas = 0;
+        uint64_t inicio = cronometro_ler();
+        boot_quadro_mostrar();
+        uint64_t decorrido = cronometro_decorrido(inicio);
+        total += decorrido;
+        if (decorrido > pior)
+            pior = decorrido;
+    }
+    double us = cronometro_para_us(total) / ITERACOES;
+    printf("{\"tipo\":\"boot\",\"us_por_quadro\":%.3f,\"us_pior\":%.3f,", us, cronometro_para_us(pior));
+#if PICO_ON_DEVICE
+    printf("\"ciclos_por_quadro\":%.1f,", (double)total / ITERACOES);
+#else
+    printf("\"ciclos_por_quadro\":null,");
+#endif
+    printf("\"us_ate_os_leds\":%.1f}\n", us + QUADRO_WS2812_US + RESET_WS2812_US);
+    boot_num_marcas = 0;
+}
+
+static void relatar_memoria(void) {
+    size_t tabelas = 0;
+    for (int a = 0; a < NUM_ANIMACOES; a++)
+        tabelas += sizeof(animacao_t) + animacoes[a]->num_quadros * animacoes[a]->bytes_por_quadro +
+                   animacoes[a]->num_cores * 3;
+    printf("{\"tipo\":\"memoria\",\"framebuffers\":%u,\"compositor\":%u,\"player\":%u,\"tabelas_animacao\":%u,",
+           (uint)(sizeof(leds) + sizeof(leds_hd) + sizeof(np_publicado) + sizeof(erro_dither)),
+           (uint)(sizeof(camadas) + sizeof(composicao_parcial)), (uint)sizeof(player), (uint)tabelas);
+#if PICO_ON_DEVICE
+    // Plano de memória: buffers de DMA no scratch X e tabelas lidas direto da flash (XIP)
+    extern char __flash_binary_start, __flash_binary_end, __bss_end__, __scratch_x_start__, __scratch_x_end__;
+    bool tabelas_na_flash = true;
+    for (int a = 0; a < NUM_ANIMACOES; a++)
+        tabelas_na_flash = tabelas_na_flash && (uintptr_t)animacoes[a]->indices < SRAM_BASE &&
+                           (uintptr_t)animacoes[a]->paleta < SRAM_BASE;
+    printf("\"flash\":%u,\"ram_estatica\":%u,\"scratch_x\":%u,\"tabelas_na_flash\":%s}\n",
+           (uint)(&__flash_binary_end - &__flash_binary_start), (uint)((uintptr_t)&__bss_end__ - SRAM_BASE),
+           (uint)(&__scratch_x_end__ - &__scratch_x_start__), tabelas_na_flash ? "true" : "false");
+#else
+    printf("\"flash\":null,\"ram_estatica\":null,\"scratch_x\":null,\"tabelas_na_flash\":null}\n");
+#endif
+}
+
+int main() {
+    stdio_init_all();
+#if PICO_ON_DEVICE
+    sleep_ms(3000); // Tempo para abrir o terminal da USB
+#endif
+    cronometro_iniciar();
+    npInit(MATRIZ_PIN);
+    npSetDither(false); // O timer do dithering atrapalharia as medições
+    sinteticos_preparar();
+
+    printf("{\"tipo\":\"inicio\",\"versao\":\"%s\",\"plataforma\":\"%s\",\"clk_sys_hz\":%u,\"iteracoes\":%d}\n",
+           BENCHMARK_VERSAO, PICO_ON_DEVICE ? "rp2040" : "host", (uint)clock_get_hz(clk_sys), ITERACOES);
+    relatar_memoria();
+    medir_boot();
+    medir_tudo(false);
+    compositor_ativar();
+    camada_configurar(CAMADA_INTERFACE, MISTURA_NORMAL, 255, true);
+    medir_tudo(true);
+    extrapolar();
+    medir_xip();
+    medir_scripts();
+    medir_audio();
+    medir_jogos();
+    medir_rede();
+    medir_perfis();
+    printf("{\"tipo\":\"fim\"}\n");
+
+#if PICO_ON_DEVICE
+    while (true)
+        __wfi();
+#endif
+    return 0;
+}
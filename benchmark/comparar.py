@@ -0,0 +1,103 @@
+#!/usr/bin/env python3
+"""Compara duas saídas do benchmark (linhas JSON) e aponta regressões.
+
+Uso: comparar.py <base.jsonl> <nova.jsonl> [--limiar 10]
+
+Compara cada etapa/animação (e o tick de cada script da VM, o quadro do modo áudio, o
+passo de cada jogo, o pacote de cada protocolo de rede, o quadro de boot e as etapas com o
+cache do XIP quente e frio) pelos ciclos por quadro quando as duas saídas vieram da placa, ou
+pelo tempo por quadro no host. Sai com código 1 se alguma medição piorou mais que o limiar
+(em %), para poder rodar em CI. Para as medições do XIP também mostra o jitter e a taxa de
+acerto do cache, por exemplo entre uma compilação com MEMORIA_SRAM=0 e outra com 1.
+"""
+
+import argparse
+import json
+import sys
+
+
+def carregar(caminho):
+    medicoes = {}
+    info = {}
+    with open(caminho, encoding="utf-8") as arquivo:
+        for linha in arquivo:
+            linha = linha.strip()
+            if not linha.startswith("{"):
+                continue  # Mensagens de boot ou do terminal misturadas na serial
+            dado = json.loads(linha)
+            if dado["tipo"] == "etapa":
+                medicoes[(dado["etapa"], dado["animacao"], dado["compositor"])] = dado
+            elif dado["tipo"] == "script":
+                medicoes[("vm_tick", dado["script"], False)] = dado
+            elif dado["tipo"] == "audio":
+                medicoes[(dado["etapa"], f"fft{dado['pontos']}", False)] = dado
+            elif dado["tipo"] == "jogo":
+                medicoes[("jogo_passo", dado["jogo"], False)] = dado
+            elif dado["tipo"] == "rede":
+                medicoes[("rede_pacote", dado["protocolo"], False)] = dado
+            elif dado["tipo"] == "boot":
+                medicoes[("quadro_de_boot", "-", False)] = dado
+            elif dado["tipo"] == "xip":
+                medicoes[(dado["etapa"], f"cache_{dado['cache']}", dado["compositor"])] = dado
+            elif dado["tipo"] in ("inicio", "memoria"):
+                info.update(dado)
+    return info, medicoes
+
+
+def custo(medicao):
+    if medicao.get("ciclos_por_quadro") is not None:
+        return medicao["ciclos_por_quadro"], "ciclos"
+    return medicao["us_por_quadro"], "us"
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("base")
+    parser.add_argument("nova")
+    parser.add_argument("--limiar", type=float, default=10.0, help="piora máxima aceita, em %%")
+    args = parser.parse_args()
+
+    info_base, base = carregar(args.base)
+    info_nova, nova = carregar(args.nova)
+    if info_base.get("plataforma") != info_nova.get("plataforma"):
+        print("aviso: comparando plataformas diferentes", file=sys.stderr)
+
+    regressoes = 0
+    print(f"{'etapa':22} {'animacao':22} {'comp':5} {'base':>10} {'nova':>10} {'dif':>8}")
+    for chave in sorted(base.keys() & nova.keys()):
+        (valor_base, unidade), (valor_novo, _) = custo(base[chave]), custo(nova[chave])
+        diferenca = (valor_novo - valor_base) / valor_base * 100 if valor_base else 0.0
+        marca = ""
+        if diferenca > args.limiar:
+            marca = "  <- regressão"
+            regressoes += 1
+        etapa, animacao, compositor = chave
+        print(f"{etapa:22} {animacao:22} {'sim' if compositor else 'não':5} "
+              f"{valor_base:10.2f} {valor_novo:10.2f} {diferenca:+7.1f}%{marca}")
+
+    xip = [chave for chave in sorted(base.keys() & nova.keys()) if base[chave]["tipo"] == "xip"]
+    if xip:
+        print(f"\n{'etapa (XIP)':22} {'cache':22} {'jitter base':>12} {'nova':>8} {'acertos base':>13} {'nova':>8}")
+    for chave in xip:
+        b, n = base[chave], nova[chave]
+        acertos = [f"{m['xip_acertos_pct']:.1f}%" if m.get("xip_acertos_pct") is not None else "-" for m in (b, n)]
+        print(f"{chave[0]:22} {chave[1]:22} {b['jitter_us']:10.3f}us {n['jitter_us']:6.3f}us "
+              f"{acertos[0]:>13} {acertos[1]:>8}")
+
+    for campo in ("flash", "ram_estatica", "scratch_x", "framebuffers", "compositor", "player", "tabelas_animacao"):
+        a, b = info_base.get(campo), info_nova.get(campo)
+        if a is not None and b is not None and a != b:
+            print(f"memória {campo}: {a} -> {b} bytes ({b - a:+d})")
+
+    if info_nova.get("tabelas_na_flash") is False:
+        print("aviso: tabelas de animação fora da flash na nova", file=sys.stderr)
+
+    faltando = base.keys() - nova.keys()
+    if faltando:
+        print(f"{len(faltando)} medições da base não aparecem na nova", file=sys.stderr)
+    print(f"{regressoes} regressões acima de {args.limiar:g}%")
+    return 1 if regressoes else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
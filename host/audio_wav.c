@@ -0,0 +1,268 @@
+// Modo áudio no computador: passa um WAV (ou tons sintéticos) pelo mesmo caminho do
+// firmware. As amostras entram pelo ADC simulado, o DMA as escreve no anel no tempo
+// virtual, e audio_tick faz a FFT, as faixas e o desenho da matriz. A saída mostra a altura
+// de cada coluna quadro a quadro.
+//
+//   led_matrix_audio arquivo.wav [--ganho g] [--ppm arquivo] [--silencioso]
+//   led_matrix_audio --tom Hz [--segundos s] [--ganho g] [--ppm arquivo]
+//   led_matrix_audio --conferir
+//
+// Com --conferir, um tom no centro de cada faixa tem que deixar a coluna dela como a mais
+// alta, e o silêncio tem que deixar a matriz apagada; sai com erro se não.
+#define LED_MATRIX_SEM_MAIN
+#include "led_matrix.c"
+
+#include <string.h>
+#include <time.h>
+
+#include "pico_host.h"
+
+#define MAX_QUADROS 20000
+
+static float *sinal;      // Amostras já em AUDIO_FS, de -1 a 1
+static uint64_t num_amostras;
+static float ganho = 1.f;
+
+static uint16_t amostrar(uint canal, uint64_t indice) {
+    if (canal != MIC_ADC || indice >= num_amostras)
+        return 2048;
+    float v = sinal[indice] * ganho;
+    v = v > 1.f ? 1.f : v < -1.f ? -1.f : v;
+    return (uint16_t)lroundf(2048.f + v * 2047.f);
+}
+
+// Quadros que chegaram aos LEDs, para a tira PPM
+static npLED_t quadros[MAX_QUADROS][NUM_LEDS];
+static uint num_quadros;
+
+static void capturar(PIO pio, uint maquina, const void *dados, uint quantidade, uint tamanho_palavra, absolute_time_t instante) {
+    (void)instante;
+    if (pio != np_pio || maquina != sm || tamanho_palavra != 1 || quantidade != sizeof(leds) || num_quadros == MAX_QUADROS)
+        return;
+    memcpy(quadros[num_quadros++], dados, sizeof(leds));
+}
+
+static uint16_t le16(const uint8_t *p) { return p[0] | p[1] << 8; }
+static uint32_t le32(const uint8_t *p) { return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24; }
+
+// Lê um WAV PCM de 8 ou 16 bits (mono ou estéreo, qualquer taxa) e converte para mono em
+// AUDIO_FS por interpolação linear
+static bool ler_wav(const char *caminho) {
+    FILE *f = fopen(caminho, "rb");
+    if (!f) {
+        perror(caminho);
+        return false;
+    }
+    fseek(f, 0, SEEK_END);
+    long tamanho = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint8_t *dados = malloc(tamanho);
+    if (!dados || fread(dados, 1, tamanho, f) != (size_t)tamanho || tamanho < 12 ||
+        memcmp(dados, "RIFF", 4) || memcmp(dados + 8, "WAVE", 4)) {
+        fprintf(stderr, "%s: não é um arquivo WAV\n", caminho);
+        fclose(f);
+        free(dados);
+        return false;
+    }
+    fclose(f);
+
+    uint canais = 0, taxa = 0, bits = 0;
+    const uint8_t *pcm = NULL;
+    uint32_t bytes_pcm = 0;
+    for (long p = 12; p + 8 <= tamanho;) {
+        uint32_t tamanho_bloco = le32(dados + p + 4);
+        if (p + 8 + (long)tamanho_bloco > tamanho)
+            tamanho_bloco = (uint32_t)(tamanho - p - 8);
+        if (!memcmp(dados + p, "fmt ", 4) && tamanho_bloco >= 16) {
+            if (le16(dados + p + 8) != 1) {
+                fprintf(stderr, "%s: só PCM sem compressão\n", caminho);
+                free(dados);
+                return false;
+            }
+            canais = le16(dados + p + 10);
+            taxa = le32(dados + p + 12);
+            bits = le16(dados + p + 22);
+        } else if (!memcmp(dados + p, "data", 4)) {
+            pcm = dados + p + 8;
+            bytes_pcm = tamanho_bloco;
+        }
+        p += 8 + tamanho_bloco + (tamanho_bloco & 1);
+    }
+    if (!pcm || !canais || !taxa || (bits != 8 && bits != 16)) {
+        fprintf(stderr, "%s: WAV sem formato suportado (PCM de 8 ou 16 bits)\n", caminho);
+        free(dados);
+        return false;
+    }
+
+    uint64_t quadros_wav = bytes_pcm / (canais * bits / 8);
+    num_amostras = quadros_wav * AUDIO_FS / taxa;
+    sinal = malloc(num_amostras * sizeof(float));
+    for (uint64_t i = 0; i < num_amostras; i++) {
+        double posicao = (double)i * taxa / AUDIO_FS;
+        uint64_t a = (uint64_t)posicao;
+        uint64_t b = a + 1 < quadros_wav ? a + 1 : a;
+        float v[2] = {0.f, 0.f};
+        for (uint64_t q = 0; q < 2; q++) {
+            uint64_t quadro = q ? b : a;
+            for (uint c = 0; c < canais; c++) {
+                const uint8_t *amostra = pcm + (quadro * canais + c) * (bits / 8);
+                v[q] += bits == 16 ? (int16_t)le16(amostra) / 32768.f : (amostra[0] - 128) / 128.f;
+            }
+            v[q] /= canais;
+        }
+        sinal[i] = v[0] + (v[1] - v[0]) * (float)(posicao - a);
+    }
+    free(dados);
+    printf("%s: %u Hz, %u canais, %u bits, %.2f s\n", caminho, taxa, canais, bits, (double)num_amostras / AUDIO_FS);
+    return true;
+}
+
+static void gerar_tom(float frequencia, float segundos, float amplitude) {
+    free(sinal);
+    num_amostras = (uint64_t)(segundos * AUDIO_FS);
+    sinal = malloc(num_amostras * sizeof(float));
+    for (uint64_t i = 0; i < num_amostras; i++)
+        sinal[i] = frequencia > 0.f ? amplitude * sinf(DOIS_PI * frequencia * i / AUDIO_FS) : 0.f;
+}
+
+static double relogio_us(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e6 + t.tv_nsec / 1e3;
+}
+
+// Toca o sinal inteiro no modo áudio do firmware; devolve o tempo de CPU médio por quadro
+static double tocar(bool mostrar) {
+    num_quadros = 0;
+    double cpu = 0.0;
+    absolute_time_t fim = delayed_by_us(get_absolute_time(), num_amostras * 1000000 / AUDIO_FS);
+    audio_ligar();
+    absolute_time_t inicio = get_absolute_time();
+    while (absolute_time_diff_us(get_absolute_time(), fim) > 0) {
+        absolute_time_t prazo = fim;
+        uint32_t antes = audio.quadros;
+        double t0 = relogio_us();
+        audio_tick(&prazo);
+        cpu += relogio_us() - t0;
+        if (mostrar && audio.quadros != antes) {
+            printf("%8.1f ms ", absolute_time_diff_us(inicio, get_absolute_time()) / 1000.0);
+            for (int x = 0; x < NUM_COLUNAS; x++)
+                printf(" %4.2f", audio.altura[x] / 256.0);
+            printf("   niveis");
+            for (int x = 0; x < NUM_COLUNAS; x++)
+                printf(" %5.2f", audio.nivel[x] / 16.0);
+            printf("\n");
+        }
+        best_effort_wfe_or_timeout(prazo);
+    }
+    uint32_t total = audio.quadros;
+    audio_desligar();
+    return total ? cpu / total : 0.0;
+}
+
+// Tira PPM com todos os quadros, como no renderizador
+static bool escrever_ppm(const char *caminho) {
+    FILE *f = fopen(caminho, "wb");
+    if (!f)
+        return false;
+    const uint escala = 4, largura_quadro = 5 * escala + 1;
+    uint largura = num_quadros * largura_quadro, altura = 5 * escala;
+    fprintf(f, "P6\n%u %u\n255\n", largura ? largura : 1, altura);
+    for (uint y = 0; y < altura; y++) {
+        for (uint x = 0; x < largura; x++) {
+            uint coluna = x % largura_quadro;
+            uint8_t rgb[3] = {64, 64, 64};
+            if (coluna < 5 * escala) {
+                const npLED_t *px = &quadros[x / largura_quadro][correcao_index((y / escala) * 5 + coluna / escala)];
+                rgb[0] = px->R;
+                rgb[1] = px->G;
+                rgb[2] = px->B;
+            }
+            fwrite(rgb, 1, 3, f);
+        }
+    }
+    if (!largura)
+        fwrite("\0\0\0", 1, 3, f);
+    return fclose(f) == 0;
+}
+
+// Um tom no centro (geométrico) de cada faixa deixa a coluna dela como a mais alta; o
+// silêncio deixa tudo apagado
+static int conferir(void) {
+    int falhas = 0;
+    for (int x = 0; x < NUM_COLUNAS; x++) {
+        float centro = sqrtf((float)audio_faixas[x] * audio_faixas[x + 1]) * AUDIO_FS / AUDIO_N;
+        gerar_tom(centro, 1.f, 0.5f);
+        tocar(false);
+        int maior = 0;
+        for (int c = 1; c < NUM_COLUNAS; c++)
+            if (audio.altura[c] > audio.altura[maior])
+                maior = c;
+        bool ok = maior == x && audio.altura[x] >= 4 * 256;
+        printf("tom de %6.0f Hz: coluna %d com %.2f linhas (esperada %d, cheia) %s\n", centro, maior,
+               audio.altura[maior] / 256.0, x, ok ? "ok" : "ERRO");
+        falhas += !ok;
+    }
+    gerar_tom(0.f, 1.f, 0.f);
+    tocar(false);
+    bool apagado = true;
+    for (int x = 0; x < NUM_COLUNAS; x++)
+        apagado = apagado && audio.altura[x] == 0;
+    printf("silêncio: %s %s\n", apagado ? "matriz apagada" : "colunas acesas", apagado ? "ok" : "ERRO");
+    falhas += !apagado;
+    printf("audio: %s\n", falhas ? "ERRO" : "ok");
+    return falhas ? 1 : 0;
+}
+
+int main(int argc, char **argv) {
+    const char *wav = NULL, *ppm = NULL;
+    float tom = -1.f, segundos = 2.f;
+    bool modo_conferir = false, mostrar = true;
+    for (int a = 1; a < argc; a++) {
+        if (!strcmp(argv[a], "--tom") && a + 1 < argc) {
+            tom = (float)atof(argv[++a]);
+        } else if (!strcmp(argv[a], "--segundos") && a + 1 < argc) {
+            segundos = (float)atof(argv[++a]);
+        } else if (!strcmp(argv[a], "--ganho") && a + 1 < argc) {
+            ganho = (float)atof(argv[++a]);
+        } else if (!strcmp(argv[a], "--ppm") && a + 1 < argc) {
+            ppm = argv[++a];
+        } else if (!strcmp(argv[a], "--silencioso")) {
+            mostrar = false;
+        } else if (!strcmp(argv[a], "--conferir")) {
+            modo_conferir = true;
+        } else if (argv[a][0] != '-' && !wav) {
+            wav = argv[a];
+        } else {
+            fprintf(stderr, "uso: %s arquivo.wav | --tom Hz [--segundos s] | --conferir  [--ganho g] [--ppm arquivo] [--silencioso]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    host_ao_amostrar_adc = amostrar;
+    host_ao_transmitir = capturar;
+    npInit(MATRIZ_PIN);
+    npSetDither(false);
+
+    if (modo_conferir)
+        return conferir();
+    if (wav) {
+        if (!ler_wav(wav))
+            return 1;
+    } else if (tom >= 0.f) {
+        gerar_tom(tom, segundos, 0.5f);
+    } else {
+        fprintf(stderr, "%s: informe um WAV, --tom ou --conferir\n", argv[0]);
+        return 2;
+    }
+    if (mostrar)
+        printf("   tempo   colunas (linhas acesas)          niveis (log2 da energia)\n");
+    double cpu = tocar(mostrar);
+    printf("%u quadros em %.2f s (%.1f fps), %.1f us de CPU do computador por quadro\n", num_quadros,
+           (double)num_amostras / AUDIO_FS, num_quadros * (double)AUDIO_FS / (num_amostras ? num_amostras : 1), cpu);
+    if (ppm && !escrever_ppm(ppm)) {
+        perror(ppm);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,197 @@
+// Emulador ciclo a ciclo de uma máquina de estado PIO (ver emulador_pio.h).
+// Referência: seção 3.4 (instruções) e 3.5.4 (autopull) do datasheet do RP2040.
+#include "emulador_pio.h"
+
+#include <string.h>
+
+void emulador_pio_iniciar(emulador_pio_t *e, const pio_program_t *programa, uint offset,
+                          const pio_sm_config *config, uint pc_inicial) {
+    memset(e, 0, sizeof(*e));
+    if (offset + programa->length > PIO_INSTRUCTION_COUNT)
+        panic("emulador_pio: programa não cabe no offset %u", offset);
+    for (uint i = 0; i < programa->length; i++) {
+        uint16_t instrucao = programa->instructions[i];
+        // Como pio_add_program: o endereço de um jmp é relativo ao início do programa
+        if ((instrucao >> 13) == 0)
+            instrucao += offset;
+        e->memoria[offset + i] = instrucao;
+    }
+    e->config = *config;
+
+    // Mesmo arredondamento do SDK ao converter o float para INT.FRAC
+    if (config->clkdiv < 1.f || config->clkdiv >= 65536.f)
+        panic("emulador_pio: divisor de clock fora da faixa: %f", (double)config->clkdiv);
+    e->div_inteiro = (uint32_t)config->clkdiv;
+    e->div_fracao = (uint32_t)((config->clkdiv - (float)e->div_inteiro) * 256.f);
+
+    e->pc = pc_inicial;
+    e->osr_contagem = 32; // OSR começa vazio
+}
+
+bool emulador_pio_escrever(emulador_pio_t *e, uint32_t palavra) {
+    if (e->fifo_tamanho == EMULADOR_FIFO)
+        return false;
+    e->fifo[(e->fifo_inicio + e->fifo_tamanho++) % EMULADOR_FIFO] = palavra;
+    return true;
+}
+
+static bool fifo_retirar(emulador_pio_t *e, uint32_t *palavra) {
+    if (!e->fifo_tamanho)
+        return false;
+    *palavra = e->fifo[e->fifo_inicio];
+    e->fifo_inicio = (e->fifo_inicio + 1) % EMULADOR_FIFO;
+    e->fifo_tamanho--;
+    return true;
+}
+
+static void escrever_pinos(emulador_pio_t *e, uint base, uint quantidade, uint32_t valor) {
+    for (uint i = 0; i < quantidade; i++) {
+        uint pino = (base + i) % 32;
+        e->pinos = (e->pinos & ~(1u << pino)) | (((valor >> i) & 1u) << pino);
+    }
+}
+
+static uint32_t inverter_bits(uint32_t v) {
+    uint32_t r = 0;
+    for (int i = 0; i < 32; i++, v >>= 1)
+        r = (r << 1) | (v & 1);
+    return r;
+}
+
+// Executa a instrução em pc; devolve false se ela ficou parada
+static bool executar(emulador_pio_t *e) {
+    const pio_sm_config *c = &e->config;
+    uint16_t instrucao = e->memoria[e->pc];
+    uint opcode = instrucao >> 13;
+    uint campo = (instrucao >> 8) & 31;
+    uint destino = (instrucao >> 5) & 7;
+    uint argumento = instrucao & 31;
+
+    // Side-set vale já no primeiro ciclo, mesmo que a instrução fique parada
+    uint bits_lateral = c->sideset_bits;
+    uint atraso = campo & ((1u << (5 - bits_lateral)) - 1);
+    if (bits_lateral) {
+        uint lateral = campo >> (5 - bits_lateral);
+        uint bits_valor = bits_lateral;
+        bool aplicar = true;
+        if (c->sideset_opcional) {
+            bits_valor--;
+            aplicar = (lateral >> bits_valor) & 1;
+            lateral &= (1u << bits_valor) - 1;
+        }
+        if (aplicar && !c->sideset_pindirs)
+            escrever_pinos(e, c->sideset_base, bits_valor, lateral);
+    }
+
+    bool saltou = false;
+    switch (opcode) {
+    case 0: { // jmp
+        bool condicao;
+        switch (destino) {
+        case 0: condicao = true; break;
+        case 1: condicao = e->x == 0; break;
+        case 2: condicao = e->x != 0; e->x--; break;
+        case 3: condicao = e->y == 0; break;
+        case 4: condicao = e->y != 0; e->y--; break;
+        case 5: condicao = e->x != e->y; break;
+        case 7: condicao = e->osr_contagem < c->pull_threshold; break;
+        default: panic("emulador_pio: jmp pin não suportado (pc %u)", e->pc);
+        }
+        if (condicao) {
+            e->pc = argumento;
+            saltou = true;
+        }
+        break;
+    }
+    case 3: { // out
+        uint quantidade = argumento ? argumento : 32;
+        if (c->autopull && e->osr_contagem >= c->pull_threshold) {
+            if (!fifo_retirar(e, &e->osr))
+                return false;
+            e->osr_contagem = 0;
+        }
+        uint32_t dados;
+        if (c->out_shift_right) {
+            dados = quantidade == 32 ? e->osr : e->osr & ((1u << quantidade) - 1);
+            e->osr = quantidade == 32 ? 0 : e->osr >> quantidade;
+        } else {
+            dados = e->osr >> (32 - quantidade);
+            e->osr = quantidade == 32 ? 0 : e->osr << quantidade;
+        }
+        e->osr_contagem = e->osr_contagem + quantidade > 32 ? 32 : e->osr_contagem + quantidade;
+        switch (destino) {
+        case 0: escrever_pinos(e, c->out_base, quantidade, dados); break;
+        case 1: e->x = dados; break;
+        case 2: e->y = dados; break;
+        case 3: break;
+        case 4: break; // pindirs: direção dos pinos não é modelada
+        case 5: e->pc = dados & 31; saltou = true; break;
+        case 6: e->isr = dados; break;
+        default: panic("emulador_pio: out exec não suportado (pc %u)", e->pc);
+        }
+        break;
+    }
+    case 5: { // mov (nop é mov y, y)
+        uint32_t origem;
+        switch (argumento & 7) {
+        case 0: origem = c->in_base ? e->pinos >> c->in_base | e->pinos << (32 - c->in_base) : e->pinos; break;
+        case 1: origem = e->x; break;
+        case 2: origem = e->y; break;
+        case 3: origem = 0; break;
+        case 6: origem = e->isr; break;
+        case 7: origem = e->osr; break;
+        default: panic("emulador_pio: mov de STATUS não suportado (pc %u)", e->pc);
+        }
+        uint operacao = (argumento >> 3) & 3;
+        if (operacao == 1)
+            origem = ~origem;
+        else if (operacao == 2)
+            origem = inverter_bits(origem);
+        switch (destino) {
+        case 0: escrever_pinos(e, c->out_base, c->out_count, origem); break;
+        case 1: e->x = origem; break;
+        case 2: e->y = origem; break;
+        case 5: e->pc = origem & 31; saltou = true; break;
+        case 6: e->isr = origem; break;
+        case 7: e->osr = origem; e->osr_contagem = 0; break;
+        default: panic("emulador_pio: mov exec não suportado (pc %u)", e->pc);
+        }
+        break;
+    }
+    case 7: // set
+        switch (destino) {
+        case 0: escrever_pinos(e, c->set_base, c->set_count, argumento); break;
+        case 1: e->x = argumento; break;
+        case 2: e->y = argumento; break;
+        case 4: break;
+        default: panic("emulador_pio: destino de set inválido (pc %u)", e->pc);
+        }
+        break;
+    default:
+        panic("emulador_pio: instrução 0x%04x não suportada (pc %u)", instrucao, e->pc);
+    }
+
+    if (!saltou)
+        e->pc = e->pc == c->wrap ? c->wrap_target : (e->pc + 1) % PIO_INSTRUCTION_COUNT;
+    e->atraso = atraso;
+    return true;
+}
+
+uint emulador_pio_ciclo(emulador_pio_t *e) {
+    // Divisor fracionário: alguns ciclos da máquina duram um ciclo de clk_sys a mais, de
+    // forma que a média seja INT + FRAC/256
+    uint ciclos = e->div_inteiro;
+    e->acumulador += e->div_fracao;
+    if (e->acumulador >= 256) {
+        e->acumulador -= 256;
+        ciclos++;
+    }
+    e->ciclos_sys += ciclos;
+
+    if (e->atraso) {
+        e->atraso--;
+        return ciclos;
+    }
+    e->parada = !executar(e);
+    return ciclos;
+}
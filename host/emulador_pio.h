@@ -0,0 +1,45 @@
+// Emulador ciclo a ciclo de uma máquina de estado PIO, para conferir no computador a forma
+// de onda que um programa gera. Cobre o que os programas deste projeto usam: jmp, out, mov
+// (e nop), set, side-set, atrasos, autopull e wrap, com o divisor de clock fracionário do
+// RP2040 (16.8 bits). Não cobre in/push/pull/irq/wait nem pinos de entrada.
+#ifndef EMULADOR_PIO_H
+#define EMULADOR_PIO_H
+
+#include "hardware/pio.h"
+
+#define EMULADOR_FIFO 8 // FIFO TX juntada (PIO_FIFO_JOIN_TX)
+
+typedef struct {
+    uint16_t memoria[PIO_INSTRUCTION_COUNT];
+    pio_sm_config config;
+    uint32_t div_inteiro, div_fracao; // Divisor como no registrador CLKDIV
+
+    uint pc;
+    uint32_t x, y, osr, isr;
+    uint osr_contagem; // Bits já deslocados do OSR (>= limiar: vazio)
+    uint atraso;       // Ciclos de atraso restantes da última instrução
+    bool parada;       // Última instrução ficou parada (FIFO vazia)
+    uint32_t pinos;
+
+    uint32_t fifo[EMULADOR_FIFO];
+    uint fifo_inicio, fifo_tamanho;
+
+    uint64_t ciclos_sys; // Tempo decorrido em ciclos de clk_sys
+    uint32_t acumulador; // Resto do divisor fracionário
+} emulador_pio_t;
+
+// Carrega o programa em 'offset' (com os endereços de jmp relocados, como pio_add_program)
+// e prepara a máquina para começar em 'pc_inicial' com a configuração dada
+void emulador_pio_iniciar(emulador_pio_t *e, const pio_program_t *programa, uint offset,
+                          const pio_sm_config *config, uint pc_inicial);
+
+// Põe uma palavra na FIFO TX; false se estiver cheia
+bool emulador_pio_escrever(emulador_pio_t *e, uint32_t palavra);
+
+// Executa um ciclo da máquina e devolve quantos ciclos de clk_sys ele durou
+uint emulador_pio_ciclo(emulador_pio_t *e);
+
+// Nível atual de um pino (escrito por side-set, set ou out)
+static inline bool emulador_pio_pino(const emulador_pio_t *e, uint pino) { return (e->pinos >> pino) & 1; }
+
+#endif
@@ -0,0 +1,23 @@
+// Substituto de "hardware/adc.h" para o build no computador. Enquanto roda (adc_run), o ADC
+// converte no ritmo dado por adc_set_clkdiv e as amostras vêm de host_ao_amostrar_adc
+// (pico_host.h); só o caminho FIFO -> DMA é simulado, que é o que o firmware usa.
+#ifndef HOST_HARDWARE_ADC_H
+#define HOST_HARDWARE_ADC_H
+
+#include "pico/stdlib.h"
+
+typedef struct {
+    volatile uint32_t cs, result, fcs, fifo, div, intr, inte, intf, ints;
+} adc_hw_t;
+
+extern adc_hw_t *const adc_hw;
+
+void adc_init(void);
+void adc_gpio_init(uint gpio);
+void adc_select_input(uint input);
+void adc_set_clkdiv(float clkdiv);
+void adc_fifo_setup(bool en, bool dreq_en, uint16_t dreq_thresh, bool err_in_fifo, bool byte_shift);
+void adc_run(bool run);
+static inline void adc_fifo_drain(void) {}
+
+#endif
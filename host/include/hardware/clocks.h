@@ -0,0 +1,20 @@
+// Substituto de "hardware/clocks.h" para o build no computador.
+#ifndef HOST_HARDWARE_CLOCKS_H
+#define HOST_HARDWARE_CLOCKS_H
+
+#include "pico/stdlib.h"
+
+enum clock_index { clk_gpout0 = 0, clk_gpout1, clk_gpout2, clk_gpout3, clk_ref, clk_sys, clk_peri, clk_usb, clk_adc, clk_rtc, CLK_COUNT };
+
+#define KHZ 1000
+#define MHZ 1000000
+#define CLOCKS_CLK_PERI_CTRL_AUXSRC_VALUE_CLK_SYS 0x0
+#define CLOCKS_CLK_PERI_CTRL_AUXSRC_VALUE_CLKSRC_PLL_USB 0x2
+
+uint32_t clock_get_hz(enum clock_index clk_index);
+
+// Muda host_clk_sys_hz; recusa, como o SDK, frequências que o PLL de 12 MHz não gera
+bool set_sys_clock_khz(uint32_t freq_khz, bool required);
+bool clock_configure(enum clock_index clk_index, uint32_t src, uint32_t auxsrc, uint32_t src_freq, uint32_t freq);
+
+#endif
@@ -0,0 +1,75 @@
+// Substituto de "hardware/dma.h" para o build no computador. Uma transferência termina no
+// instante em que é disparada; as que vão para a FIFO TX de uma PIO são entregues a
+// host_ao_transmitir, as demais são ignoradas. A exceção são os canais ritmados pelo ADC:
+// eles escrevem as amostras no tempo virtual, e dma_channel_hw_addr mostra até onde foram.
+#ifndef HOST_HARDWARE_DMA_H
+#define HOST_HARDWARE_DMA_H
+
+#include "pico/stdlib.h"
+
+#define NUM_DMA_CHANNELS 12
+#define NUM_DMA_TIMERS 4
+#define DREQ_ADC 36
+
+enum dma_channel_transfer_size { DMA_SIZE_8 = 0, DMA_SIZE_16 = 1, DMA_SIZE_32 = 2 };
+
+typedef struct {
+    enum dma_channel_transfer_size tamanho;
+    bool incrementa_leitura, incrementa_escrita;
+    uint dreq;
+    uint encadear_com;
+    uint anel_bits;
+    bool anel_escrita;
+    bool irq_silenciosa;
+} dma_channel_config;
+
+static inline dma_channel_config dma_channel_get_default_config(uint channel) {
+    dma_channel_config c = {DMA_SIZE_32, true, false, 0x3f, channel, 0, false, false};
+    return c;
+}
+static inline void channel_config_set_transfer_data_size(dma_channel_config *c, enum dma_channel_transfer_size size) { c->tamanho = size; }
+static inline void channel_config_set_read_increment(dma_channel_config *c, bool incr) { c->incrementa_leitura = incr; }
+static inline void channel_config_set_write_increment(dma_channel_config *c, bool incr) { c->incrementa_escrita = incr; }
+static inline void channel_config_set_dreq(dma_channel_config *c, uint dreq) { c->dreq = dreq; }
+static inline void channel_config_set_chain_to(dma_channel_config *c, uint chain_to) { c->encadear_com = chain_to; }
+static inline void channel_config_set_ring(dma_channel_config *c, bool write, uint size_bits) { c->anel_escrita = write; c->anel_bits = size_bits; }
+static inline void channel_config_set_irq_quiet(dma_channel_config *c, bool quiet) { c->irq_silenciosa = quiet; }
+
+// Registradores de um canal. Só write_addr é atualizado, nos canais ritmados pelo ADC
+typedef struct {
+    volatile uint32_t read_addr, write_addr, transfer_count, ctrl_trig;
+    volatile uint32_t al1_ctrl, al1_read_addr, al1_write_addr, al1_transfer_count_trig;
+} dma_channel_hw_t;
+
+typedef struct {
+    dma_channel_hw_t ch[NUM_DMA_CHANNELS];
+} dma_hw_t;
+
+extern dma_hw_t *const dma_hw;
+dma_channel_hw_t *dma_channel_hw_addr(uint channel);
+
+int dma_claim_unused_channel(bool required);
+void dma_channel_unclaim(uint channel);
+void dma_channel_set_config(uint channel, const dma_channel_config *config, bool trigger);
+void dma_channel_configure(uint channel, const dma_channel_config *config, volatile void *write_addr,
+                           const volatile void *read_addr, uint transfer_count, bool trigger);
+void dma_channel_set_read_addr(uint channel, const volatile void *read_addr, bool trigger);
+void dma_channel_set_write_addr(uint channel, volatile void *write_addr, bool trigger);
+void dma_channel_set_trans_count(uint channel, uint32_t trans_count, bool trigger);
+void dma_channel_start(uint channel);
+void dma_channel_abort(uint channel);
+static inline bool dma_channel_is_busy(uint channel) { (void)channel; return false; }
+static inline void dma_channel_wait_for_finish_blocking(uint channel) { (void)channel; }
+
+static inline void dma_channel_set_irq0_enabled(uint channel, bool enabled) { (void)channel; (void)enabled; }
+static inline void dma_channel_set_irq1_enabled(uint channel, bool enabled) { (void)channel; (void)enabled; }
+static inline bool dma_channel_get_irq0_status(uint channel) { (void)channel; return false; }
+static inline bool dma_channel_get_irq1_status(uint channel) { (void)channel; return false; }
+static inline void dma_channel_acknowledge_irq0(uint channel) { (void)channel; }
+static inline void dma_channel_acknowledge_irq1(uint channel) { (void)channel; }
+
+int dma_claim_unused_timer(bool required);
+static inline void dma_timer_set_fraction(uint timer, uint16_t numerator, uint16_t denominator) { (void)timer; (void)numerator; (void)denominator; }
+static inline uint dma_get_timer_dreq(uint timer) { return 0x3b + timer; }
+
+#endif
@@ -0,0 +1,91 @@
+// Substituto de "hardware/pio.h" para o build no computador. As máquinas de estado não
+// executam: o que o firmware põe na FIFO TX (por pio_sm_put ou por DMA) é entregue aos
+// ganchos host_ao_escrever_pio / host_ao_transmitir de host/pico_host.h.
+#ifndef HOST_HARDWARE_PIO_H
+#define HOST_HARDWARE_PIO_H
+
+#include "pico/stdlib.h"
+
+#define NUM_PIO_STATE_MACHINES 4
+#define PIO_INSTRUCTION_COUNT 32
+
+typedef struct pio_hw {
+    volatile uint32_t txf[NUM_PIO_STATE_MACHINES];
+    volatile uint32_t rxf[NUM_PIO_STATE_MACHINES];
+} pio_hw_t;
+
+typedef pio_hw_t *PIO;
+extern pio_hw_t *const pio0;
+extern pio_hw_t *const pio1;
+
+typedef struct pio_program {
+    const uint16_t *instructions;
+    uint8_t length;
+    int8_t origin;
+} pio_program_t;
+
+enum pio_fifo_join { PIO_FIFO_JOIN_NONE = 0, PIO_FIFO_JOIN_TX = 1, PIO_FIFO_JOIN_RX = 2 };
+
+// Guarda a configuração de forma legível (no RP2040 são registradores empacotados)
+typedef struct {
+    float clkdiv;
+    uint wrap_target, wrap;
+    uint sideset_bits;
+    bool sideset_opcional, sideset_pindirs;
+    uint sideset_base;
+    uint set_base, set_count;
+    uint out_base, out_count;
+    uint in_base;
+    bool out_shift_right, autopull;
+    uint pull_threshold;
+    bool in_shift_right, autopush;
+    uint push_threshold;
+    enum pio_fifo_join fifo_join;
+} pio_sm_config;
+
+static inline pio_sm_config pio_get_default_sm_config(void) {
+    pio_sm_config c = {0};
+    c.clkdiv = 1.f;
+    c.wrap = PIO_INSTRUCTION_COUNT - 1;
+    c.out_shift_right = c.in_shift_right = true;
+    c.pull_threshold = c.push_threshold = 32;
+    return c;
+}
+static inline void sm_config_set_wrap(pio_sm_config *c, uint wrap_target, uint wrap) { c->wrap_target = wrap_target; c->wrap = wrap; }
+static inline void sm_config_set_sideset(pio_sm_config *c, uint bit_count, bool optional, bool pindirs) {
+    c->sideset_bits = bit_count; c->sideset_opcional = optional; c->sideset_pindirs = pindirs;
+}
+static inline void sm_config_set_sideset_pins(pio_sm_config *c, uint base) { c->sideset_base = base; }
+static inline void sm_config_set_set_pins(pio_sm_config *c, uint base, uint count) { c->set_base = base; c->set_count = count; }
+static inline void sm_config_set_out_pins(pio_sm_config *c, uint base, uint count) { c->out_base = base; c->out_count = count; }
+static inline void sm_config_set_in_pins(pio_sm_config *c, uint base) { c->in_base = base; }
+static inline void sm_config_set_out_shift(pio_sm_config *c, bool shift_right, bool autopull, uint threshold) {
+    c->out_shift_right = shift_right; c->autopull = autopull; c->pull_threshold = threshold;
+}
+static inline void sm_config_set_in_shift(pio_sm_config *c, bool shift_right, bool autopush, uint threshold) {
+    c->in_shift_right = shift_right; c->autopush = autopush; c->push_threshold = threshold;
+}
+static inline void sm_config_set_fifo_join(pio_sm_config *c, enum pio_fifo_join join) { c->fifo_join = join; }
+static inline void sm_config_set_clkdiv(pio_sm_config *c, float div) { c->clkdiv = div; }
+
+bool pio_can_add_program(PIO pio, const pio_program_t *program);
+uint pio_add_program(PIO pio, const pio_program_t *program);
+int pio_claim_unused_sm(PIO pio, bool required);
+void pio_gpio_init(PIO pio, uint pin);
+void pio_sm_set_consecutive_pindirs(PIO pio, uint sm, uint pin_base, uint pin_count, bool is_out);
+void pio_sm_init(PIO pio, uint sm, uint initial_pc, const pio_sm_config *config);
+void pio_sm_set_enabled(PIO pio, uint sm, bool enabled);
+void pio_sm_set_clkdiv(PIO pio, uint sm, float div);
+void pio_sm_put(PIO pio, uint sm, uint32_t data);
+static inline void pio_sm_put_blocking(PIO pio, uint sm, uint32_t data) { pio_sm_put(pio, sm, data); }
+bool pio_sm_is_rx_fifo_empty(PIO pio, uint sm);
+uint32_t pio_sm_get(PIO pio, uint sm);
+static inline uint32_t pio_sm_get_blocking(PIO pio, uint sm) { return pio_sm_get(pio, sm); }
+
+static inline uint pio_get_index(PIO pio) { return pio == pio1 ? 1 : 0; }
+static inline uint pio_get_dreq(PIO pio, uint sm, bool is_tx) { return pio_get_index(pio) * 8 + (is_tx ? 0 : 4) + sm; }
+static inline uint pio_get_irq_num(PIO pio, uint irqn) { return (pio == pio1 ? 9 : 7) + irqn; }
+static inline uint pio_get_rx_fifo_not_empty_interrupt_source(uint sm) { return sm; }
+void pio_set_irqn_source_enabled(PIO pio, uint irq_index, uint source, bool enabled);
+
+#endif
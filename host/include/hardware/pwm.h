@@ -0,0 +1,54 @@
+// Substituto de "hardware/pwm.h" para o build no computador.
+#ifndef HOST_HARDWARE_PWM_H
+#define HOST_HARDWARE_PWM_H
+
+#include "pico/stdlib.h"
+
+#define NUM_PWM_SLICES 8
+#define PWM_CH0_CC_A_LSB 0u
+#define PWM_CH0_CC_B_LSB 16u
+
+enum pwm_chan { PWM_CHAN_A = 0, PWM_CHAN_B = 1 };
+
+typedef struct {
+    uint32_t csr, div, top;
+} pwm_config;
+
+typedef struct {
+    struct { volatile uint32_t csr, div, ctr, cc, top; } slice[NUM_PWM_SLICES];
+    volatile uint32_t en, intr, inte, intf, ints;
+} pwm_hw_t;
+
+extern pwm_hw_t *const pwm_hw;
+
+static inline uint pwm_gpio_to_slice_num(uint gpio) { return (gpio >> 1u) & 7u; }
+static inline uint pwm_gpio_to_channel(uint gpio) { return gpio & 1u; }
+
+static inline pwm_config pwm_get_default_config(void) {
+    pwm_config c = {0, 1u << 4, 0xffff};
+    return c;
+}
+static inline void pwm_config_set_wrap(pwm_config *c, uint16_t wrap) { c->top = wrap; }
+static inline void pwm_config_set_clkdiv(pwm_config *c, float div) { c->div = (uint32_t)(div * 16.f); }
+static inline void pwm_config_set_clkdiv_int(pwm_config *c, uint div) { c->div = div << 4; }
+
+static inline void pwm_init(uint slice_num, pwm_config *c, bool start) {
+    pwm_hw->slice[slice_num].csr = c->csr | (start ? 1u : 0u);
+    pwm_hw->slice[slice_num].div = c->div;
+    pwm_hw->slice[slice_num].top = c->top;
+}
+static inline void pwm_set_wrap(uint slice_num, uint16_t wrap) { pwm_hw->slice[slice_num].top = wrap; }
+static inline void pwm_set_clkdiv(uint slice_num, float div) { pwm_hw->slice[slice_num].div = (uint32_t)(div * 16.f); }
+static inline void pwm_set_clkdiv_int_frac(uint slice_num, uint8_t integer, uint8_t fract) { pwm_hw->slice[slice_num].div = ((uint32_t)integer << 4) | fract; }
+static inline void pwm_set_enabled(uint slice_num, bool enabled) {
+    if (enabled) pwm_hw->slice[slice_num].csr |= 1u; else pwm_hw->slice[slice_num].csr &= ~1u;
+}
+static inline void pwm_set_chan_level(uint slice_num, uint chan, uint16_t level) {
+    uint32_t cc = pwm_hw->slice[slice_num].cc;
+    pwm_hw->slice[slice_num].cc = chan ? (cc & 0xffffu) | ((uint32_t)level << 16) : (cc & 0xffff0000u) | level;
+}
+static inline void pwm_set_gpio_level(uint gpio, uint16_t level) {
+    pwm_set_chan_level(pwm_gpio_to_slice_num(gpio), pwm_gpio_to_channel(gpio), level);
+}
+
+#endif
@@ -0,0 +1,31 @@
+// Substituto de "hardware/structs/clocks.h" para o build no computador (só os registradores
+// de sleep enable que o modo ocioso usa).
+#ifndef HOST_HARDWARE_STRUCTS_CLOCKS_H
+#define HOST_HARDWARE_STRUCTS_CLOCKS_H
+
+#include <stdint.h>
+
+typedef struct {
+    volatile uint32_t wake_en0, wake_en1;
+    volatile uint32_t sleep_en0, sleep_en1;
+} clocks_hw_t;
+
+extern clocks_hw_t *const clocks_hw;
+
+#define CLOCKS_SLEEP_EN0_CLK_SYS_SPI1_BITS   0x80000000u
+#define CLOCKS_SLEEP_EN0_CLK_PERI_SPI1_BITS  0x40000000u
+#define CLOCKS_SLEEP_EN0_CLK_SYS_SPI0_BITS   0x20000000u
+#define CLOCKS_SLEEP_EN0_CLK_PERI_SPI0_BITS  0x10000000u
+#define CLOCKS_SLEEP_EN0_CLK_SYS_RTC_BITS    0x00800000u
+#define CLOCKS_SLEEP_EN0_CLK_RTC_RTC_BITS    0x00400000u
+#define CLOCKS_SLEEP_EN0_CLK_SYS_PWM_BITS    0x00200000u
+#define CLOCKS_SLEEP_EN0_CLK_SYS_JTAG_BITS   0x00000800u
+#define CLOCKS_SLEEP_EN0_CLK_SYS_I2C1_BITS   0x00000400u
+#define CLOCKS_SLEEP_EN0_CLK_SYS_I2C0_BITS   0x00000200u
+#define CLOCKS_SLEEP_EN0_CLK_SYS_ADC_BITS    0x00000004u
+#define CLOCKS_SLEEP_EN0_CLK_ADC_ADC_BITS    0x00000002u
+#define CLOCKS_SLEEP_EN1_CLK_SYS_UART1_BITS  0x00000080u
+#define CLOCKS_SLEEP_EN1_CLK_PERI_UART1_BITS 0x00000040u
+#define CLOCKS_SLEEP_EN1_CLK_SYS_TBMAN_BITS  0x00000400u
+
+#endif
@@ -0,0 +1,15 @@
+// Substituto de "hardware/sync.h" para o build no computador. __wfi e __wfe avançam o
+// tempo virtual até o próximo alarme.
+#ifndef HOST_HARDWARE_SYNC_H
+#define HOST_HARDWARE_SYNC_H
+
+#include "pico/stdlib.h"
+
+void __wfi(void);
+void __wfe(void);
+void __sev(void);
+static inline void __dmb(void) {}
+static inline uint32_t save_and_disable_interrupts(void) { return 0; }
+static inline void restore_interrupts(uint32_t status) { (void)status; }
+
+#endif
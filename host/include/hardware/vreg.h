@@ -0,0 +1,24 @@
+// Substituto de "hardware/vreg.h" para o build no computador: a tensão do núcleo não é
+// simulada.
+#ifndef HOST_HARDWARE_VREG_H
+#define HOST_HARDWARE_VREG_H
+
+#include "pico/stdlib.h"
+
+enum vreg_voltage {
+    VREG_VOLTAGE_0_85 = 0b0110,
+    VREG_VOLTAGE_0_90,
+    VREG_VOLTAGE_0_95,
+    VREG_VOLTAGE_1_00,
+    VREG_VOLTAGE_1_05,
+    VREG_VOLTAGE_1_10,
+    VREG_VOLTAGE_1_15,
+    VREG_VOLTAGE_1_20,
+    VREG_VOLTAGE_1_25,
+    VREG_VOLTAGE_1_30,
+    VREG_VOLTAGE_DEFAULT = VREG_VOLTAGE_1_10,
+};
+
+static inline void vreg_set_voltage(enum vreg_voltage voltage) { (void)voltage; }
+
+#endif
@@ -0,0 +1,534 @@
+// Implementação no computador do pedaço do SDK que o firmware usa. O tempo é virtual:
+// começa em 0 e só anda quando o firmware espera (sleep, wfe, wfi), disparando no caminho
+// os alarmes e timers vencidos. Assim uma animação de 20 s roda em milissegundos e sempre
+// produz o mesmo resultado.
+#include <string.h>
+
+#include "pico_host.h"
+#include "pico/bootrom.h"
+#include "hardware/adc.h"
+#include "hardware/clocks.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "hardware/pwm.h"
+#include "hardware/sync.h"
+#include "hardware/structs/clocks.h"
+#include "hardware/structs/scb.h"
+
+uint32_t host_clk_sys_hz = 125000000;
+void (*host_ao_transmitir)(PIO, uint, const void *, uint, uint, absolute_time_t);
+void (*host_ao_escrever_pio)(PIO, uint, uint32_t, absolute_time_t);
+void (*host_ao_ficar_ocioso)(void);
+uint16_t (*host_ao_amostrar_adc)(uint canal, uint64_t indice);
+
+static pio_hw_t pio_instancias[2];
+pio_hw_t *const pio0 = &pio_instancias[0];
+pio_hw_t *const pio1 = &pio_instancias[1];
+
+static pwm_hw_t pwm_instancia;
+pwm_hw_t *const pwm_hw = &pwm_instancia;
+static clocks_hw_t clocks_instancia = {.sleep_en0 = ~0u, .sleep_en1 = ~0u};
+clocks_hw_t *const clocks_hw = &clocks_instancia;
+static armv6m_scb_hw_t scb_instancia;
+armv6m_scb_hw_t *const scb_hw = &scb_instancia;
+
+uint32_t clock_get_hz(enum clock_index clk_index) {
+    return clk_index == clk_sys ? host_clk_sys_hz : 48000000;
+}
+
+// Mesma busca do check_sys_clock_khz do SDK: VCO de 750 a 1600 MHz a partir do cristal de
+// 12 MHz e dois pós-divisores de 1 a 7
+bool set_sys_clock_khz(uint32_t freq_khz, bool required) {
+    for (uint fbdiv = 320; fbdiv >= 16; fbdiv--) {
+        uint32_t vco_khz = fbdiv * 12000;
+        if (vco_khz < 750000 || vco_khz > 1600000)
+            continue;
+        for (uint pd1 = 7; pd1 >= 1; pd1--) {
+            for (uint pd2 = pd1; pd2 >= 1; pd2--) {
+                if (vco_khz % (pd1 * pd2) == 0 && vco_khz / (pd1 * pd2) == freq_khz) {
+                    host_clk_sys_hz = freq_khz * 1000;
+                    return true;
+                }
+            }
+        }
+    }
+    if (required)
+        panic("host: clk_sys de %u kHz impossível", (unsigned)freq_khz);
+    return false;
+}
+
+bool clock_configure(enum clock_index clk_index, uint32_t src, uint32_t auxsrc, uint32_t src_freq, uint32_t freq) {
+    (void)src;
+    (void)auxsrc;
+    (void)src_freq;
+    if (clk_index == clk_sys)
+        host_clk_sys_hz = freq;
+    return true;
+}
+
+void reset_usb_boot(uint32_t usb_activity_gpio_pin_mask, uint32_t disable_interface_mask) {
+    (void)usb_activity_gpio_pin_mask;
+    (void)disable_interface_mask;
+    printf("host: reset_usb_boot\n");
+    exit(0);
+}
+
+// Tempo virtual e alarmes
+
+#define MAX_ALARMES 32
+
+typedef struct {
+    alarm_id_t id;                // 0 = livre
+    absolute_time_t instante;
+    alarm_callback_t callback;
+    void *user_data;
+    struct repeating_timer *timer; // Não nulo para timers repetitivos
+} alarme_t;
+
+static absolute_time_t agora;
+static alarme_t alarmes[MAX_ALARMES];
+static alarm_id_t proximo_id = 1;
+static bool evento_pendente;
+
+absolute_time_t get_absolute_time(void) { return agora; }
+uint64_t time_us_64(void) { return agora; }
+uint32_t time_us_32(void) { return (uint32_t)agora; }
+
+static alarm_id_t agendar(absolute_time_t t, alarm_callback_t callback, void *user_data, struct repeating_timer *timer) {
+    for (int i = 0; i < MAX_ALARMES; i++) {
+        if (alarmes[i].id == 0) {
+            alarmes[i] = (alarme_t){proximo_id++, t, callback, user_data, timer};
+            if (proximo_id <= 0)
+                proximo_id = 1;
+            return alarmes[i].id;
+        }
+    }
+    panic("host: mais de %d alarmes pendentes", MAX_ALARMES);
+}
+
+alarm_id_t add_alarm_at(absolute_time_t t, alarm_callback_t callback, void *user_data, bool fire_if_past) {
+    if (t <= agora && !fire_if_past)
+        return 0;
+    return agendar(t, callback, user_data, NULL);
+}
+
+bool cancel_alarm(alarm_id_t id) {
+    for (int i = 0; i < MAX_ALARMES; i++) {
+        if (id != 0 && alarmes[i].id == id) {
+            alarmes[i].id = 0;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool add_repeating_timer_us(int64_t delay_us, repeating_timer_callback_t callback, void *user_data, struct repeating_timer *out) {
+    out->delay_us = delay_us;
+    out->callback = callback;
+    out->user_data = user_data;
+    out->alarm_id = agendar(agora + (uint64_t)(delay_us < 0 ? -delay_us : delay_us), NULL, NULL, out);
+    return true;
+}
+
+bool cancel_repeating_timer(struct repeating_timer *timer) {
+    bool cancelado = cancel_alarm(timer->alarm_id);
+    timer->alarm_id = 0;
+    return cancelado;
+}
+
+// Índice do alarme mais cedo (empate: o agendado primeiro), ou -1
+static int proximo_alarme(void) {
+    int melhor = -1;
+    for (int i = 0; i < MAX_ALARMES; i++) {
+        if (alarmes[i].id == 0)
+            continue;
+        if (melhor < 0 || alarmes[i].instante < alarmes[melhor].instante ||
+            (alarmes[i].instante == alarmes[melhor].instante && alarmes[i].id < alarmes[melhor].id))
+            melhor = i;
+    }
+    return melhor;
+}
+
+static void disparar(int i) {
+    alarme_t a = alarmes[i];
+    alarmes[i].id = 0;
+    if (a.instante > agora)
+        agora = a.instante;
+    evento_pendente = true; // Como no RP2040, a interrupção do timer acorda o __wfe
+
+    if (a.timer) {
+        if (a.timer->callback(a.timer)) {
+            int64_t d = a.timer->delay_us;
+            uint64_t periodo = (uint64_t)(d < 0 ? -d : d);
+            a.timer->alarm_id = agendar(d < 0 ? a.instante + periodo : agora + periodo, NULL, NULL, a.timer);
+        } else {
+            a.timer->alarm_id = 0;
+        }
+        return;
+    }
+    int64_t r = a.callback(a.id, a.user_data);
+    if (r != 0) {
+        // Positivo: a partir do instante previsto; negativo: a partir de agora
+        absolute_time_t t = r > 0 ? a.instante + (uint64_t)r : agora + (uint64_t)(-r);
+        for (int j = 0; j < MAX_ALARMES; j++) {
+            if (alarmes[j].id == 0) {
+                alarmes[j] = (alarme_t){a.id, t, a.callback, a.user_data, NULL};
+                return;
+            }
+        }
+        panic("host: mais de %d alarmes pendentes", MAX_ALARMES);
+    }
+}
+
+void host_avancar_ate(absolute_time_t t) {
+    for (;;) {
+        int i = proximo_alarme();
+        if (i < 0 || alarmes[i].instante > t)
+            break;
+        disparar(i);
+    }
+    if (t > agora)
+        agora = t;
+}
+
+// Espera até o próximo alarme; sem nenhum, o firmware dormiria para sempre
+static void esperar_evento(void) {
+    int i = proximo_alarme();
+    if (i >= 0) {
+        disparar(i);
+        return;
+    }
+    if (host_ao_ficar_ocioso) {
+        host_ao_ficar_ocioso();
+        return;
+    }
+    printf("host: firmware ocioso sem alarmes pendentes em t=%llu us\n", (unsigned long long)agora);
+    exit(0);
+}
+
+void sleep_until(absolute_time_t t) { host_avancar_ate(t); }
+void sleep_us(uint64_t us) { host_avancar_ate(agora + us); }
+void sleep_ms(uint32_t ms) { host_avancar_ate(agora + (uint64_t)ms * 1000); }
+void busy_wait_us_32(uint32_t us) { host_avancar_ate(agora + us); }
+void busy_wait_us(uint64_t us) { host_avancar_ate(agora + us); }
+void busy_wait_until(absolute_time_t t) { host_avancar_ate(t); }
+
+bool best_effort_wfe_or_timeout(absolute_time_t t) {
+    if (evento_pendente) {
+        evento_pendente = false;
+        return agora >= t;
+    }
+    int i = proximo_alarme();
+    if (i >= 0 && alarmes[i].instante <= t) {
+        disparar(i);
+        evento_pendente = false;
+        return agora >= t;
+    }
+    if (t >= at_the_end_of_time) {
+        esperar_evento();
+        evento_pendente = false;
+        return false;
+    }
+    host_avancar_ate(t);
+    return true;
+}
+
+void __sev(void) { evento_pendente = true; }
+
+void __wfe(void) {
+    if (evento_pendente)
+        evento_pendente = false;
+    else
+        esperar_evento();
+    evento_pendente = false;
+}
+
+void __wfi(void) {
+    esperar_evento();
+    evento_pendente = false;
+}
+
+// Interrupções
+
+static irq_handler_t handlers[NUM_IRQS];
+static bool irq_habilitada[NUM_IRQS];
+
+void irq_set_exclusive_handler(uint num, irq_handler_t handler) { handlers[num] = handler; }
+void irq_set_enabled(uint num, bool enabled) { irq_habilitada[num] = enabled; }
+
+void host_irq_disparar(uint num) {
+    if (num < NUM_IRQS && irq_habilitada[num] && handlers[num])
+        handlers[num]();
+}
+
+// GPIO
+
+static uint32_t gpio_saida, gpio_direcao, gpio_entrada = ~0u;
+static gpio_irq_callback_t gpio_callback;
+
+void gpio_init(uint gpio) { gpio_direcao &= ~(1u << gpio); gpio_saida &= ~(1u << gpio); }
+void gpio_init_mask(uint32_t mask) { gpio_direcao &= ~mask; gpio_saida &= ~mask; }
+void gpio_set_function(uint gpio, enum gpio_function fn) { (void)gpio; (void)fn; }
+void gpio_set_dir(uint gpio, bool out) {
+    if (out) gpio_direcao |= 1u << gpio; else gpio_direcao &= ~(1u << gpio);
+}
+void gpio_set_dir_out_masked(uint32_t mask) { gpio_direcao |= mask; }
+void gpio_pull_up(uint gpio) { (void)gpio; }
+void gpio_put(uint gpio, bool value) {
+    if (value) gpio_saida |= 1u << gpio; else gpio_saida &= ~(1u << gpio);
+}
+void gpio_set_mask(uint32_t mask) { gpio_saida |= mask; }
+void gpio_clr_mask(uint32_t mask) { gpio_saida &= ~mask; }
+void gpio_put_masked(uint32_t mask, uint32_t value) { gpio_saida = (gpio_saida & ~mask) | (value & mask); }
+uint32_t gpio_get_all(void) { return (gpio_saida & gpio_direcao) | (gpio_entrada & ~gpio_direcao); }
+bool gpio_get(uint gpio) { return (gpio_get_all() >> gpio) & 1u; }
+
+void gpio_set_irq_enabled(uint gpio, uint32_t events, bool enabled) { (void)gpio; (void)events; (void)enabled; }
+void gpio_set_irq_enabled_with_callback(uint gpio, uint32_t events, bool enabled, gpio_irq_callback_t callback) {
+    (void)gpio; (void)events; (void)enabled;
+    gpio_callback = callback;
+}
+
+void host_gpio_definir_entrada(uint gpio, bool nivel) {
+    bool antes = (gpio_entrada >> gpio) & 1u;
+    if (nivel) gpio_entrada |= 1u << gpio; else gpio_entrada &= ~(1u << gpio);
+    if (gpio_callback && antes != nivel)
+        gpio_callback(gpio, nivel ? GPIO_IRQ_EDGE_RISE : GPIO_IRQ_EDGE_FALL);
+}
+
+// PIO
+
+typedef struct {
+    bool reservada, habilitada;
+    uint pc_inicial;
+    pio_sm_config config;
+} maquina_t;
+
+static maquina_t maquinas[2][NUM_PIO_STATE_MACHINES];
+static uint instrucoes_usadas[2];
+
+bool pio_can_add_program(PIO pio, const pio_program_t *program) {
+    return instrucoes_usadas[pio_get_index(pio)] + program->length <= PIO_INSTRUCTION_COUNT;
+}
+
+uint pio_add_program(PIO pio, const pio_program_t *program) {
+    if (!pio_can_add_program(pio, program))
+        panic("host: sem espaço na PIO%u", pio_get_index(pio));
+    uint offset = instrucoes_usadas[pio_get_index(pio)];
+    instrucoes_usadas[pio_get_index(pio)] += program->length;
+    return offset;
+}
+
+int pio_claim_unused_sm(PIO pio, bool required) {
+    for (uint sm = 0; sm < NUM_PIO_STATE_MACHINES; sm++) {
+        if (!maquinas[pio_get_index(pio)][sm].reservada) {
+            maquinas[pio_get_index(pio)][sm].reservada = true;
+            return (int)sm;
+        }
+    }
+    if (required)
+        panic("host: nenhuma máquina livre na PIO%u", pio_get_index(pio));
+    return -1;
+}
+
+void pio_gpio_init(PIO pio, uint pin) { (void)pio; (void)pin; }
+void pio_sm_set_consecutive_pindirs(PIO pio, uint sm, uint pin_base, uint pin_count, bool is_out) {
+    (void)pio; (void)sm; (void)pin_base; (void)pin_count; (void)is_out;
+}
+
+void pio_sm_init(PIO pio, uint sm, uint initial_pc, const pio_sm_config *config) {
+    maquina_t *m = &maquinas[pio_get_index(pio)][sm];
+    m->pc_inicial = initial_pc;
+    m->config = *config;
+    m->habilitada = false;
+}
+
+void pio_sm_set_enabled(PIO pio, uint sm, bool enabled) { maquinas[pio_get_index(pio)][sm].habilitada = enabled; }
+void pio_sm_set_clkdiv(PIO pio, uint sm, float div) { maquinas[pio_get_index(pio)][sm].config.clkdiv = div; }
+
+const pio_sm_config *host_pio_config(PIO pio, uint sm) { return &maquinas[pio_get_index(pio)][sm].config; }
+
+void pio_sm_put(PIO pio, uint sm, uint32_t data) {
+    pio->txf[sm] = data;
+    if (host_ao_escrever_pio)
+        host_ao_escrever_pio(pio, sm, data, agora);
+}
+
+bool pio_sm_is_rx_fifo_empty(PIO pio, uint sm) { (void)pio; (void)sm; return true; }
+uint32_t pio_sm_get(PIO pio, uint sm) { return pio->rxf[sm]; }
+void pio_set_irqn_source_enabled(PIO pio, uint irq_index, uint source, bool enabled) {
+    (void)pio; (void)irq_index; (void)source; (void)enabled;
+}
+
+// ADC: guarda o ritmo e o instante em que começou a converter; as amostras são geradas
+// quando o firmware olha até onde o DMA escreveu
+
+static adc_hw_t adc_instancia;
+adc_hw_t *const adc_hw = &adc_instancia;
+
+static struct {
+    uint entrada;
+    float divisor;
+    bool rodando;
+    absolute_time_t inicio;
+} adc;
+
+void adc_init(void) { adc.divisor = 0.f; }
+void adc_gpio_init(uint gpio) { (void)gpio; }
+void adc_select_input(uint input) { adc.entrada = input; }
+void adc_set_clkdiv(float clkdiv) { adc.divisor = clkdiv; }
+void adc_fifo_setup(bool en, bool dreq_en, uint16_t dreq_thresh, bool err_in_fifo, bool byte_shift) {
+    (void)en; (void)dreq_en; (void)dreq_thresh; (void)err_in_fifo; (void)byte_shift;
+}
+
+void adc_run(bool run) {
+    if (run && !adc.rodando)
+        adc.inicio = agora;
+    adc.rodando = run;
+}
+
+// Amostras convertidas de adc.inicio até 't': uma a cada 1 + divisor ciclos de 48 MHz
+// (no mínimo 96, o tempo de uma conversão)
+static uint64_t adc_amostras_ate(absolute_time_t t) {
+    double ciclos = adc.divisor < 95.f ? 96.0 : 1.0 + adc.divisor;
+    return (uint64_t)((double)(t - adc.inicio) * 48.0 / ciclos);
+}
+
+// DMA
+
+typedef struct {
+    bool reservado;
+    dma_channel_config config;
+    volatile void *escrita;
+    const volatile void *leitura;
+    uint quantidade;
+    bool ritmado_adc;  // Disparado com DREQ_ADC: escreve no ritmo do ADC
+    uint64_t entregues; // Amostras do ADC já escritas
+    uint posicao;       // Próxima escrita, em bytes desde 'escrita'
+} canal_t;
+
+static canal_t canais[NUM_DMA_CHANNELS];
+static bool timers_dma[NUM_DMA_TIMERS];
+static dma_hw_t dma_instancia;
+dma_hw_t *const dma_hw = &dma_instancia;
+
+// Escreve as amostras que o ADC converteu desde a última olhada, dando a volta no anel
+// como o DMA (channel_config_set_ring na escrita)
+static void adc_dma_atualizar(uint channel) {
+    canal_t *c = &canais[channel];
+    if (!c->ritmado_adc || !adc.rodando)
+        return;
+    uint tamanho = 1u << c->config.tamanho;
+    uint anel = c->config.anel_escrita && c->config.anel_bits ? 1u << c->config.anel_bits : 0;
+    uint64_t total = adc_amostras_ate(agora);
+    if (anel && total - c->entregues > anel / tamanho) { // Só as últimas cabem no anel
+        uint64_t pular = total - c->entregues - anel / tamanho;
+        c->entregues += pular;
+        c->posicao = (uint)((c->posicao + pular * tamanho) % anel);
+    }
+    for (; c->entregues < total; c->entregues++) {
+        uint16_t valor = host_ao_amostrar_adc ? host_ao_amostrar_adc(adc.entrada, c->entregues) : 2048;
+        uint8_t *destino = (uint8_t *)c->escrita + c->posicao;
+        if (tamanho == 1)
+            *destino = (uint8_t)(valor >> 4);
+        else
+            memcpy(destino, &valor, sizeof(valor));
+        c->posicao += tamanho;
+        if (anel)
+            c->posicao %= anel;
+    }
+    dma_hw->ch[channel].write_addr = (uint32_t)(uintptr_t)((uint8_t *)c->escrita + c->posicao);
+}
+
+dma_channel_hw_t *dma_channel_hw_addr(uint channel) {
+    adc_dma_atualizar(channel);
+    return &dma_hw->ch[channel];
+}
+
+int dma_claim_unused_channel(bool required) {
+    for (int c = 0; c < NUM_DMA_CHANNELS; c++) {
+        if (!canais[c].reservado) {
+            canais[c].reservado = true;
+            canais[c].config = dma_channel_get_default_config(c);
+            return c;
+        }
+    }
+    if (required)
+        panic("host: nenhum canal de DMA livre");
+    return -1;
+}
+
+void dma_channel_unclaim(uint channel) { canais[channel].reservado = false; }
+
+int dma_claim_unused_timer(bool required) {
+    for (int t = 0; t < NUM_DMA_TIMERS; t++) {
+        if (!timers_dma[t]) {
+            timers_dma[t] = true;
+            return t;
+        }
+    }
+    if (required)
+        panic("host: nenhum timer de DMA livre");
+    return -1;
+}
+
+// A transferência acontece inteira no disparo. Só as que vão para uma FIFO TX de PIO têm
+// efeito visível; as pacientes por timer (o sintetizador) não produzem nada no host.
+static void transferir(uint channel) {
+    canal_t *c = &canais[channel];
+    if (c->config.dreq == DREQ_ADC) { // Continua de onde estava, como o registrador de escrita
+        if (!c->ritmado_adc)
+            c->entregues = adc.rodando ? adc_amostras_ate(agora) : 0;
+        c->ritmado_adc = true;
+        return;
+    }
+    for (uint p = 0; p < 2; p++) {
+        pio_hw_t *pio = p ? pio1 : pio0;
+        for (uint sm = 0; sm < NUM_PIO_STATE_MACHINES; sm++) {
+            if (c->escrita == (volatile void *)&pio->txf[sm]) {
+                if (host_ao_transmitir)
+                    host_ao_transmitir(pio, sm, (const void *)c->leitura, c->quantidade, 1u << c->config.tamanho, agora);
+                return;
+            }
+        }
+    }
+}
+
+void dma_channel_set_config(uint channel, const dma_channel_config *config, bool trigger) {
+    canais[channel].config = *config;
+    if (trigger)
+        transferir(channel);
+}
+
+void dma_channel_configure(uint channel, const dma_channel_config *config, volatile void *write_addr,
+                           const volatile void *read_addr, uint transfer_count, bool trigger) {
+    canais[channel].config = *config;
+    canais[channel].ritmado_adc = false;
+    canais[channel].posicao = 0;
+    canais[channel].escrita = write_addr;
+    canais[channel].leitura = read_addr;
+    canais[channel].quantidade = transfer_count;
+    if (trigger)
+        transferir(channel);
+}
+
+void dma_channel_set_read_addr(uint channel, const volatile void *read_addr, bool trigger) {
+    canais[channel].leitura = read_addr;
+    if (trigger)
+        transferir(channel);
+}
+
+void dma_channel_set_write_addr(uint channel, volatile void *write_addr, bool trigger) {
+    canais[channel].escrita = write_addr;
+    if (trigger)
+        transferir(channel);
+}
+
+void dma_channel_set_trans_count(uint channel, uint32_t trans_count, bool trigger) {
+    canais[channel].quantidade = trans_count;
+    if (trigger)
+        transferir(channel);
+}
+
+void dma_channel_start(uint channel) { transferir(channel); }
+void dma_channel_abort(uint channel) { canais[channel].ritmado_adc = false; }
@@ -0,0 +1,38 @@
+// Controle da plataforma simulada usada pelos programas de host (benchmark, renderizador).
+// O firmware não inclui este arquivo: ele só vê os cabeçalhos de host/include, que imitam
+// os do SDK.
+#ifndef PICO_HOST_H
+#define PICO_HOST_H
+
+#include "pico/stdlib.h"
+#include "hardware/pio.h"
+
+// Frequência devolvida por clock_get_hz(clk_sys)
+extern uint32_t host_clk_sys_hz;
+
+// Chamado a cada transferência de DMA para a FIFO TX de uma PIO (um quadro inteiro dos LEDs,
+// por exemplo), com os dados já no formato do fio e o instante virtual do disparo.
+extern void (*host_ao_transmitir)(PIO pio, uint sm, const void *dados, uint quantidade,
+                                  uint tamanho_palavra, absolute_time_t instante);
+
+// Chamado a cada pio_sm_put
+extern void (*host_ao_escrever_pio)(PIO pio, uint sm, uint32_t palavra, absolute_time_t instante);
+
+// Valor (12 bits) da amostra número 'indice', contado desde adc_run(true), na entrada
+// 'canal' do ADC. Sem gancho, o ADC lê meia escala (2048), como um microfone em silêncio.
+extern uint16_t (*host_ao_amostrar_adc)(uint canal, uint64_t indice);
+
+// Chamado quando o firmware dorme sem nenhum alarme pendente (esperaria para sempre). Sem
+// gancho, o programa termina.
+extern void (*host_ao_ficar_ocioso)(void);
+
+// Avança o tempo virtual até 't', disparando em ordem os alarmes que vencerem no caminho
+void host_avancar_ate(absolute_time_t t);
+
+// Nível lido por gpio_get nos pinos de entrada (padrão: 1, como com pull-up e nada ligado)
+void host_gpio_definir_entrada(uint gpio, bool nivel);
+
+// Configuração com que a máquina foi iniciada (pio_sm_init e alterações posteriores)
+const pio_sm_config *host_pio_config(PIO pio, uint sm);
+
+#endif
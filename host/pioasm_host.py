@@ -0,0 +1,225 @@
+#!/usr/bin/env python3
+"""Gera o .pio.h de um programa PIO para o build no computador, sem o pioasm do SDK.
+
+Uso: pioasm_host.py <programa.pio> <saida.pio.h>
+
+Monta o subconjunto de instruções usado pelos programas deste projeto (jmp, in, out,
+push, pull, mov, set, nop, com side-set e atrasos) com a mesma codificação do RP2040,
+gera <nome>_program_instructions, <nome>_program, <nome>_wrap/_wrap_target e
+<nome>_program_get_default_config como o pioasm, e copia o bloco '% c-sdk' do arquivo.
+"""
+
+import re
+import sys
+
+
+class ErroPio(Exception):
+    pass
+
+
+JMP_CONDICOES = {"": 0, "!x": 1, "x--": 2, "!y": 3, "y--": 4, "x!=y": 5, "pin": 6, "!osre": 7}
+IN_ORIGENS = {"pins": 0, "x": 1, "y": 2, "null": 3, "isr": 6, "osr": 7}
+OUT_DESTINOS = {"pins": 0, "x": 1, "y": 2, "null": 3, "pindirs": 4, "pc": 5, "isr": 6, "exec": 7}
+MOV_DESTINOS = {"pins": 0, "x": 1, "y": 2, "exec": 4, "pc": 5, "isr": 6, "osr": 7}
+MOV_ORIGENS = {"pins": 0, "x": 1, "y": 2, "null": 3, "status": 5, "isr": 6, "osr": 7}
+SET_DESTINOS = {"pins": 0, "x": 1, "y": 2, "pindirs": 4}
+
+
+def numero(texto):
+    texto = texto.strip()
+    if texto.startswith("0b"):
+        return int(texto[2:], 2)
+    return int(texto, 0)
+
+
+class Programa:
+    def __init__(self, caminho):
+        self.caminho = caminho
+        self.nome = None
+        self.sideset_bits = 0
+        self.sideset_opcional = False
+        self.sideset_pindirs = False
+        self.wrap_target = None
+        self.wrap = None
+        self.rotulos = {}
+        self.linhas = []  # (número da linha, texto da instrução)
+        self.c_sdk = []
+
+    def erro(self, linha, mensagem):
+        raise ErroPio(f"{self.caminho}:{linha}: erro: {mensagem}")
+
+    def ler(self):
+        with open(self.caminho, encoding="utf-8") as arquivo:
+            texto = arquivo.read().split("\n")
+        i = 0
+        while i < len(texto):
+            n = i + 1
+            linha = texto[i]
+            i += 1
+            if linha.strip().startswith("% c-sdk"):
+                while i < len(texto) and not texto[i].strip().startswith("%}"):
+                    self.c_sdk.append(texto[i])
+                    i += 1
+                i += 1
+                continue
+            linha = re.split(r"//|;", linha, maxsplit=1)[0].strip()
+            if not linha:
+                continue
+            if linha.startswith(".program"):
+                self.nome = linha.split()[1]
+            elif linha.startswith(".side_set"):
+                partes = linha.split()
+                self.sideset_bits = int(partes[1])
+                self.sideset_opcional = "opt" in partes[2:]
+                self.sideset_pindirs = "pindirs" in partes[2:]
+            elif linha == ".wrap_target":
+                self.wrap_target = len(self.linhas)
+            elif linha == ".wrap":
+                self.wrap = len(self.linhas) - 1
+            elif linha.startswith("."):
+                self.erro(n, f"diretiva não suportada: {linha}")
+            else:
+                rotulo = re.match(r"^(\w+):\s*(.*)$", linha)
+                if rotulo:
+                    self.rotulos[rotulo.group(1)] = len(self.linhas)
+                    linha = rotulo.group(2)
+                if linha:
+                    self.linhas.append((n, linha))
+        if self.nome is None:
+            self.erro(1, "falta .program")
+        if len(self.linhas) > 32:
+            self.erro(1, "mais de 32 instruções")
+        if self.wrap_target is None:
+            self.wrap_target = 0
+        if self.wrap is None:
+            self.wrap = len(self.linhas) - 1
+
+    def montar(self):
+        return [self.montar_linha(n, texto) for n, texto in self.linhas]
+
+    def montar_linha(self, n, texto):
+        atraso = 0
+        m = re.search(r"\[(\s*\d+\s*)\]\s*$", texto)
+        if m:
+            atraso = int(m.group(1))
+            texto = texto[:m.start()].strip()
+        lateral = None
+        m = re.search(r"\bside\s+(\S+)\s*$", texto)
+        if m:
+            lateral = numero(m.group(1))
+            texto = texto[:m.start()].strip()
+
+        bits_lateral = self.sideset_bits
+        bits_atraso = 5 - bits_lateral
+        if atraso >= (1 << bits_atraso):
+            self.erro(n, f"atraso {atraso} não cabe em {bits_atraso} bits")
+        campo = atraso
+        if bits_lateral:
+            if lateral is None and not self.sideset_opcional:
+                self.erro(n, "side-set obrigatório")
+            if lateral is not None:
+                valor_bits = bits_lateral - (1 if self.sideset_opcional else 0)
+                if lateral >= (1 << valor_bits):
+                    self.erro(n, f"side {lateral} não cabe em {valor_bits} bits")
+                if self.sideset_opcional:
+                    lateral |= 1 << valor_bits
+                campo |= lateral << bits_atraso
+        elif lateral is not None:
+            self.erro(n, "side sem .side_set")
+
+        partes = texto.replace(",", " ").split()
+        op = partes[0]
+        args = partes[1:]
+        try:
+            return (self.codificar(op, args) | (campo << 8)) & 0xFFFF
+        except (KeyError, IndexError, ValueError) as e:
+            self.erro(n, f"instrução inválida '{texto}' ({e})")
+
+    def endereco(self, alvo):
+        if alvo in self.rotulos:
+            return self.rotulos[alvo]
+        return numero(alvo)
+
+    def codificar(self, op, args):
+        if op == "nop":
+            return 0xA042  # mov y, y
+        if op == "jmp":
+            cond = args[0] if len(args) == 2 else ""
+            return (0 << 13) | (JMP_CONDICOES[cond] << 5) | self.endereco(args[-1])
+        if op == "in":
+            return (2 << 13) | (IN_ORIGENS[args[0]] << 5) | (numero(args[1]) & 31)
+        if op == "out":
+            return (3 << 13) | (OUT_DESTINOS[args[0]] << 5) | (numero(args[1]) & 31)
+        if op in ("push", "pull"):
+            opcoes = set(args)
+            bloqueia = "noblock" not in opcoes
+            se = ("iffull" if op == "push" else "ifempty") in opcoes
+            return (4 << 13) | ((op == "pull") << 7) | (se << 6) | (bloqueia << 5)
+        if op == "mov":
+            destino, origem = args
+            operacao = 0
+            if origem.startswith("!") or origem.startswith("~"):
+                operacao, origem = 1, origem[1:]
+            elif origem.startswith("::"):
+                operacao, origem = 2, origem[2:]
+            return (5 << 13) | (MOV_DESTINOS[destino] << 5) | (operacao << 3) | MOV_ORIGENS[origem]
+        if op == "set":
+            return (7 << 13) | (SET_DESTINOS[args[0]] << 5) | (numero(args[1]) & 31)
+        raise KeyError(op)
+
+
+def gerar(programa, instrucoes):
+    nome = programa.nome
+    saida = [
+        f"// Gerado por host/pioasm_host.py a partir de {programa.caminho.split('/')[-1]}. Não editar.",
+        "#pragma once",
+        "",
+        "#include \"hardware/pio.h\"",
+        "",
+        f"#define {nome}_wrap_target {programa.wrap_target}",
+        f"#define {nome}_wrap {programa.wrap}",
+        "",
+        f"static const uint16_t {nome}_program_instructions[] = {{",
+    ]
+    for (n, texto), palavra in zip(programa.linhas, instrucoes):
+        saida.append(f"    0x{palavra:04x}, // {texto}")
+    saida += [
+        "};",
+        "",
+        f"static const struct pio_program {nome}_program = {{",
+        f"    .instructions = {nome}_program_instructions,",
+        f"    .length = {len(instrucoes)},",
+        "    .origin = -1,",
+        "};",
+        "",
+        f"static inline pio_sm_config {nome}_program_get_default_config(uint offset) {{",
+        "    pio_sm_config c = pio_get_default_sm_config();",
+        f"    sm_config_set_wrap(&c, offset + {nome}_wrap_target, offset + {nome}_wrap);",
+    ]
+    if programa.sideset_bits:
+        saida.append(f"    sm_config_set_sideset(&c, {programa.sideset_bits}, "
+                     f"{str(programa.sideset_opcional).lower()}, {str(programa.sideset_pindirs).lower()});")
+    saida += ["    return c;", "}", ""]
+    saida += programa.c_sdk
+    saida.append("")
+    return "\n".join(saida)
+
+
+def main(argv):
+    if len(argv) != 3:
+        print(__doc__.splitlines()[2], file=sys.stderr)
+        return 2
+    try:
+        programa = Programa(argv[1])
+        programa.ler()
+        instrucoes = programa.montar()
+    except ErroPio as e:
+        print(e, file=sys.stderr)
+        return 1
+    with open(argv[2], "w", encoding="utf-8") as arquivo:
+        arquivo.write(gerar(programa, instrucoes))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
@@ -0,0 +1,532 @@
+// Entrada de quadros pela rede no computador: o parser E1.31/DDP do firmware atrás de um
+// socket UDP no loopback, no lugar do rádio da Pico W. Os pacotes de uma captura pcap são
+// mandados um a um para 127.0.0.1, recebidos num buffer e entregues a rede_receber, que
+// desenha direto no framebuffer. No fim mostra quantos pacotes por segundo passaram pelo
+// loopback e quantos o parser sozinho aguenta.
+//
+//   led_matrix_rede captura.pcap [--repetir n]
+//   led_matrix_rede --gerar captura.pcap [--quadros n]
+//   led_matrix_rede --conferir
+//
+// --gerar escreve uma captura sintética (E1.31 e depois DDP, com pacotes repetidos e fora
+// de ordem) para quem não tem a mesa de luz à mão. --conferir testa o parser pacote a
+// pacote (sequência, fontes, sincronia, DDP em partes, pausa) e repete uma captura gerada
+// pelo loopback; sai com erro se algo não bater.
+#define LED_MATRIX_SEM_MAIN
+#include "led_matrix.c"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "pico_host.h"
+
+#define PACOTE_MAX 1500
+
+typedef struct {
+    const uint8_t *dados;
+    uint tamanho;
+    uint porta;
+} pacote_t;
+
+static pacote_t *pacotes;
+static uint num_pacotes;
+
+static uint32_t ler32(const uint8_t *p, bool trocar) {
+    return trocar ? (uint32_t)p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3] : p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+// Onde começa o IPv4 em cada tipo de enlace; -1 se o quadro não é IPv4
+static int inicio_ipv4(uint32_t enlace, const uint8_t *q, uint n) {
+    switch (enlace) {
+    case 0: // Loopback BSD: família na ordem da máquina que capturou
+        return n >= 4 && (q[0] == 2 || q[3] == 2) ? 4 : -1;
+    case 1: { // Ethernet, com ou sem VLAN
+        uint tipo = 12;
+        if (n >= 18 && be16(q + 12) == 0x8100)
+            tipo = 16;
+        return n >= tipo + 2 && be16(q + tipo) == 0x0800 ? (int)tipo + 2 : -1;
+    }
+    case 12:
+    case 101: // IP cru
+        return 0;
+    case 113: // Linux "cooked"
+        return n >= 16 && be16(q + 14) == 0x0800 ? 16 : -1;
+    case 276: // Linux "cooked" v2
+        return n >= 20 && be16(q) == 0x0800 ? 20 : -1;
+    default:
+        return -1;
+    }
+}
+
+// Lê os pacotes UDP para as portas do E1.31 e do DDP de uma captura pcap (não pcapng)
+static bool ler_pcap(const char *caminho) {
+    FILE *f = fopen(caminho, "rb");
+    if (!f) {
+        perror(caminho);
+        return false;
+    }
+    fseek(f, 0, SEEK_END);
+    long tamanho = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint8_t *arquivo = malloc(tamanho > 0 ? tamanho : 1);
+    bool lido = arquivo && fread(arquivo, 1, tamanho, f) == (size_t)tamanho;
+    fclose(f);
+    uint32_t magico = lido && tamanho >= 24 ? ler32(arquivo, false) : 0;
+    bool trocar = magico == 0xd4c3b2a1 || magico == 0x4d3cb2a1;
+    if (!trocar && magico != 0xa1b2c3d4 && magico != 0xa1b23c4d) {
+        fprintf(stderr, "%s: não é uma captura pcap (pcapng não é lido; converta com editcap -F pcap)\n", caminho);
+        free(arquivo);
+        return false;
+    }
+    uint32_t enlace = ler32(arquivo + 20, trocar) & 0xFFFF;
+    pacotes = malloc(sizeof(pacote_t) * (tamanho / 16 + 1));
+    num_pacotes = 0;
+    for (long p = 24; p + 16 <= tamanho;) {
+        uint capturado = ler32(arquivo + p + 8, trocar);
+        const uint8_t *q = arquivo + p + 16;
+        p += 16 + capturado;
+        if (p > tamanho)
+            break;
+        int ip = inicio_ipv4(enlace, q, capturado);
+        if (ip < 0 || capturado < (uint)ip + 20 || (q[ip] >> 4) != 4 || q[ip + 9] != 17 || (be16(q + ip + 6) & 0x3FFF))
+            continue; // Não é UDP sobre IPv4, ou é fragmento
+        uint udp = ip + (q[ip] & 0x0F) * 4;
+        if (capturado < udp + 8)
+            continue;
+        uint porta = be16(q + udp + 2), comprimento = be16(q + udp + 4);
+        if ((porta != SACN_PORTA && porta != DDP_PORTA) || comprimento < 8)
+            continue;
+        uint dados = comprimento - 8;
+        if (dados > capturado - udp - 8)
+            dados = capturado - udp - 8; // Captura cortada pelo snaplen
+        pacotes[num_pacotes++] = (pacote_t){q + udp + 8, dados, porta};
+    }
+    return true;
+}
+
+// Montagem de pacotes, para a captura sintética e o --conferir
+static const uint8_t cid_mesa[16] = {0x4c, 0x45, 0x44, 0x2d, 0x6d, 0x61, 0x74, 0x72, 0x69, 0x7a, 0, 0, 0, 0, 0, 1};
+static const uint8_t cid_outra[16] = {0x4c, 0x45, 0x44, 0x2d, 0x6d, 0x61, 0x74, 0x72, 0x69, 0x7a, 0, 0, 0, 0, 0, 2};
+
+static void escrever16(uint8_t *p, uint16_t v) {
+    p[0] = v >> 8;
+    p[1] = v;
+}
+
+static void escrever32(uint8_t *p, uint32_t v) {
+    escrever16(p, v >> 16);
+    escrever16(p + 2, v);
+}
+
+static uint montar_raiz(uint8_t *p, uint tamanho, uint32_t vetor, const uint8_t *cid) {
+    memset(p, 0, tamanho);
+    escrever16(p, 0x0010);
+    memcpy(p + 4, acn_identificador, sizeof(acn_identificador));
+    escrever16(p + 16, 0x7000 | (tamanho - 16));
+    escrever32(p + 18, vetor);
+    memcpy(p + 22, cid, 16);
+    escrever16(p + 38, 0x7000 | (tamanho - 38));
+    return tamanho;
+}
+
+static uint montar_e131(uint8_t *p, const uint8_t *cid, uint16_t universo, uint8_t sequencia, uint8_t prioridade,
+                        uint8_t opcoes, uint16_t sincronia, const uint8_t *canais, uint n) {
+    montar_raiz(p, E131_CABECALHO + n, E131_VETOR_DADOS, cid);
+    escrever32(p + 40, E131_VETOR_QUADRO);
+    snprintf((char *)p + 44, 64, "led_matrix_rede");
+    p[108] = prioridade;
+    escrever16(p + 109, sincronia);
+    p[111] = sequencia;
+    p[112] = opcoes;
+    escrever16(p + 113, universo);
+    escrever16(p + 115, 0x7000 | (E131_CABECALHO + n - 115));
+    p[117] = 0x02;
+    p[118] = 0xa1;
+    escrever16(p + 121, 1);
+    escrever16(p + 123, n + 1);
+    memcpy(p + E131_CABECALHO, canais, n);
+    return E131_CABECALHO + n;
+}
+
+static uint montar_sincronia(uint8_t *p, const uint8_t *cid, uint8_t sequencia, uint16_t universo) {
+    montar_raiz(p, E131_SINCRONIA_TAMANHO, E131_VETOR_ESTENDIDO, cid);
+    escrever32(p + 40, E131_VETOR_SINCRONIA);
+    p[44] = sequencia;
+    escrever16(p + 45, universo);
+    return E131_SINCRONIA_TAMANHO;
+}
+
+static uint montar_ddp(uint8_t *p, uint8_t flags, uint8_t sequencia, uint32_t offset, const uint8_t *dados, uint n) {
+    uint cabecalho = DDP_CABECALHO + (flags & DDP_TEMPO ? 4 : 0);
+    memset(p, 0, cabecalho);
+    p[0] = DDP_VERSAO | flags;
+    p[1] = sequencia;
+    p[2] = DDP_TIPO_RGB8;
+    p[3] = DDP_ID_TELA;
+    escrever32(p + 4, offset);
+    escrever16(p + 8, n);
+    memcpy(p + cabecalho, dados, n);
+    return cabecalho + n;
+}
+
+// Quadro k do padrão de teste: gradientes que andam, diferentes em cada canal
+static void padrao(uint k, uint8_t canais[REDE_CANAIS]) {
+    for (uint i = 0; i < NUM_LEDS; i++) {
+        canais[3 * i] = i * 10 + k * 7;
+        canais[3 * i + 1] = 255 - i * 9 + k * 3;
+        canais[3 * i + 2] = (i * 37 + k * 11) & 0x7F;
+    }
+}
+
+// Captura sintética: 'quadros' quadros E1.31 e depois 'quadros' em DDP (cada um em dois
+// pacotes, o segundo com push). A cada 10 quadros um pacote E1.31 vai repetido, e a cada 16
+// as duas partes de um quadro DDP trocam de lugar, para o controle de sequência ter o que
+// descartar: a primeira parte chega depois da segunda e é velha.
+static uint gerados_descartaveis;
+
+static void adicionar(uint porta, const uint8_t *dados, uint tamanho) {
+    uint8_t *copia = malloc(tamanho);
+    memcpy(copia, dados, tamanho);
+    pacotes[num_pacotes++] = (pacote_t){copia, tamanho, porta};
+}
+
+static void gerar_pacotes(uint quadros) {
+    uint8_t pacote[PACOTE_MAX], canais[REDE_CANAIS];
+    pacotes = malloc(sizeof(pacote_t) * 4 * quadros);
+    num_pacotes = 0;
+    gerados_descartaveis = 0;
+    for (uint k = 0; k < quadros; k++) {
+        padrao(k, canais);
+        uint n = montar_e131(pacote, cid_mesa, REDE_UNIVERSO, k, 100, 0, 0, canais, REDE_CANAIS);
+        adicionar(SACN_PORTA, pacote, n);
+        if (k % 10 == 9) {
+            adicionar(SACN_PORTA, pacote, n);
+            gerados_descartaveis++;
+        }
+    }
+    const uint meio = REDE_CANAIS / 2;
+    for (uint k = 0; k < quadros; k++) {
+        padrao(quadros + k, canais);
+        uint primeiro = num_pacotes;
+        uint n = montar_ddp(pacote, 0, (2 * k) % 15 + 1, REDE_DDP_OFFSET, canais, meio);
+        adicionar(DDP_PORTA, pacote, n);
+        n = montar_ddp(pacote, DDP_PUSH, (2 * k + 1) % 15 + 1, REDE_DDP_OFFSET + meio, canais + meio, REDE_CANAIS - meio);
+        adicionar(DDP_PORTA, pacote, n);
+        if (k % 16 == 5) {
+            pacote_t t = pacotes[primeiro];
+            pacotes[primeiro] = pacotes[primeiro + 1];
+            pacotes[primeiro + 1] = t;
+            gerados_descartaveis++;
+        }
+    }
+}
+
+// Grava os pacotes numa captura Ethernet, a 40 quadros por segundo: E1.31 para o grupo
+// multicast do universo, DDP direto para a placa
+static bool gravar_pcap(const char *caminho) {
+    FILE *f = fopen(caminho, "wb");
+    if (!f) {
+        perror(caminho);
+        return false;
+    }
+    const uint32_t cabecalho_arquivo[6] = {0xa1b2c3d4, 0x00040002, 0, 0, 65535, 1};
+    fwrite(cabecalho_arquivo, 4, 6, f);
+    static const uint8_t mac_grupo[6] = {0x01, 0x00, 0x5e, 0x7f, REDE_UNIVERSO >> 8, REDE_UNIVERSO & 0xFF};
+    static const uint8_t mac_placa[6] = {0x28, 0xcd, 0xc1, 0x00, 0x00, 0x01};
+    static const uint8_t mac_mesa[6] = {0x02, 0x00, 0x00, 0x00, 0x00, 0x0a};
+    static const uint8_t ip_mesa[4] = {192, 168, 0, 10}, ip_placa[4] = {192, 168, 0, 50};
+    static const uint8_t ip_grupo[4] = {239, 255, REDE_UNIVERSO >> 8, REDE_UNIVERSO & 0xFF};
+    uint64_t instante_us = 0;
+    for (uint i = 0; i < num_pacotes; i++) {
+        const pacote_t *p = &pacotes[i];
+        bool ddp = p->porta == DDP_PORTA;
+        uint8_t quadro[14 + 20 + 8] = {0};
+        memcpy(quadro, ddp ? mac_placa : mac_grupo, 6);
+        memcpy(quadro + 6, mac_mesa, 6);
+        escrever16(quadro + 12, 0x0800);
+        uint8_t *ip = quadro + 14;
+        ip[0] = 0x45;
+        escrever16(ip + 2, 20 + 8 + p->tamanho);
+        escrever16(ip + 4, i);
+        ip[8] = 64;
+        ip[9] = 17;
+        memcpy(ip + 12, ip_mesa, 4);
+        memcpy(ip + 16, ddp ? ip_placa : ip_grupo, 4);
+        uint32_t soma = 0;
+        for (int b = 0; b < 20; b += 2)
+            soma += be16(ip + b);
+        while (soma >> 16)
+            soma = (soma & 0xFFFF) + (soma >> 16);
+        escrever16(ip + 10, ~soma);
+        uint8_t *udp = ip + 20;
+        escrever16(udp, 49152);
+        escrever16(udp + 2, p->porta);
+        escrever16(udp + 4, 8 + p->tamanho);
+        uint32_t registro[4] = {instante_us / 1000000, instante_us % 1000000, sizeof(quadro) + p->tamanho,
+                                sizeof(quadro) + p->tamanho};
+        fwrite(registro, 4, 4, f);
+        fwrite(quadro, 1, sizeof(quadro), f);
+        fwrite(p->dados, 1, p->tamanho, f);
+        // As partes de um quadro DDP saem juntas; o quadro seguinte, 25 ms depois
+        instante_us += ddp && !(p->dados[0] & DDP_PUSH) ? 10 : 25000;
+    }
+    return fclose(f) == 0;
+}
+
+static double relogio_us(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e6 + t.tv_nsec / 1e3;
+}
+
+static int socket_local(struct sockaddr_in *endereco) {
+    int s = socket(AF_INET, SOCK_DGRAM, 0);
+    *endereco = (struct sockaddr_in){.sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK)};
+    socklen_t tamanho = sizeof(*endereco);
+    if (s < 0 || bind(s, (struct sockaddr *)endereco, sizeof(*endereco)) ||
+        getsockname(s, (struct sockaddr *)endereco, &tamanho)) {
+        perror("socket UDP no loopback");
+        exit(1);
+    }
+    return s;
+}
+
+// Repete os pacotes pelo loopback, cada um recebido e tratado antes do próximo
+static bool repetir(uint vezes, bool mostrar) {
+    struct sockaddr_in destino_sacn, destino_ddp, origem;
+    int rx_sacn = socket_local(&destino_sacn), rx_ddp = socket_local(&destino_ddp), tx = socket_local(&origem);
+    static uint8_t buffer[65536]; // O "pbuf": o parser lê daqui mesmo
+    uint32_t resultados[REDE_PAUSADO + 1] = {0};
+    uint por_porta[2] = {0, 0};
+    uint32_t quadros_antes = rede.quadros;
+    double parser_us = 0.0, inicio = relogio_us();
+    for (uint v = 0; v < vezes; v++) {
+        for (uint i = 0; i < num_pacotes; i++) {
+            const pacote_t *p = &pacotes[i];
+            bool sacn = p->porta == SACN_PORTA;
+            if (sendto(tx, p->dados, p->tamanho, 0, (struct sockaddr *)(sacn ? &destino_sacn : &destino_ddp),
+                       sizeof(struct sockaddr_in)) != (ssize_t)p->tamanho) {
+                perror("sendto");
+                return false;
+            }
+            ssize_t n = recv(sacn ? rx_sacn : rx_ddp, buffer, sizeof(buffer), 0);
+            if (n < 0) {
+                perror("recv");
+                return false;
+            }
+            double t0 = relogio_us();
+            resultados[rede_receber(buffer, n, p->porta)]++;
+            parser_us += relogio_us() - t0;
+            por_porta[!sacn]++;
+        }
+    }
+    double total_us = relogio_us() - inicio;
+    close(rx_sacn);
+    close(rx_ddp);
+    close(tx);
+    uint enviados = vezes * num_pacotes;
+    if (mostrar) {
+        printf("%u pacotes (%u E1.31, %u DDP) em %.1f ms: %.0f pacotes/s pelo loopback\n", enviados, por_porta[0],
+               por_porta[1], total_us / 1000, enviados / (total_us / 1e6));
+        printf("parser e desenho: %.0f pacotes/s (%.2f us por pacote)\n", enviados / (parser_us / 1e6),
+               enviados ? parser_us / enviados : 0.0);
+        printf("%lu quadros mostrados; %u aceitos, %u fora de ordem, %u inválidos, %u ignorados\n",
+               (unsigned long)(rede.quadros - quadros_antes), resultados[REDE_ACEITO], resultados[REDE_FORA_DE_ORDEM],
+               resultados[REDE_INVALIDO],
+               resultados[REDE_IGNORADO] + resultados[REDE_OUTRA_FONTE] + resultados[REDE_PAUSADO]);
+    }
+    return true;
+}
+
+static int falhas;
+
+static void conferir(bool ok, const char *caso) {
+    printf("%-4s %s\n", ok ? "ok" : "ERRO", caso);
+    falhas += !ok;
+}
+
+static bool matriz_igual(const uint8_t canais[REDE_CANAIS]) {
+    for (uint i = 0; i < NUM_LEDS; i++) {
+        const npLED16_t *px = &leds_hd[correcao_index(i)];
+        if (px->R >> 8 != canais[3 * i] || px->G >> 8 != canais[3 * i + 1] || px->B >> 8 != canais[3 * i + 2])
+            return false;
+    }
+    return true;
+}
+
+static bool matriz_apagada(void) {
+    for (uint i = 0; i < NUM_LEDS; i++)
+        if (leds_hd[i].R || leds_hd[i].G || leds_hd[i].B)
+            return false;
+    return true;
+}
+
+static rede_resultado_t e131(const uint8_t *cid, uint16_t universo, uint8_t sequencia, uint8_t prioridade, uint8_t opcoes,
+                             uint16_t sincronia, const uint8_t *canais) {
+    uint8_t p[PACOTE_MAX];
+    uint n = montar_e131(p, cid, universo, sequencia, prioridade, opcoes, sincronia, canais, REDE_CANAIS);
+    return rede_receber(p, n, SACN_PORTA);
+}
+
+static rede_resultado_t ddp(uint8_t flags, uint8_t sequencia, uint32_t offset, const uint8_t *dados, uint n) {
+    uint8_t p[PACOTE_MAX];
+    uint tamanho = montar_ddp(p, flags, sequencia, offset, dados, n);
+    return rede_receber(p, tamanho, DDP_PORTA);
+}
+
+static int conferir_tudo(void) {
+    uint8_t a[REDE_CANAIS], b[REDE_CANAIS], c[REDE_CANAIS], p[PACOTE_MAX];
+    padrao(1, a);
+    padrao(2, b);
+    padrao(3, c);
+    uint32_t q;
+
+    q = rede.quadros;
+    conferir(e131(cid_mesa, REDE_UNIVERSO, 10, 100, 0, 0, a) == REDE_ACEITO && matriz_igual(a) && rede.quadros == q + 1,
+             "E1.31: quadro desenhado e mostrado");
+    conferir(e131(cid_mesa, REDE_UNIVERSO, 10, 100, 0, 0, b) == REDE_FORA_DE_ORDEM && matriz_igual(a),
+             "E1.31: sequência repetida descartada");
+    conferir(e131(cid_mesa, REDE_UNIVERSO, 5, 100, 0, 0, b) == REDE_FORA_DE_ORDEM && matriz_igual(a),
+             "E1.31: sequência velha descartada");
+    conferir(e131(cid_mesa, REDE_UNIVERSO, 11, 100, 0, 0, b) == REDE_ACEITO && matriz_igual(b),
+             "E1.31: sequência seguinte aceita");
+    conferir(e131(cid_mesa, REDE_UNIVERSO, 200, 100, 0, 0, a) == REDE_ACEITO && matriz_igual(a),
+             "E1.31: salto para fora da janela aceito (fonte reiniciou)");
+    conferir(e131(cid_mesa, REDE_UNIVERSO + REDE_UNIVERSOS, 201, 100, 0, 0, b) == REDE_IGNORADO && matriz_igual(a),
+             "E1.31: outro universo ignorado");
+    conferir(e131(cid_mesa, REDE_UNIVERSO, 201, 100, E131_PREVIA, 0, b) == REDE_IGNORADO && matriz_igual(a),
+             "E1.31: pré-visualização ignorada");
+    conferir(e131(cid_outra, REDE_UNIVERSO, 0, 100, 0, 0, b) == REDE_OUTRA_FONTE && matriz_igual(a),
+             "E1.31: outra fonte de mesma prioridade ignorada");
+    conferir(e131(cid_outra, REDE_UNIVERSO, 255, 150, 0, 0, b) == REDE_ACEITO && matriz_igual(b),
+             "E1.31: fonte de prioridade maior assume");
+    conferir(e131(cid_outra, REDE_UNIVERSO, 0, 150, 0, 0, c) == REDE_ACEITO && matriz_igual(c),
+             "E1.31: sequência volta de 255 para 0");
+    conferir(e131(cid_mesa, REDE_UNIVERSO, 202, 100, 0, 0, a) == REDE_OUTRA_FONTE && matriz_igual(c),
+             "E1.31: fonte antiga, de prioridade menor, ignorada");
+
+    q = rede.quadros;
+    e131(cid_outra, REDE_UNIVERSO, 1, 150, 0, 7000, a);
+    bool esperou = rede.quadros == q;
+    uint n = montar_sincronia(p, cid_outra, 0, 7001);
+    bool outra_sincronia = rede_receber(p, n, SACN_PORTA) == REDE_IGNORADO && rede.quadros == q;
+    n = montar_sincronia(p, cid_outra, 1, 7000);
+    conferir(esperou && outra_sincronia && rede_receber(p, n, SACN_PORTA) == REDE_ACEITO && rede.quadros == q + 1 &&
+                 matriz_igual(a),
+             "E1.31: quadro com sincronia só aparece na sincronia");
+
+    memset(p, 0, 60);
+    conferir(rede_receber(p, 60, SACN_PORTA) == REDE_INVALIDO && rede_receber(p, 5, DDP_PORTA) == REDE_INVALIDO,
+             "pacotes malformados recusados");
+    n = montar_e131(p, cid_outra, REDE_UNIVERSO, 2, 150, 0, 0, b, REDE_CANAIS);
+    conferir(rede_receber(p, n - 1, SACN_PORTA) == REDE_INVALIDO && matriz_igual(a), "E1.31: pacote cortado recusado");
+
+    conferir(e131(cid_outra, REDE_UNIVERSO, 3, 150, E131_TERMINADO, 0, b) == REDE_ACEITO && !rede.ativo && matriz_apagada(),
+             "E1.31: fim do fluxo apaga a matriz");
+
+    // DDP em duas partes; o corte cai no meio de um LED
+    const uint corte = 40;
+    q = rede.quadros;
+    bool parte1 = ddp(0, 1, REDE_DDP_OFFSET, a, corte) == REDE_ACEITO && rede.quadros == q;
+    conferir(parte1 && ddp(DDP_PUSH, 2, REDE_DDP_OFFSET + corte, a + corte, REDE_CANAIS - corte) == REDE_ACEITO &&
+                 rede.quadros == q + 1 && matriz_igual(a),
+             "DDP: quadro em duas partes mostrado no push");
+    conferir(ddp(DDP_PUSH, 2, REDE_DDP_OFFSET, b, REDE_CANAIS) == REDE_FORA_DE_ORDEM && matriz_igual(a),
+             "DDP: sequência repetida descartada");
+    conferir(ddp(DDP_PUSH, 15, REDE_DDP_OFFSET, b, REDE_CANAIS) == REDE_FORA_DE_ORDEM && matriz_igual(a),
+             "DDP: sequência velha descartada");
+    conferir(ddp(DDP_PUSH | DDP_TEMPO, 3, REDE_DDP_OFFSET, b, REDE_CANAIS) == REDE_ACEITO && matriz_igual(b),
+             "DDP: cabeçalho com timecode");
+    conferir(ddp(DDP_PUSH, 0, REDE_DDP_OFFSET, c, REDE_CANAIS) == REDE_ACEITO && ddp(DDP_PUSH, 0, REDE_DDP_OFFSET, a, REDE_CANAIS) == REDE_ACEITO &&
+                 matriz_igual(a),
+             "DDP: sequência 0 não é conferida");
+    conferir(ddp(DDP_PUSH, 0, REDE_DDP_OFFSET + 3, b, REDE_CANAIS) == REDE_ACEITO && matriz_igual(a) == false &&
+                 leds_hd[correcao_index(0)].R >> 8 == a[0] && leds_hd[correcao_index(1)].R >> 8 == b[0],
+             "DDP: offset desloca os LEDs e o excesso é cortado");
+
+    // Uma ação local tem a matriz até a fonte parar de mandar
+    rede_pausar();
+    conferir(ddp(DDP_PUSH, 0, REDE_DDP_OFFSET, c, REDE_CANAIS) == REDE_PAUSADO && !matriz_igual(c),
+             "pausa: pacotes não desenham");
+    absolute_time_t prazo = at_the_end_of_time;
+    sleep_ms(REDE_TIMEOUT_MS - 100);
+    rede_tick(&prazo);
+    bool ainda = rede.pausada;
+    sleep_ms(REDE_TIMEOUT_MS + 1);
+    rede_tick(&prazo);
+    conferir(ainda && !rede.pausada && ddp(DDP_PUSH, 0, REDE_DDP_OFFSET, c, REDE_CANAIS) == REDE_ACEITO && matriz_igual(c),
+             "pausa: acaba quando a fonte fica quieta");
+    sleep_ms(REDE_TIMEOUT_MS + 1);
+    rede_tick(&prazo);
+    conferir(!rede.ativo && matriz_apagada(), "timeout: fonte sumiu, matriz apagada");
+
+    // Captura gerada, gravada, lida de volta e repetida pelo loopback
+    char caminho[] = "/tmp/led_matrix_rede_XXXXXX";
+    int fd = mkstemp(caminho);
+    if (fd >= 0)
+        close(fd);
+    const uint quadros = 40;
+    gerar_pacotes(quadros);
+    uint descartaveis = gerados_descartaveis, gerados = num_pacotes;
+    bool lido = fd >= 0 && gravar_pcap(caminho) && ler_pcap(caminho) && num_pacotes == gerados;
+    unlink(caminho);
+    uint32_t quadros_antes = rede.quadros, descartados_antes = rede.fora_de_ordem;
+    bool repetido = lido && repetir(1, false);
+    padrao(2 * quadros - 1, c);
+    conferir(repetido && rede.quadros - quadros_antes == 2 * quadros && matriz_igual(c) &&
+                 rede.fora_de_ordem - descartados_antes == descartaveis,
+             "captura gerada repetida pelo loopback");
+
+    printf("rede: %s\n", falhas ? "ERRO" : "ok");
+    return falhas ? 1 : 0;
+}
+
+int main(int argc, char **argv) {
+    const char *captura = NULL, *gerar = NULL;
+    uint vezes = 1, quadros = 400;
+    bool modo_conferir = false;
+    for (int a = 1; a < argc; a++) {
+        if (!strcmp(argv[a], "--repetir") && a + 1 < argc) {
+            vezes = (uint)atoi(argv[++a]);
+        } else if (!strcmp(argv[a], "--gerar") && a + 1 < argc) {
+            gerar = argv[++a];
+        } else if (!strcmp(argv[a], "--quadros") && a + 1 < argc) {
+            quadros = (uint)atoi(argv[++a]);
+        } else if (!strcmp(argv[a], "--conferir")) {
+            modo_conferir = true;
+        } else if (argv[a][0] != '-' && !captura) {
+            captura = argv[a];
+        } else {
+            fprintf(stderr, "uso: %s captura.pcap [--repetir n] | --gerar captura.pcap [--quadros n] | --conferir\n", argv[0]);
+            return 2;
+        }
+    }
+
+    npInit(MATRIZ_PIN);
+    npSetDither(false);
+
+    if (modo_conferir)
+        return conferir_tudo();
+    if (gerar) {
+        gerar_pacotes(quadros);
+        if (!gravar_pcap(gerar))
+            return 1;
+        printf("%s: %u quadros E1.31 e %u em DDP\n", gerar, quadros, quadros);
+        return 0;
+    }
+    if (!captura) {
+        fprintf(stderr, "%s: informe uma captura, --gerar ou --conferir\n", argv[0]);
+        return 2;
+    }
+    if (!ler_pcap(captura))
+        return 1;
+    if (!num_pacotes) {
+        fprintf(stderr, "%s: nenhum pacote UDP para as portas %d (E1.31) ou %d (DDP)\n", captura, SACN_PORTA, DDP_PORTA);
+        return 1;
+    }
+    return repetir(vezes ? vezes : 1, true) ? 0 : 1;
+}
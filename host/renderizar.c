@@ -0,0 +1,224 @@
+// Renderizador sem tela: toca cada clipe com o player de verdade, sobre a plataforma
+// simulada, e guarda cada quadro que chega aos LEDs (o que o DMA manda para a PIO) com o
+// instante em que foi travado. Para cada clipe escreve um hash por quadro em <nome>.txt e,
+// se pedido, uma tira PPM com todos os quadros lado a lado.
+//
+//   led_matrix_renderizar [--saida pasta] [--ppm pasta] [--escala n] [--verificar pasta] [clipe...]
+//
+// Com --verificar, compara com os arquivos da pasta (os "golden") e termina com erro no
+// primeiro quadro diferente, para rodar em CI.
+#define LED_MATRIX_SEM_MAIN
+#include "led_matrix.c"
+
+#include <string.h>
+
+#include "pico_host.h"
+
+#define MAX_CAPTURAS 4096
+
+typedef struct {
+    uint64_t instante_us; // Desde o início do clipe
+    npLED_t pixels[NUM_LEDS]; // Bytes do fio, no FORMATO_PIXEL do firmware
+} captura_t;
+
+static captura_t capturas[MAX_CAPTURAS];
+static uint num_capturas;
+static absolute_time_t inicio_clipe;
+
+static void capturar(PIO pio, uint maquina, const void *dados, uint quantidade, uint tamanho_palavra, absolute_time_t instante) {
+    if (pio != np_pio || maquina != sm || tamanho_palavra != 1 || quantidade != sizeof(leds))
+        return;
+    if (num_capturas == MAX_CAPTURAS)
+        panic("renderizar: mais de %d quadros num clipe", MAX_CAPTURAS);
+    capturas[num_capturas].instante_us = absolute_time_diff_us(inicio_clipe, instante);
+    memcpy(capturas[num_capturas].pixels, dados, sizeof(leds));
+    num_capturas++;
+}
+
+// FNV-1a de 64 bits dos bytes do fio
+static uint64_t hash_quadro(const captura_t *c) {
+    uint64_t h = 0xcbf29ce484222325ull;
+    const uint8_t *p = (const uint8_t *)c->pixels;
+    for (size_t i = 0; i < sizeof(c->pixels); i++) {
+        h ^= p[i];
+        h *= 0x100000001b3ull;
+    }
+    return h;
+}
+
+static const struct {
+    const char *nome;
+    const clip_t *clip;
+} clipes[] = {
+    {"bia", &clip_Bia},
+    {"lorenzo", &clip_Lorenzo},
+    {"vini", &clip_vini},
+    {"ruan", &clip_ruan},
+    {"vinicobra", &clip_vinicobra},
+    {"vinitetris", &clip_vinitetris},
+    {"joao", &clip_joao},
+    {"vinibrasil", &clip_vinibrasil},
+    {"filipe_bubble", &clip_filipe_bubble},
+    {"filipe_pong", &clip_filipe_pong},
+    {"pong", &clip_pong},
+    {"chuva", &clip_chuva},
+};
+
+#define NUM_CLIPES (sizeof(clipes) / sizeof(clipes[0]))
+
+static void renderizar(const clip_t *clip) {
+    // O quadro apagado do fim do clipe anterior ainda ocupa o fio; cada clipe começa com a
+    // linha livre, para não depender de qual veio antes
+    sleep_until(np_livre_em);
+    num_capturas = 0;
+    inicio_clipe = get_absolute_time();
+    item_playlist_t item = {clip, 1, 0, 0};
+    player_iniciar(&item);
+    absolute_time_t prazo = at_the_end_of_time;
+    while (player_tick(&prazo))
+        best_effort_wfe_or_timeout(prazo);
+}
+
+static void escrever_hashes(FILE *f, const char *nome) {
+    fprintf(f, "# %s: %u quadros (instante em us, hash FNV-1a dos bytes GRB na ordem da fita)\n", nome, num_capturas);
+    for (uint i = 0; i < num_capturas; i++)
+        fprintf(f, "%llu %016llx\n", (unsigned long long)capturas[i].instante_us, (unsigned long long)hash_quadro(&capturas[i]));
+}
+
+// Tira PPM: um quadro ao lado do outro, como a matriz é vista de frente, separados por uma
+// coluna cinza
+static bool escrever_ppm(const char *caminho, uint escala) {
+    FILE *f = fopen(caminho, "wb");
+    if (!f)
+        return false;
+    uint largura_quadro = 5 * escala + 1;
+    uint largura = num_capturas * largura_quadro, altura = 5 * escala;
+    fprintf(f, "P6\n%u %u\n255\n", largura ? largura : 1, altura);
+    for (uint y = 0; y < altura; y++) {
+        for (uint x = 0; x < largura; x++) {
+            const captura_t *c = &capturas[x / largura_quadro];
+            uint coluna = x % largura_quadro;
+            uint8_t rgb[3] = {64, 64, 64};
+            if (coluna < 5 * escala) {
+                const npLED_t *px = &c->pixels[correcao_index((y / escala) * 5 + coluna / escala)];
+                rgb[0] = px->R;
+                rgb[1] = px->G;
+                rgb[2] = px->B;
+            }
+            fwrite(rgb, 1, 3, f);
+        }
+    }
+    if (!largura)
+        fwrite("\0\0\0", 1, 3, f);
+    return fclose(f) == 0;
+}
+
+// Compara com o arquivo golden; devolve false e explica a primeira diferença
+static bool verificar(const char *caminho, const char *nome) {
+    FILE *f = fopen(caminho, "r");
+    if (!f) {
+        fprintf(stderr, "%s: sem arquivo golden %s\n", nome, caminho);
+        return false;
+    }
+    char linha[128];
+    uint i = 0;
+    bool ok = true;
+    while (ok && fgets(linha, sizeof(linha), f)) {
+        if (linha[0] == '#')
+            continue;
+        unsigned long long instante, hash;
+        if (sscanf(linha, "%llu %llx", &instante, &hash) != 2)
+            continue;
+        if (i >= num_capturas) {
+            fprintf(stderr, "%s: faltam quadros a partir do %u (t=%llu us)\n", nome, i, instante);
+            ok = false;
+        } else if (capturas[i].instante_us != instante || hash_quadro(&capturas[i]) != hash) {
+            fprintf(stderr, "%s: quadro %u difere: esperado t=%llu us %016llx, obtido t=%llu us %016llx\n", nome, i,
+                    instante, hash, (unsigned long long)capturas[i].instante_us, (unsigned long long)hash_quadro(&capturas[i]));
+            ok = false;
+        }
+        i++;
+    }
+    fclose(f);
+    if (ok && i != num_capturas) {
+        fprintf(stderr, "%s: %u quadros a mais que o golden\n", nome, num_capturas - i);
+        ok = false;
+    }
+    return ok;
+}
+
+int main(int argc, char **argv) {
+    const char *saida = NULL, *pasta_ppm = NULL, *pasta_golden = NULL;
+    uint escala = 8;
+    bool escolhido[NUM_CLIPES] = {false};
+    bool algum = false;
+
+    for (int a = 1; a < argc; a++) {
+        if (!strcmp(argv[a], "--saida") && a + 1 < argc) {
+            saida = argv[++a];
+        } else if (!strcmp(argv[a], "--ppm") && a + 1 < argc) {
+            pasta_ppm = argv[++a];
+        } else if (!strcmp(argv[a], "--escala") && a + 1 < argc) {
+            escala = (uint)atoi(argv[++a]);
+            if (escala < 1)
+                escala = 1;
+        } else if (!strcmp(argv[a], "--verificar") && a + 1 < argc) {
+            pasta_golden = argv[++a];
+        } else {
+            uint c;
+            for (c = 0; c < NUM_CLIPES && strcmp(argv[a], clipes[c].nome); c++)
+                ;
+            if (c == NUM_CLIPES) {
+                fprintf(stderr, "uso: %s [--saida pasta] [--ppm pasta] [--escala n] [--verificar pasta] [clipe...]\n", argv[0]);
+                return 2;
+            }
+            escolhido[c] = algum = true;
+        }
+    }
+
+    // Mesmo estado do firmware depois do boot, mas sem o dithering: com ele cada clipe
+    // teria milhares de quadros de ruído temporal em vez dos quadros da animação
+    host_ao_transmitir = capturar;
+    npInit(MATRIZ_PIN);
+    npSetDither(false);
+    compositor_ativar();
+    camada_configurar(CAMADA_INTERFACE, MISTURA_NORMAL, 255, true);
+    tomInit(BUZZER);
+
+    int falhas = 0;
+    for (uint c = 0; c < NUM_CLIPES; c++) {
+        if (algum && !escolhido[c])
+            continue;
+        renderizar(clipes[c].clip);
+        char caminho[512];
+        if (saida) {
+            snprintf(caminho, sizeof(caminho), "%s/%s.txt", saida, clipes[c].nome);
+            FILE *f = fopen(caminho, "w");
+            if (!f) {
+                perror(caminho);
+                return 1;
+            }
+            escrever_hashes(f, clipes[c].nome);
+            fclose(f);
+        }
+        if (pasta_ppm) {
+            snprintf(caminho, sizeof(caminho), "%s/%s.ppm", pasta_ppm, clipes[c].nome);
+            if (!escrever_ppm(caminho, escala)) {
+                perror(caminho);
+                return 1;
+            }
+        }
+        if (pasta_golden) {
+            snprintf(caminho, sizeof(caminho), "%s/%s.txt", pasta_golden, clipes[c].nome);
+            if (!verificar(caminho, clipes[c].nome))
+                falhas++;
+        }
+        if (!saida && !pasta_ppm && !pasta_golden)
+            escrever_hashes(stdout, clipes[c].nome);
+        else
+            printf("%s: %u quadros\n", clipes[c].nome, num_capturas);
+    }
+    if (pasta_golden)
+        printf("%s\n", falhas ? "golden: DIFERENTE" : "golden: ok");
+    return falhas ? 1 : 0;
+}
@@ -0,0 +1,331 @@
+// Confere a temporização do fio dos LEDs sem placa: monta ws2818b.pio, configura a máquina
+// com o ws2818b_program_init de verdade para cada clk_sys e executa o programa no emulador
+// ciclo a ciclo (host/emulador_pio.c) com os bytes de um quadro. Da forma de onda no pino
+// mede T0H/T0L/T1H/T1L de cada bit, decodifica os bits como um WS2812B faria e compara com
+// os bytes enviados. O intervalo de reset entre quadros vem do próprio firmware: os
+// instantes em que npTransmitir dispara o DMA num envio seguido e com o dithering ligado.
+// Depois repete para cada perfil de clock, agora com a máquina reajustada em funcionamento
+// por clock_perfil_aplicar em vez de iniciada de novo.
+//
+//   led_matrix_temporizacao [--clk MHz]... [--animacao nome [--quadro n]] [--vcd pasta]
+//
+// Sem --animacao usa um padrão de teste com todas as transições entre bits. Com --vcd grava
+// a forma de onda de cada clk_sys (abre no GTKWave/PulseView). Termina com erro se algum
+// limite do datasheet for violado.
+#define LED_MATRIX_SEM_MAIN
+#include "led_matrix.c"
+
+#include <string.h>
+
+#include "emulador_pio.h"
+#include "pico_host.h"
+
+// Limites do datasheet do WS2812B (V5), em ns
+#define T0H_MIN 220
+#define T0H_MAX 380
+#define T1H_MIN 580
+#define T1H_MAX 1000
+#define T0L_MIN 580
+#define T0L_MAX 1000
+#define T1L_MIN 220
+#define T1L_MAX 420
+#define RESET_MIN_US 280
+// Reset no limite exato do datasheet passa por pouco e falha no primeiro LED mais lento;
+// o firmware tem que deixar pelo menos esta folga a mais.
+#define RESET_FOLGA_US 10
+// Os máximos de tempo baixo do datasheet não são o que quebra a comunicação: o que importa
+// é o bit não ser confundido com reset. Acima deles só avisa; acima deste valor é erro.
+#define BAIXO_MAX_PRATICO 5000
+
+#define MAX_CLOCKS 16
+#define MAX_ENVIOS 64
+
+static const uint32_t clocks_padrao_mhz[] = {12, 24, 48, 125, 133, 200, 250};
+
+// Bytes de um quadro como o DMA entrega para a FIFO
+static uint8_t quadro[sizeof(leds)];
+
+// Instantes em que o firmware disparou uma transmissão
+static absolute_time_t envios[MAX_ENVIOS];
+static uint num_envios;
+static bool capturar_quadro;
+
+static void ao_transmitir(PIO pio, uint maquina, const void *dados, uint quantidade, uint tamanho_palavra, absolute_time_t instante) {
+    if (pio != np_pio || maquina != sm || tamanho_palavra != 1 || quantidade != sizeof(leds))
+        return;
+    if (capturar_quadro)
+        memcpy(quadro, dados, sizeof(quadro));
+    if (num_envios < MAX_ENVIOS)
+        envios[num_envios++] = instante;
+}
+
+// Transições do pino: ciclo de clk_sys e nível a partir dele
+typedef struct {
+    uint64_t ciclo;
+    bool nivel;
+} transicao_t;
+
+static transicao_t *transicoes;
+static uint num_transicoes, capacidade_transicoes;
+
+static void registrar(uint64_t ciclo, bool nivel) {
+    if (num_transicoes == capacidade_transicoes) {
+        capacidade_transicoes = capacidade_transicoes ? 2 * capacidade_transicoes : 4096;
+        transicoes = realloc(transicoes, capacidade_transicoes * sizeof(*transicoes));
+        if (!transicoes)
+            panic("temporizacao: sem memória");
+    }
+    transicoes[num_transicoes++] = (transicao_t){ciclo, nivel};
+}
+
+// Executa o programa com o quadro, alimentando a FIFO como o DMA (sempre que há espaço),
+// até a máquina parar no primeiro out sem dados. Cada byte é escrito na FIFO com uma
+// escrita de 8 bits, que o barramento do RP2040 replica nas quatro faixas da palavra.
+static void emular_quadro(emulador_pio_t *e, uint pino) {
+    num_transicoes = 0;
+    registrar(0, emulador_pio_pino(e, pino));
+    uint enviados = 0;
+    for (;;) {
+        while (enviados < sizeof(quadro) && emulador_pio_escrever(e, quadro[enviados] * 0x01010101u))
+            enviados++;
+        uint64_t inicio = e->ciclos_sys;
+        bool antes = emulador_pio_pino(e, pino);
+        emulador_pio_ciclo(e);
+        if (emulador_pio_pino(e, pino) != antes)
+            registrar(inicio, !antes);
+        if (e->parada && enviados == sizeof(quadro) && !e->fifo_tamanho)
+            break;
+    }
+    registrar(e->ciclos_sys, emulador_pio_pino(e, pino));
+}
+
+typedef struct {
+    double minimo, maximo;
+    uint amostras;
+} faixa_t;
+
+static void acumular(faixa_t *f, double ns) {
+    if (!f->amostras || ns < f->minimo)
+        f->minimo = ns;
+    if (!f->amostras || ns > f->maximo)
+        f->maximo = ns;
+    f->amostras++;
+}
+
+typedef enum { OK, AVISO, ERRO } veredito_t;
+
+static const char *nome_veredito[] = {"ok", "AVISO", "ERRO"};
+
+static veredito_t pior(veredito_t a, veredito_t b) { return a > b ? a : b; }
+
+static veredito_t conferir(const char *nome, const faixa_t *f, double minimo, double maximo, bool maximo_estrito) {
+    if (!f->amostras)
+        return OK;
+    veredito_t v = OK;
+    if (f->minimo < minimo || f->maximo > BAIXO_MAX_PRATICO)
+        v = ERRO;
+    else if (f->maximo > maximo)
+        v = maximo_estrito ? ERRO : AVISO;
+    printf("  %s %4.0f-%4.0f ns (%4.0f-%4.0f)%s", nome, f->minimo, f->maximo, minimo, maximo, v == OK ? "" : v == AVISO ? " aviso" : " ERRO");
+    return v;
+}
+
+static void escrever_vcd(const char *pasta, uint32_t clk_hz) {
+    char caminho[512];
+    snprintf(caminho, sizeof(caminho), "%s/ws2818b_%uMHz.vcd", pasta, (unsigned)(clk_hz / 1000000));
+    FILE *f = fopen(caminho, "w");
+    if (!f) {
+        perror(caminho);
+        exit(1);
+    }
+    fprintf(f, "$comment ws2818b a clk_sys = %u Hz $end\n$timescale 1ps $end\n", (unsigned)clk_hz);
+    fprintf(f, "$scope module matriz $end\n$var wire 1 ! din $end\n$upscope $end\n$enddefinitions $end\n");
+    for (uint i = 0; i < num_transicoes; i++)
+        fprintf(f, "#%llu\n%c!\n", (unsigned long long)(transicoes[i].ciclo * 1000000000000ull / clk_hz), transicoes[i].nivel ? '1' : '0');
+    fclose(f);
+}
+
+// Emula o quadro com a configuração atual da máquina da matriz e confere cada bit;
+// 'duracao_us' recebe a duração do quadro no fio
+static veredito_t conferir_maquina(const char *pasta_vcd, double *duracao_us) {
+    uint32_t clk_hz = clock_get_hz(clk_sys);
+    const pio_sm_config *config = host_pio_config(np_pio, sm);
+    emulador_pio_t e;
+    emulador_pio_iniciar(&e, &ws2818b_program, 0, config, 0);
+    emular_quadro(&e, config->sideset_base);
+    if (pasta_vcd)
+        escrever_vcd(pasta_vcd, clk_hz);
+
+    const double ns_por_ciclo = 1e9 / clk_hz;
+    faixa_t t0h = {0}, t0l = {0}, t1h = {0}, t1l = {0};
+    uint8_t decodificado[sizeof(quadro)] = {0};
+    uint bits = 0, ambiguos = 0;
+    uint64_t primeira_subida = 0, ultima_descida = 0;
+    for (uint i = 1; i + 1 < num_transicoes; i++) {
+        if (!transicoes[i].nivel)
+            continue;
+        // Um bit: subida em i, descida em i+1 e a próxima subida (se houver) em i+2
+        double alto = (transicoes[i + 1].ciclo - transicoes[i].ciclo) * ns_por_ciclo;
+        bool tem_baixo = i + 2 < num_transicoes - 1;
+        double baixo = tem_baixo ? (transicoes[i + 2].ciclo - transicoes[i + 1].ciclo) * ns_por_ciclo : 0;
+        if (!bits)
+            primeira_subida = transicoes[i].ciclo;
+        ultima_descida = transicoes[i + 1].ciclo;
+
+        bool um = alto >= T1H_MIN;
+        if (!um && alto > T0H_MAX)
+            ambiguos++;
+        acumular(um ? &t1h : &t0h, alto);
+        if (tem_baixo)
+            acumular(um ? &t1l : &t0l, baixo);
+        // O WS2812B recebe cada byte do bit mais significativo para o menos
+        if (bits / 8 < sizeof(decodificado) && um)
+            decodificado[bits / 8] |= 0x80 >> (bits % 8);
+        bits++;
+    }
+    *duracao_us = (ultima_descida - primeira_subida) * ns_por_ciclo / 1000;
+
+    printf("clk_sys %6.2f MHz  clkdiv %8.4f (%u + %u/256)\n", clk_hz / 1e6, (double)config->clkdiv,
+           (unsigned)e.div_inteiro, (unsigned)e.div_fracao);
+    veredito_t v = OK;
+    v = pior(v, conferir("T0H", &t0h, T0H_MIN, T0H_MAX, true));
+    v = pior(v, conferir("T1H", &t1h, T1H_MIN, T1H_MAX, true));
+    printf("\n");
+    v = pior(v, conferir("T0L", &t0l, T0L_MIN, T0L_MAX, false));
+    v = pior(v, conferir("T1L", &t1l, T1L_MIN, T1L_MAX, false));
+    printf("\n");
+
+    uint esperados = sizeof(quadro) * 8;
+    bool dados_ok = bits == esperados && !ambiguos && !memcmp(decodificado, quadro, sizeof(quadro));
+    printf("  %u de %u bits, %u ambíguos, decodificação %s, quadro %.1f us\n", bits, esperados, ambiguos,
+           dados_ok ? "ok" : "DIFERENTE", *duracao_us);
+    if (!dados_ok) {
+        v = ERRO;
+        for (uint i = 0; i < sizeof(quadro); i++) {
+            if (decodificado[i] != quadro[i]) {
+                printf("  primeiro byte diferente: %u (enviado 0x%02x, recebido 0x%02x)\n", i, quadro[i], decodificado[i]);
+                break;
+            }
+        }
+    }
+    return v;
+}
+
+// Menor intervalo em nível baixo entre dois quadros seguidos, com os quadros saindo na
+// ordem e sem sobrepor (o DMA de um só começa a valer no fio depois do anterior)
+static double menor_reset_us(double duracao_us) {
+    double menor = -1, fim_anterior = 0;
+    for (uint i = 0; i < num_envios; i++) {
+        double inicio = (double)to_us_since_boot(envios[i]);
+        if (i) {
+            if (inicio < fim_anterior)
+                inicio = fim_anterior;
+            double intervalo = inicio - fim_anterior;
+            if (menor < 0 || intervalo < menor)
+                menor = intervalo;
+        }
+        fim_anterior = inicio + duracao_us;
+    }
+    return menor;
+}
+
+static veredito_t conferir_com_reset(const char *pasta_vcd) {
+    double duracao_us;
+    veredito_t v = conferir_maquina(pasta_vcd, &duracao_us);
+    double reset = menor_reset_us(duracao_us);
+    veredito_t v_reset = reset >= RESET_MIN_US + RESET_FOLGA_US ? OK : ERRO;
+    printf("  reset entre quadros: menor %.1f us em %u envios (>= %d)%s\n", reset, num_envios,
+           RESET_MIN_US + RESET_FOLGA_US,
+           v_reset == OK ? "" : " ERRO");
+    v = pior(v, v_reset);
+    printf("  => %s\n", nome_veredito[v]);
+    return v;
+}
+
+static void padrao_de_teste(void) {
+    // Todas as combinações de bits vizinhos, bytes simétricos e assimétricos (que revelam
+    // ordem de bits trocada) e os extremos
+    static const uint8_t padrao[] = {0x00, 0xFF, 0xAA, 0x55, 0x01, 0x80, 0x0F, 0xF0, 0x33, 0xCC, 0x7F, 0xFE, 0x12, 0xED};
+    for (uint i = 0; i < sizeof(quadro); i++)
+        quadro[i] = padrao[i % sizeof(padrao)];
+}
+
+int main(int argc, char **argv) {
+    uint32_t clocks[MAX_CLOCKS];
+    uint num_clocks = 0;
+    const char *nome_animacao = NULL, *pasta_vcd = NULL;
+    uint numero_quadro = 0;
+
+    for (int a = 1; a < argc; a++) {
+        if (!strcmp(argv[a], "--clk") && a + 1 < argc && num_clocks < MAX_CLOCKS) {
+            clocks[num_clocks++] = (uint32_t)(atof(argv[++a]) * 1e6);
+        } else if (!strcmp(argv[a], "--animacao") && a + 1 < argc) {
+            nome_animacao = argv[++a];
+        } else if (!strcmp(argv[a], "--quadro") && a + 1 < argc) {
+            numero_quadro = (uint)atoi(argv[++a]);
+        } else if (!strcmp(argv[a], "--vcd") && a + 1 < argc) {
+            pasta_vcd = argv[++a];
+        } else {
+            fprintf(stderr, "uso: %s [--clk MHz]... [--animacao nome [--quadro n]] [--vcd pasta]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (!num_clocks) {
+        for (uint i = 0; i < sizeof(clocks_padrao_mhz) / sizeof(clocks_padrao_mhz[0]); i++)
+            clocks[num_clocks++] = clocks_padrao_mhz[i] * 1000000;
+    }
+
+    host_ao_transmitir = ao_transmitir;
+    npInit(MATRIZ_PIN);
+    npSetDither(false);
+
+    if (nome_animacao) {
+        const animacao_t *animacao = NULL;
+        for (uint i = 0; i < NUM_ANIMACOES; i++)
+            if (!strcmp(animacoes[i]->nome, nome_animacao))
+                animacao = animacoes[i];
+        if (!animacao || numero_quadro >= animacao->num_quadros) {
+            fprintf(stderr, "animação ou quadro inexistente: %s %u\n", nome_animacao, numero_quadro);
+            return 2;
+        }
+        capturar_quadro = true;
+        gerar_frame(animacao, numero_quadro, animacao->paleta);
+        capturar_quadro = false;
+        printf("quadro %u de %s\n", numero_quadro, nome_animacao);
+    } else {
+        padrao_de_teste();
+        printf("padrão de teste\n");
+    }
+
+    // Envios do firmware: dois npWrite seguidos (como numa troca de clipe) e depois o
+    // dithering retransmitindo por conta própria
+    num_envios = 0;
+    npWrite();
+    npWrite();
+    npSetDither(true);
+    sleep_ms(20);
+    npSetDither(false);
+
+    // Cada clk_sys com a máquina iniciada do zero por ws2818b_program_init
+    veredito_t geral = OK;
+    for (uint c = 0; c < num_clocks; c++) {
+        host_clk_sys_hz = clocks[c];
+        ws2818b_program_init(np_pio, sm, 0, MATRIZ_PIN, 800000.f);
+        geral = pior(geral, conferir_com_reset(pasta_vcd));
+    }
+
+    // Cada perfil de clock com a máquina já rodando, reajustada por clock_perfil_aplicar
+    host_clk_sys_hz = perfis_clock[PERFIL_NORMAL].khz * 1000;
+    ws2818b_program_init(np_pio, sm, 0, MATRIZ_PIN, 800000.f);
+    for (uint p = 0; p < NUM_PERFIS_CLOCK; p++) {
+        printf("perfil %s: ", perfis_clock[p].nome);
+        if (!clock_perfil_aplicar(p)) {
+            printf("clk_sys de %u kHz impossível ERRO\n", (unsigned)perfis_clock[p].khz);
+            geral = ERRO;
+            continue;
+        }
+        geral = pior(geral, conferir_com_reset(NULL));
+    }
+    printf("temporizacao: %s\n", nome_veredito[geral]);
+    return geral == ERRO ? 1 : 0;
+}
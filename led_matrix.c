@@ -1,11 +1,48 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
+#include <string.h>
 #include "pico/stdlib.h"
 #include "hardware/pio.h"
 #include "hardware/clocks.h"
+#include "hardware/dma.h"
+#include "hardware/adc.h"
+#include "hardware/pwm.h"
+#include "hardware/irq.h"
+#include "hardware/sync.h"
+#include "hardware/vreg.h"
+#include "hardware/structs/clocks.h"
+#include "hardware/structs/scb.h"
 #include "pico/bootrom.h"
 #include "ws2818b.pio.h"
+#include "tom.pio.h"
+#include "teclado.pio.h"
+#include "animacoes.h" //Gerado na compilação a partir de animacoes/*.anim
+#include "scripts.h"   //Gerado na compilação a partir de scripts/*.vms
+#if REDE_WIFI
+#include "pico/cyw43_arch.h"
+#include "lwip/udp.h"
+#include "lwip/igmp.h"
+#endif
+
+// Plano de memória. O caminho de renderização (de gerar_frame até o disparo do DMA) e o
+// refresh do dithering, que roda na interrupção do timer, ficam na SRAM: uma falta no cache
+// do XIP busca a linha na flash pela QSPI e aparece como jitter. Os buffers que o DMA lê ou
+// escreve (leds, blocos do sintetizador, anel do microfone) ficam no scratch X, um banco só
+// deles, já que o núcleo 1 não é usado; os framebuffers e as camadas, que a CPU percorre,
+// ficam nos bancos intercalados. Tabelas de animação, paletas e scripts são const e ficam na
+// flash. Com -DMEMORIA_SRAM=0 tudo volta para a flash e para a RAM comum, para medir o antes
+// e o depois no benchmark.
+#ifndef MEMORIA_SRAM
+#define MEMORIA_SRAM 1
+#endif
+#if MEMORIA_SRAM
+#define NA_SRAM(funcao) __not_in_flash_func(funcao)
+#define BUFFER_DMA(nome) __scratch_x(nome)
+#else
+#define NA_SRAM(funcao) funcao
+#define BUFFER_DMA(nome)
+#endif
 
 //Definição de pinos, variáveis e número de LED
 #define NUM_LEDS 25
@@ -23,96 +60,522 @@ const uint8_t linhas[4] = {5, 6, 7, 8};  // Pinos das linhas
     {'*', '0', '#', 'D'}
     };
 
-uint32_t musica_tetris[]={
-659,494,523,587,494,523,440,440,
-494,587,659,523,587,494,523,440,
-523,494,440,440,494,659,587,523,
-494,494,523,587,659,523,587,494,
-659,494,523,587,494,523,440,440,
-494,587,659,523,587,494,523,440};
-
-uint32_t musica_hino_nacional[] = {
-330, 370, 392, 440, 392, 370, 330, 294,  
-330, 370, 392, 440, 494, 440, 392, 330,  
-349, 392, 440, 494, 440, 392, 330, 370,  
-392, 440, 392, 370, 330, 294, 330, 370,  
-392, 440, 494, 440, 392, 330, 294, 262,  
-294, 330, 370, 392, 330, 370, 392, 440
+// Músicas no formato do sequenciador: {nota MIDI, velocidade, duração em ms}.
+// PAUSA no lugar da nota é um silêncio; cada trilha toca em uma voz do sintetizador.
+#define PAUSA 0
+typedef struct {
+ uint8_t nota;        // Número MIDI (69 = Lá 440 Hz) ou PAUSA
+ uint8_t velocidade;  // Volume da nota, de 0 a 127
+ uint16_t duracao_ms;
+} evento_nota_t;
+
+typedef struct {
+ const evento_nota_t *eventos;
+ uint16_t num_eventos;
+ uint8_t duty;        // Fração do período em nível alto, em 1/256 (128 = onda quadrada)
+} trilha_t;
+
+typedef struct {
+ const trilha_t *trilhas;
+ uint8_t num_trilhas; // Uma voz por trilha, no máximo NUM_VOZES
+} musica_t;
+
+//Tetris: cada quadro de 400 ms tem 200 ms de nota e 200 ms de pausa
+const evento_nota_t melodia_tetris[]={
+{76,100,200},{PAUSA,0,200}, {71,100,200},{PAUSA,0,200}, {72,100,200},{PAUSA,0,200}, {74,100,200},{PAUSA,0,200},
+{71,100,200},{PAUSA,0,200}, {72,100,200},{PAUSA,0,200}, {69,100,200},{PAUSA,0,200}, {69,100,200},{PAUSA,0,200},
+{71,100,200},{PAUSA,0,200}, {74,100,200},{PAUSA,0,200}, {76,100,200},{PAUSA,0,200}, {72,100,200},{PAUSA,0,200},
+{74,100,200},{PAUSA,0,200}, {71,100,200},{PAUSA,0,200}, {72,100,200},{PAUSA,0,200}, {69,100,200},{PAUSA,0,200},
+{72,100,200},{PAUSA,0,200}, {71,100,200},{PAUSA,0,200}, {69,100,200},{PAUSA,0,200}, {69,100,200},{PAUSA,0,200},
+{71,100,200},{PAUSA,0,200}, {76,100,200},{PAUSA,0,200}, {74,100,200},{PAUSA,0,200}, {72,100,200},{PAUSA,0,200},
+{71,100,200},{PAUSA,0,200}, {71,100,200},{PAUSA,0,200}, {72,100,200},{PAUSA,0,200}, {74,100,200},{PAUSA,0,200},
+{76,100,200},{PAUSA,0,200}, {72,100,200},{PAUSA,0,200}, {74,100,200},{PAUSA,0,200}, {71,100,200},{PAUSA,0,200},
+{76,100,200},{PAUSA,0,200}, {71,100,200},{PAUSA,0,200}, {72,100,200},{PAUSA,0,200}, {74,100,200},{PAUSA,0,200},
+{71,100,200},{PAUSA,0,200}, {72,100,200},{PAUSA,0,200}, {69,100,200},{PAUSA,0,200}, {69,100,200},{PAUSA,0,200},
+{71,100,200},{PAUSA,0,200}, {74,100,200},{PAUSA,0,200}, {76,100,200},{PAUSA,0,200}, {72,100,200},{PAUSA,0,200},
+{74,100,200},{PAUSA,0,200}, {71,100,200},{PAUSA,0,200}, {72,100,200},{PAUSA,0,200}, {69,100,200},{PAUSA,0,200}};
+
+//Hino: cada quadro de 250 ms tem 50 ms de nota e 200 ms de pausa
+const evento_nota_t melodia_hino_nacional[] = {
+{64,100,50},{PAUSA,0,200}, {66,100,50},{PAUSA,0,200}, {67,100,50},{PAUSA,0,200}, {69,100,50},{PAUSA,0,200},
+{67,100,50},{PAUSA,0,200}, {66,100,50},{PAUSA,0,200}, {64,100,50},{PAUSA,0,200}, {62,100,50},{PAUSA,0,200},
+{64,100,50},{PAUSA,0,200}, {66,100,50},{PAUSA,0,200}, {67,100,50},{PAUSA,0,200}, {69,100,50},{PAUSA,0,200},
+{71,100,50},{PAUSA,0,200}, {69,100,50},{PAUSA,0,200}, {67,100,50},{PAUSA,0,200}, {64,100,50},{PAUSA,0,200},
+{65,100,50},{PAUSA,0,200}, {67,100,50},{PAUSA,0,200}, {69,100,50},{PAUSA,0,200}, {71,100,50},{PAUSA,0,200},
+{69,100,50},{PAUSA,0,200}, {67,100,50},{PAUSA,0,200}, {64,100,50},{PAUSA,0,200}, {66,100,50},{PAUSA,0,200},
+{67,100,50},{PAUSA,0,200}, {69,100,50},{PAUSA,0,200}, {67,100,50},{PAUSA,0,200}, {66,100,50},{PAUSA,0,200},
+{64,100,50},{PAUSA,0,200}, {62,100,50},{PAUSA,0,200}, {64,100,50},{PAUSA,0,200}, {66,100,50},{PAUSA,0,200},
+{67,100,50},{PAUSA,0,200}, {69,100,50},{PAUSA,0,200}, {71,100,50},{PAUSA,0,200}, {69,100,50},{PAUSA,0,200},
+{67,100,50},{PAUSA,0,200}, {64,100,50},{PAUSA,0,200}, {62,100,50},{PAUSA,0,200}, {60,100,50},{PAUSA,0,200},
+{62,100,50},{PAUSA,0,200}, {64,100,50},{PAUSA,0,200}, {66,100,50},{PAUSA,0,200}, {67,100,50},{PAUSA,0,200},
+{64,100,50},{PAUSA,0,200}, {66,100,50},{PAUSA,0,200}, {67,100,50},{PAUSA,0,200}, {69,100,50},{PAUSA,0,200}
 };
 
+const trilha_t trilhas_tetris[] = {
+ {melodia_tetris, sizeof(melodia_tetris)/sizeof(evento_nota_t), 128}
+};
+const musica_t musica_tetris = {trilhas_tetris, 1};
+
+const trilha_t trilhas_hino_nacional[] = {
+ {melodia_hino_nacional, sizeof(melodia_hino_nacional)/sizeof(evento_nota_t), 128}
+};
+const musica_t musica_hino_nacional = {trilhas_hino_nacional, 1};
+
 
 
 
 // Pino do buzzer
 #define BUZZER 21 // Define o pino GPIO 21 como o pino conectado ao buzzer
 
+// Base de tempo compartilhada entre vídeo e áudio.
+// Todos os quadros e notas são agendados em prazos absolutos contados a partir do
+// instante zero da animação, então o tempo gasto renderizando não se acumula.
+static absolute_time_t base_tempo;
+#define BASE_TEMPO_DESVIO_MAX_US 1000 // Orçamento de sincronia (±1 ms): só um desvio maior é avisado na serial
+
+// Marca o instante zero da linha do tempo
+void base_tempo_iniciar(void) {
+    base_tempo = get_absolute_time();
+}
+
+// Instante absoluto que fica 'ms' milissegundos depois do instante zero
+absolute_time_t base_tempo_em(uint32_t ms) {
+    return delayed_by_ms(base_tempo, ms);
+}
+
+// Tempo decorrido desde o instante zero
+uint64_t base_tempo_decorrido_us(void) {
+    return absolute_time_diff_us(base_tempo, get_absolute_time());
+}
+
+// Mesmo que base_tempo_em, com resolução de microssegundos
+absolute_time_t base_tempo_em_us(uint64_t us) {
+    return delayed_by_us(base_tempo, us);
+}
+
+// Avisa quando o fim real da animação se afastou do fim nominal mais que
+// BASE_TEMPO_DESVIO_MAX_US
+void base_tempo_relatorio(uint32_t duracao_nominal_ms) {
+    int64_t desvio = absolute_time_diff_us(base_tempo_em(duracao_nominal_ms), get_absolute_time());
+    if (desvio <= BASE_TEMPO_DESVIO_MAX_US && desvio >= -BASE_TEMPO_DESVIO_MAX_US)
+        return;
+    printf("Duração nominal %lu ms, desvio %lld us\n", (unsigned long)duracao_nominal_ms, (long long)desvio);
+}
+
+/**
+* Carrega um programa PIO e toma posse de uma máquina livre, tentando pio0 e depois pio1.
+* Retorna false se nenhum dos dois blocos tiver espaço para o programa e uma máquina livre.
+*/
+bool pio_reservar(const pio_program_t *programa, PIO *pio, uint *maquina, uint *offset) {
+ PIO blocos[2] = {pio0, pio1};
+ for (int i = 0; i < 2; i++) {
+   if (!pio_can_add_program(blocos[i], programa))
+     continue;
+   int livre = pio_claim_unused_sm(blocos[i], false);
+   if (livre < 0)
+     continue;
+   *pio = blocos[i];
+   *maquina = livre;
+   *offset = pio_add_program(blocos[i], programa);
+   return true;
+ }
+ return false;
+}
+
+// Gerador de tom em PIO: a onda quadrada é gerada pela máquina, então mudar a frequência
+// custa um push na FIFO e não há jitter. Sem máquina livre, nota_em volta a usar a CPU.
+PIO tom_pio;
+uint tom_sm;
+bool tom_disponivel = false;
+uint32_t tom_frequencia; // Frequência atual, para recalcular o meio período se clk_sys mudar
+
+void tomInit(uint pin) {
+ uint offset;
+ tom_disponivel = pio_reservar(&tom_program, &tom_pio, &tom_sm, &offset);
+ if (tom_disponivel)
+   tom_program_init(tom_pio, tom_sm, offset, pin);
+}
+
+/**
+* Muda a frequência do tom (0 silencia).
+*/
+void tom_tocar(uint32_t frequencia) {
+ tom_frequencia = frequencia;
+ if (frequencia)
+   pio_gpio_init(tom_pio, BUZZER); // O sintetizador PWM pode ter tomado o pino
+ pio_sm_put(tom_pio, tom_sm, tom_ciclos_meio_periodo(frequencia));
+}
+
+void nota(uint32_t frequencia, uint32_t tempo_ms);
+
+static int64_t tom_silenciar(alarm_id_t id, void *dados) {
+ tom_tocar(0);
+ return 0;
+}
+
+/**
+* Toca um tom por 'tempo_ms' sem bloquear: um alarme silencia a máquina PIO no fim.
+*/
+void tom_tocar_por(uint32_t frequencia, uint32_t tempo_ms) {
+ if (!tom_disponivel) {
+   nota(frequencia, tempo_ms);
+   return;
+ }
+ tom_tocar(frequencia);
+ add_alarm_in_ms(tempo_ms, tom_silenciar, NULL, true);
+}
+
+// Toca uma frequência começando no instante 'inicio' e terminando exatamente 'tempo_ms' depois.
+// Pela CPU, cada borda da onda quadrada tem seu próprio prazo absoluto, calculado a partir
+// do início, então o erro de arredondamento do meio período não se acumula ao longo da nota.
+void nota_em(uint32_t frequencia, absolute_time_t inicio, uint32_t tempo_ms) {
+    absolute_time_t fim = delayed_by_ms(inicio, tempo_ms);
+
+    sleep_until(inicio);
+    if (tom_disponivel) {
+        tom_tocar(frequencia);
+        sleep_until(fim);
+        tom_tocar(0);
+        return;
+    }
+    if (!frequencia) { // Pausa: o pino fica em nível baixo
+        gpio_put(BUZZER, 0);
+        sleep_until(fim);
+        return;
+    }
+    for (uint64_t borda = 0; ; borda++) {
+        gpio_put(BUZZER, !(borda & 1)); // Bordas pares ligam o buzzer, ímpares desligam
+        absolute_time_t proxima = delayed_by_us(inicio, (borda + 1) * 1000000ull / (2ull * frequencia));
+        if (absolute_time_diff_us(proxima, fim) <= 0)
+            break;
+        sleep_until(proxima);
+    }
+    gpio_put(BUZZER, 0);
+    sleep_until(fim);
+}
+
 // Função para tocar uma frequência por uma duração específica
 void nota(uint32_t frequencia, uint32_t tempo_ms) {
-    uint32_t delay = 1000000 / (frequencia * 2);  // Calcula o tempo de atraso em microssegundos para gerar a onda quadrada
-    uint32_t ciclo = frequencia * tempo_ms / 1000;  // Calcula o número de ciclos necessários para a duração desejada
+    nota_em(frequencia, get_absolute_time(), tempo_ms);
+}
+
+// Sintetizador polifônico: até NUM_VOZES ondas quadradas (com duty ajustável) somadas
+// e enviadas ao BUZZER por PWM. As amostras vão da memória para o registrador de
+// comparação do PWM por dois canais de DMA em pingue-pongue, ritmados por um timer de
+// DMA; a CPU só recalcula um bloco quando o DMA termina o outro. Cada trilha avança
+// por um alarme de hardware agendado no prazo absoluto do próximo evento.
+#define NUM_VOZES 4
+#define TAXA_AMOSTRAGEM 20000
+#define AMOSTRAS_POR_BLOCO 256
+#define PWM_TOPO 1023 // 4 vozes * 2 * 127 cabem em 10 bits
+
+typedef struct {
+    uint32_t fase, incremento; // Acumulador de fase de 32 bits
+    uint32_t limiar;           // Fase abaixo da qual a onda está em nível alto
+    uint16_t amplitude;
+} voz_t;
+
+typedef struct {
+    const trilha_t *trilha;
+    uint16_t proximo;
+    uint8_t voz;
+} estado_trilha_t;
+
+volatile voz_t vozes[NUM_VOZES];
+estado_trilha_t estado_trilhas[NUM_VOZES];
+alarm_id_t alarmes_trilhas[NUM_VOZES];
+uint32_t BUFFER_DMA("amostras") amostras[2][AMOSTRAS_POR_BLOCO];
+int synth_dma[2] = {-1, -1};
+dma_channel_config synth_dma_cfg[2];
+int synth_timer_dma;
+uint synth_slice;
+bool synth_tocando = false;
+
+// Frequências da 8ª oitava MIDI (notas 120 a 131) em centésimos de Hz; as outras
+// oitavas saem por deslocamento.
+static const uint32_t freq_oitava_cHz[12] = {
+    837202, 886984, 939727, 995606, 1054808, 1117530,
+    1183982, 1254385, 1328975, 1408000, 1491724, 1580427
+};
+#define NOTA_MAX 131 // Última nota da tabela; notas acima tocam como ela
+
+static uint32_t incremento_da_nota(uint8_t nota) {
+    if (nota > NOTA_MAX)
+        nota = NOTA_MAX;
+    uint32_t oitavas_abaixo = 10 - nota / 12;
+    uint64_t freq_cHz = freq_oitava_cHz[nota % 12] >> oitavas_abaixo;
+    return (freq_cHz << 32) / (100ull * TAXA_AMOSTRAGEM);
+}
+
+// Calcula um bloco de amostras somando as vozes
+static void sintetizar_bloco(uint32_t *bloco) {
+    for (int n = 0; n < AMOSTRAS_POR_BLOCO; n++) {
+        uint32_t nivel = 0;
+        for (int v = 0; v < NUM_VOZES; v++) {
+            if (!vozes[v].amplitude)
+                continue;
+            if (vozes[v].fase < vozes[v].limiar)
+                nivel += 2 * vozes[v].amplitude;
+            vozes[v].fase += vozes[v].incremento;
+        }
+        bloco[n] = nivel << PWM_CH0_CC_B_LSB; // O BUZZER está no canal B da fatia
+    }
+}
+
+static void synth_irq_dma(void) {
+    for (int i = 0; i < 2; i++) {
+        if (dma_channel_get_irq1_status(synth_dma[i])) {
+            dma_channel_acknowledge_irq1(synth_dma[i]);
+            sintetizar_bloco(amostras[i]);
+            dma_channel_set_read_addr(synth_dma[i], amostras[i], false); // O encadeamento dispara
+        }
+    }
+}
+
+// Aplica o próximo evento da trilha à sua voz e reagenda para o fim da duração
+static int64_t synth_alarme_evento(alarm_id_t id, void *dados) {
+    estado_trilha_t *t = dados;
+    volatile voz_t *voz = &vozes[t->voz];
+    if (t->proximo >= t->trilha->num_eventos) {
+        voz->amplitude = 0;
+        return 0;
+    }
+    const evento_nota_t *e = &t->trilha->eventos[t->proximo++];
+    if (e->nota == PAUSA || e->velocidade == 0) {
+        voz->amplitude = 0;
+    } else {
+        voz->incremento = incremento_da_nota(e->nota);
+        voz->limiar = (uint32_t)t->trilha->duty << 24;
+        voz->fase = 0;
+        voz->amplitude = e->velocidade;
+    }
+    return (int64_t)e->duracao_ms * 1000; // Positivo: relativo ao prazo anterior, sem deriva
+}
+
+// Configura PWM, DMA e timer de DMA na primeira chamada
+static void sintetizador_init(void) {
+    synth_slice = pwm_gpio_to_slice_num(BUZZER);
+    pwm_config cfg = pwm_get_default_config();
+    pwm_config_set_wrap(&cfg, PWM_TOPO);
+    pwm_init(synth_slice, &cfg, true);
+
+    synth_timer_dma = dma_claim_unused_timer(true);
+    dma_timer_set_fraction(synth_timer_dma, 1, clock_get_hz(clk_sys) / TAXA_AMOSTRAGEM);
+
+    synth_dma[0] = dma_claim_unused_channel(true);
+    synth_dma[1] = dma_claim_unused_channel(true);
+    for (int i = 0; i < 2; i++) {
+        dma_channel_config c = dma_channel_get_default_config(synth_dma[i]);
+        channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+        channel_config_set_read_increment(&c, true);
+        channel_config_set_write_increment(&c, false);
+        channel_config_set_dreq(&c, dma_get_timer_dreq(synth_timer_dma));
+        channel_config_set_chain_to(&c, synth_dma[1 - i]);
+        synth_dma_cfg[i] = c;
+        dma_channel_configure(synth_dma[i], &c, &pwm_hw->slice[synth_slice].cc, amostras[i], AMOSTRAS_POR_BLOCO, false);
+        dma_channel_set_irq1_enabled(synth_dma[i], true);
+    }
+    irq_set_exclusive_handler(DMA_IRQ_1, synth_irq_dma);
+    irq_set_enabled(DMA_IRQ_1, true);
+}
+
+void sintetizador_parar(void);
+
+/**
+* Começa a tocar uma música no instante 'inicio' (normalmente base_tempo_em(0)).
+*/
+void sintetizador_tocar(const musica_t *musica, absolute_time_t inicio) {
+    if (synth_dma[0] < 0)
+        sintetizador_init();
+    if (synth_tocando)
+        sintetizador_parar();
+
+    for (int v = 0; v < NUM_VOZES; v++)
+        vozes[v].amplitude = 0;
+    sintetizar_bloco(amostras[0]);
+    sintetizar_bloco(amostras[1]);
+    gpio_set_function(BUZZER, GPIO_FUNC_PWM);
+    dma_channel_set_config(synth_dma[1], &synth_dma_cfg[1], false);
+    dma_channel_set_config(synth_dma[0], &synth_dma_cfg[0], false);
+    dma_channel_set_read_addr(synth_dma[1], amostras[1], false);
+    dma_channel_set_read_addr(synth_dma[0], amostras[0], true);
+
+    for (int i = 0; i < musica->num_trilhas && i < NUM_VOZES; i++) {
+        estado_trilhas[i] = (estado_trilha_t){&musica->trilhas[i], 0, i};
+        alarmes_trilhas[i] = add_alarm_at(inicio, synth_alarme_evento, &estado_trilhas[i], true);
+    }
+    synth_tocando = true;
+}
 
-    // Loop para gerar a onda quadrada no buzzer
-    for (uint32_t i = 0; i < ciclo; i++) {
-        gpio_put(BUZZER, 1); // Liga o buzzer
-        sleep_us(delay); // Espera pelo tempo de atraso calculado
-        gpio_put(BUZZER, 0); // Desliga o buzzer
-        sleep_us(delay); // Espera novamente pelo tempo de atraso para completar o ciclo
+/**
+* Para a música e devolve o BUZZER ao controle por GPIO (usado por nota()).
+*/
+void sintetizador_parar(void) {
+    if (!synth_tocando)
+        return;
+    for (int i = 0; i < NUM_VOZES; i++) {
+        if (alarmes_trilhas[i] > 0)
+            cancel_alarm(alarmes_trilhas[i]);
+        alarmes_trilhas[i] = 0;
+        vozes[i].amplitude = 0;
     }
+    // Desfaz o encadeamento antes de abortar para um canal não disparar o outro;
+    // sintetizador_tocar reaplica a configuração original.
+    for (int i = 0; i < 2; i++) {
+        dma_channel_config c = synth_dma_cfg[i];
+        channel_config_set_chain_to(&c, synth_dma[i]);
+        dma_channel_set_config(synth_dma[i], &c, false);
+    }
+    dma_channel_abort(synth_dma[0]);
+    dma_channel_abort(synth_dma[1]);
+    dma_channel_acknowledge_irq1(synth_dma[0]);
+    dma_channel_acknowledge_irq1(synth_dma[1]);
+    pwm_set_chan_level(synth_slice, PWM_CHAN_B, 0);
+    gpio_init(BUZZER);
+    gpio_set_dir(BUZZER, GPIO_OUT);
+    synth_tocando = false;
 }
 
 //Funções Utilizadas
-static void gpio_irq_handler(uint gpio, uint32_t events);
 uint32_t matrix_rgb(double b, double r, double g);
 void formar_frames(double frame[NUM_LEDS][3], PIO pio, uint sm);
-void gerar_animacao(double animacao[][NUM_LEDS][3], int num_frames, int delay_ms);
 char leitura_teclado(void);
 void configurar_pino(int pino, bool direcao, bool estado);
 
-//Rotina da interrupção
-static void gpio_irq_handler(uint gpio, uint32_t events){
-    printf("Interrupção ocorreu no pino %d, no evento %d\n", gpio, events);
-    printf("HABILITANDO O MODO GRAVAÇÃO");
-	reset_usb_boot(0,0); //habilita o modo de gravação do microcontrolador
+// Formatos de pixel: cada chipset recebe os canais numa ordem. A lista gera, para cada
+// formato, o tipo do pixel no fio (pixel_<formato>_t) e um empacotador especializado
+// (empacotar_<formato>), sem nenhum desvio por formato dentro do laço.
+#define FORMATOS_PIXEL(X3, X4) \
+ X3(grb, G, R, B)     /* WS2812B */ \
+ X3(rgb, R, G, B)     /* WS2811 e fitas ordenadas em RGB */ \
+ X4(grbw, G, R, B, W) /* SK6812 RGBW */
+
+#define PIXEL_TIPO3(f, c0, c1, c2) typedef struct { uint8_t c0, c1, c2; } pixel_##f##_t;
+#define PIXEL_TIPO4(f, c0, c1, c2, c3) typedef struct { uint8_t c0, c1, c2, c3; } pixel_##f##_t;
+FORMATOS_PIXEL(PIXEL_TIPO3, PIXEL_TIPO4)
+
+// Formato da matriz, escolhido na compilação (-DFORMATO_PIXEL=rgb, por exemplo)
+#ifndef FORMATO_PIXEL
+#define FORMATO_PIXEL grb
+#endif
+#define PIXEL_CONCATENAR_(a, b, c) a##b##c
+#define PIXEL_CONCATENAR(a, b, c) PIXEL_CONCATENAR_(a, b, c)
+
+typedef PIXEL_CONCATENAR(pixel_, FORMATO_PIXEL, _t) npLED_t; // Pixel como vai no fio
+#define npEmpacotar PIXEL_CONCATENAR(empacotar_, FORMATO_PIXEL, )
+#define CANAIS_PIXEL (sizeof(npLED_t))
+
+// Pixel de alta precisão usado pelo renderizador (8.8 bits por canal, 255 = 0xFF00).
+typedef struct {
+ uint16_t G, R, B;
+} npLED16_t;
+
+// Declaração do buffer de pixels que formam a matriz.
+// "leds" é o buffer de transmissão (8 bits, na ordem do FORMATO_PIXEL, lido pelo DMA) e "leds_hd"
+// é o framebuffer de alta precisão onde os quadros são desenhados.
+npLED_t BUFFER_DMA("leds") leds[NUM_LEDS];
+npLED16_t leds_hd[NUM_LEDS];
+
+// Framebuffer onde npSetLED, npSetLED16 e definir_intensidade desenham. Normalmente é o
+// próprio leds_hd; com o compositor ativo passa a ser a camada de fundo.
+npLED16_t *np_alvo = leds_hd;
+bool np_alvo_alterado_nulo;
+bool *np_alvo_alterado = &np_alvo_alterado_nulo;
+
+// Limitador de corrente: modelo linear de consumo por canal. A soma de cada canal do
+// leds_hd é mantida incrementalmente a cada escrita, então o consumo do quadro é
+// conhecido sem percorrer o buffer, e a escala é aplicada na própria quantização.
+#define CORRENTE_MA_R 12          // Consumo do canal vermelho no brilho máximo
+#define CORRENTE_MA_G 12          // Consumo do canal verde no brilho máximo
+#define CORRENTE_MA_B 12          // Consumo do canal azul no brilho máximo
+#define CORRENTE_REPOUSO_UA 1000  // Consumo de cada LED apagado, em microampères
+#define LIMITE_CORRENTE_MA 500    // Orçamento da fonte para a matriz
+uint32_t soma_R, soma_G, soma_B;
+
+// Escreve um pixel no leds_hd atualizando as somas de consumo
+static inline void np_saida_escrever(const uint index, const uint16_t r, const uint16_t g, const uint16_t b) {
+ soma_R += r - leds_hd[index].R;
+ soma_G += g - leds_hd[index].G;
+ soma_B += b - leds_hd[index].B;
+ leds_hd[index].R = r;
+ leds_hd[index].G = g;
+ leds_hd[index].B = b;
 }
 
-// Definição de pixel GRB
-struct pixel_t {
- uint8_t G, R, B; // Três valores de 8-bits compõem um pixel.
-};
-typedef struct pixel_t pixel_t;
-typedef pixel_t npLED_t; // Mudança de nome de "struct pixel_t" para "npLED_t" por clareza.
+// Desenha no framebuffer atual (leds_hd ou a camada de fundo do compositor)
+static inline void np_desenhar(const uint index, const uint16_t r, const uint16_t g, const uint16_t b) {
+ if (np_alvo == leds_hd) {
+   np_saida_escrever(index, r, g, b);
+   return;
+ }
+ np_alvo[index].R = r;
+ np_alvo[index].G = g;
+ np_alvo[index].B = b;
+ *np_alvo_alterado = true;
+}
 
-// Declaração do buffer de pixels que formam a matriz.
-npLED_t leds[NUM_LEDS];
+/**
+* Consumo estimado do quadro atual em mA, antes da limitação.
+*/
+uint32_t NA_SRAM(consumo_estimado_ma)(void) {
+ uint64_t acionamento = (uint64_t)soma_R * CORRENTE_MA_R + (uint64_t)soma_G * CORRENTE_MA_G + (uint64_t)soma_B * CORRENTE_MA_B;
+ return acionamento / 0xFF00 + NUM_LEDS * CORRENTE_REPOUSO_UA / 1000;
+}
+
+// Fator (0 a 65536) que faz o quadro caber em LIMITE_CORRENTE_MA
+static uint32_t NA_SRAM(escala_consumo)(void) {
+ const uint32_t repouso = NUM_LEDS * CORRENTE_REPOUSO_UA / 1000;
+ uint32_t consumo = consumo_estimado_ma();
+ if (consumo <= LIMITE_CORRENTE_MA)
+   return 65536;
+ return (uint64_t)(LIMITE_CORRENTE_MA - repouso) * 65536 / (consumo - repouso);
+}
+
+// Resto da quantização de cada canal, carregado de um refresh para o próximo.
+uint8_t erro_dither[NUM_LEDS][CANAIS_PIXEL];
 
 // Variáveis para uso da máquina PIO.
 PIO np_pio;
 uint sm;
 
+// Canal de DMA que alimenta a FIFO da máquina PIO.
+int np_dma;
+
+// Dithering temporal: com ele ativo a matriz é retransmitida a TAXA_DITHER_HZ e os
+// 8 bits baixos de cada canal são espalhados no tempo, dando ~16 bits efetivos.
+#define DITHER_ATIVO_PADRAO 1
+#define TAXA_DITHER_HZ 400
+bool dither_ativo = false;
+struct repeating_timer timer_dither;
+
 /**
 * Inicializa a máquina PIO para controle da matriz de LEDs.
 */
 void npInit(uint pin) {
 
- // Cria programa PIO.
- uint offset = pio_add_program(pio0, &ws2818b_program);
- np_pio = pio0;
-
- // Toma posse de uma máquina PIO.
- sm = pio_claim_unused_sm(np_pio, false);
- if (sm < 0) {
-   np_pio = pio1;
-   sm = pio_claim_unused_sm(np_pio, true); // Se nenhuma máquina estiver livre, panic!
- }
+ // Cria programa PIO e toma posse de uma máquina PIO.
+ uint offset;
+ if (!pio_reservar(&ws2818b_program, &np_pio, &sm, &offset))
+   panic("Nenhuma maquina PIO livre para a matriz de LEDs");
 
  // Inicia programa na máquina PIO obtida.
  ws2818b_program_init(np_pio, sm, offset, pin, 800000.f);
 
+ // Configura o DMA: bytes do buffer "leds" em sequência para a FIFO TX, no ritmo da máquina PIO.
+ np_dma = dma_claim_unused_channel(true);
+ dma_channel_config c = dma_channel_get_default_config(np_dma);
+ channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+ channel_config_set_read_increment(&c, true);
+ channel_config_set_write_increment(&c, false);
+ channel_config_set_dreq(&c, pio_get_dreq(np_pio, sm, true));
+ dma_channel_configure(np_dma, &c, &np_pio->txf[sm], leds, sizeof(leds), false);
+
  // Limpa buffer de pixels.
  for (uint i = 0; i < NUM_LEDS; ++i) {
-   leds[i].R = 0;
-   leds[i].G = 0;
-   leds[i].B = 0;
+   leds[i] = (npLED_t){0};
+   leds_hd[i].R = 0;
+   leds_hd[i].G = 0;
+   leds_hd[i].B = 0;
  }
 }
 
@@ -120,15 +583,19 @@ void npInit(uint pin) {
 * Atribui uma cor RGB a um LED.
 */
 void npSetLED(const uint index, const uint8_t r, const uint8_t g, const uint8_t b) {
- leds[index].R = r;
- leds[index].G = g;
- leds[index].B = b;
+ np_desenhar(index, r << 8, g << 8, b << 8);
+}
+
+/**
+* Atribui uma cor RGB de alta precisão (0 a 0xFF00) a um LED.
+*/
+void NA_SRAM(npSetLED16)(const uint index, const uint16_t r, const uint16_t g, const uint16_t b) {
+ np_desenhar(index, r, g, b);
 }
+
 //Em ordem crescente: 0.8; 0.1; 0.9; 0.4; 0.6; 0.3; 0.2; 0.7; 1.0
-void definir_intensidade(const uint index, const double r, const double g, const double b){
- leds[index].R =(uint8_t) round(r*255.0);
- leds[index].G =(uint8_t) round(g*255.0);
- leds[index].B =(uint8_t) round(b*255.0);
+void NA_SRAM(definir_intensidade)(const uint index, const double r, const double g, const double b){
+ np_desenhar(index, (uint16_t) round(r*65280.0), (uint16_t) round(g*65280.0), (uint16_t) round(b*65280.0));
  //if(index==0 || index==5)
  //   printf("b = %.2lf\n(index %d) leds[index].B = %d\n",b,index,leds[index].B);
 }
@@ -141,16 +608,229 @@ void npClear() {
    npSetLED(i, 0, 0, 0);
 }
 
+// Compositor de camadas: cada camada tem cor de 16 bits e alfa de 8 bits por pixel, um
+// modo de mistura e uma opacidade global. As camadas são mescladas de baixo para cima
+// em uma única passada inteira, direto no leds_hd.
+typedef enum {
+ CAMADA_FUNDO,     // Animações e cores sólidas das teclas
+ CAMADA_EFEITO,    // Efeitos sobrepostos à animação
+ CAMADA_INTERFACE, // Indicadores de estado
+ NUM_CAMADAS
+} camada_id_t;
+
+typedef enum {
+ MISTURA_NORMAL,       // Cobre o que está embaixo na proporção do alfa
+ MISTURA_SOMA,         // Soma com saturação (brilho)
+ MISTURA_MULTIPLICACAO // Escurece o que está embaixo (máscaras)
+} modo_mistura_t;
+
+typedef struct {
+ npLED16_t pixels[NUM_LEDS];
+ uint8_t alfa[NUM_LEDS];
+ modo_mistura_t modo;
+ uint8_t opacidade;
+ bool ativa;
+ bool alterada; // Mudou desde a última mescla
+} camada_t;
+
+camada_t camadas[NUM_CAMADAS];
+// Resultado acumulado até cada camada, para recompor só a partir da camada mais baixa alterada.
+npLED16_t composicao_parcial[NUM_CAMADAS][NUM_LEDS];
+bool compositor_ativo = false;
+
 /**
-* Escreve os dados do buffer nos LEDs.
+* Liga o compositor. A partir daí as funções npSetLED/npClear desenham na camada de fundo,
+* que começa com o que já está na matriz (o quadro de boot).
+*/
+void compositor_ativar(void) {
+ for (int c = 0; c < NUM_CAMADAS; c++) {
+   camadas[c].modo = MISTURA_NORMAL;
+   camadas[c].opacidade = 255;
+   camadas[c].ativa = (c == CAMADA_FUNDO);
+   camadas[c].alterada = true;
+   for (uint i = 0; i < NUM_LEDS; ++i)
+     camadas[c].alfa[i] = (c == CAMADA_FUNDO) ? 255 : 0;
+ }
+ for (uint i = 0; i < NUM_LEDS; ++i)
+   camadas[CAMADA_FUNDO].pixels[i] = leds_hd[i];
+ np_alvo = camadas[CAMADA_FUNDO].pixels;
+ np_alvo_alterado = &camadas[CAMADA_FUNDO].alterada;
+ compositor_ativo = true;
+}
+
+void camada_configurar(camada_id_t id, modo_mistura_t modo, uint8_t opacidade, bool ativa) {
+ camadas[id].modo = modo;
+ camadas[id].opacidade = opacidade;
+ camadas[id].ativa = ativa;
+ camadas[id].alterada = true;
+}
+
+/**
+* Atribui cor e alfa a um pixel de uma camada (alfa 0 deixa ver as camadas de baixo).
+*/
+void camada_set_pixel(camada_id_t id, const uint index, const uint8_t r, const uint8_t g, const uint8_t b, const uint8_t alfa) {
+ camadas[id].pixels[index].R = r << 8;
+ camadas[id].pixels[index].G = g << 8;
+ camadas[id].pixels[index].B = b << 8;
+ camadas[id].alfa[index] = alfa;
+ camadas[id].alterada = true;
+}
+
+void camada_limpar(camada_id_t id) {
+ for (uint i = 0; i < NUM_LEDS; ++i)
+   camada_set_pixel(id, i, 0, 0, 0, id == CAMADA_FUNDO ? 255 : 0);
+}
+
+// Mistura um canal 'c' da camada sobre o valor acumulado 'd' (peso de 0 a 256)
+static inline uint16_t misturar_canal(uint16_t d, uint16_t c, uint32_t peso, modo_mistura_t modo) {
+ int32_t alvo;
+ switch (modo) {
+   case MISTURA_SOMA:
+     alvo = d + c;
+     if (alvo > 0xFF00) alvo = 0xFF00;
+     break;
+   case MISTURA_MULTIPLICACAO:
+     alvo = ((uint32_t)d * c) / 0xFF00;
+     break;
+   default:
+     alvo = c;
+     break;
+ }
+ return d + (((alvo - (int32_t)d) * (int32_t)peso) >> 8);
+}
+
+/**
+* Mescla as camadas em leds_hd. Se nenhuma camada mudou desde a última mescla não faz
+* nada; se mudou, recomeça da camada mais baixa alterada usando o resultado guardado
+* das camadas de baixo.
 */
-void npWrite() {
- // Escreve cada dado de 8-bits dos pixels em sequência no buffer da máquina PIO.
+void NA_SRAM(compositor_mesclar)(void) {
+ int inicio = 0;
+ while (inicio < NUM_CAMADAS && !camadas[inicio].alterada)
+   inicio++;
+ if (inicio == NUM_CAMADAS)
+   return;
+
  for (uint i = 0; i < NUM_LEDS; ++i) {
-   pio_sm_put_blocking(np_pio, sm, leds[i].G);
-   pio_sm_put_blocking(np_pio, sm, leds[i].R);
-   pio_sm_put_blocking(np_pio, sm, leds[i].B);
+   npLED16_t px = inicio > 0 ? composicao_parcial[inicio - 1][i] : (npLED16_t){0, 0, 0};
+   for (int c = inicio; c < NUM_CAMADAS; c++) {
+     const camada_t *cam = &camadas[c];
+     uint32_t a = cam->ativa ? (uint32_t)cam->alfa[i] * cam->opacidade : 0; // 0 a 255*255
+     if (a) {
+       uint32_t peso = (a * 256 + 32512) / 65025; // Reescala para 0 a 256
+       px.R = misturar_canal(px.R, cam->pixels[i].R, peso, cam->modo);
+       px.G = misturar_canal(px.G, cam->pixels[i].G, peso, cam->modo);
+       px.B = misturar_canal(px.B, cam->pixels[i].B, peso, cam->modo);
+     }
+     composicao_parcial[c][i] = px;
+   }
+   np_saida_escrever(i, px.R, px.G, px.B);
  }
+ for (int c = inicio; c < NUM_CAMADAS; c++)
+   camadas[c].alterada = false;
+}
+
+// Quantiza um canal de 16 bits para 8 bits, já aplicando a escala do limitador de corrente.
+// Com dithering, o resto da divisão fica guardado e é somado no próximo refresh, então a
+// média no tempo é o valor exato.
+static inline uint8_t quantizar(uint16_t valor, uint32_t escala, uint8_t *erro, bool dither) {
+ uint32_t v = ((valor * escala) >> 16) + (dither ? *erro : 0x80);
+ if (dither)
+   *erro = v & 0xFF;
+ return v > 0xFFFF ? 0xFF : v >> 8;
+}
+
+// Empacotadores: quantizam o leds_hd para o formato do fio, com a escala do limitador e o
+// resto do dithering de cada canal (indexado pela posição do canal no fio). No RGBW a parte
+// branca comum aos três canais vai para o LED branco (W = mínimo de R, G e B), em inteiros.
+// O limitador continua estimando pelo consumo RGB, que é maior que o do LED branco sozinho.
+#define EMPACOTADOR3(f, c0, c1, c2) \
+static inline void empacotar_##f(pixel_##f##_t *destino, const npLED16_t *origem, uint n, \
+                                 uint32_t escala, uint8_t (*erro)[3], bool dither) { \
+ for (uint i = 0; i < n; ++i) { \
+   destino[i].c0 = quantizar(origem[i].c0, escala, &erro[i][0], dither); \
+   destino[i].c1 = quantizar(origem[i].c1, escala, &erro[i][1], dither); \
+   destino[i].c2 = quantizar(origem[i].c2, escala, &erro[i][2], dither); \
+ } \
+}
+#define EMPACOTADOR4(f, c0, c1, c2, c3) \
+static inline void empacotar_##f(pixel_##f##_t *destino, const npLED16_t *origem, uint n, \
+                                 uint32_t escala, uint8_t (*erro)[4], bool dither) { \
+ for (uint i = 0; i < n; ++i) { \
+   uint16_t w = origem[i].R < origem[i].G ? origem[i].R : origem[i].G; \
+   w = origem[i].B < w ? origem[i].B : w; \
+   struct { uint16_t R, G, B, W; } px = {origem[i].R - w, origem[i].G - w, origem[i].B - w, w}; \
+   destino[i].c0 = quantizar(px.c0, escala, &erro[i][0], dither); \
+   destino[i].c1 = quantizar(px.c1, escala, &erro[i][1], dither); \
+   destino[i].c2 = quantizar(px.c2, escala, &erro[i][2], dither); \
+   destino[i].c3 = quantizar(px.c3, escala, &erro[i][3], dither); \
+ } \
+}
+FORMATOS_PIXEL(EMPACOTADOR3, EMPACOTADOR4)
+
+// Um quadro leva 8 bits por canal a 800 kHz; depois dele a linha precisa ficar em nível baixo
+// por RESET_WS2812_US para os LEDs travarem as cores. Sem isso, dois npWrite seguidos viram
+// um quadro só de 50 LEDs e o segundo se perde. O datasheet pede 280 µs; os 20 a mais cobrem
+// a imprecisão do timer e a variação entre lotes de LED.
+#define QUADRO_WS2812_US (NUM_LEDS * CANAIS_PIXEL * 8 * 10 / 8)
+#define RESET_WS2812_US 300
+static absolute_time_t np_livre_em;
+
+// Quadro publicado: o que npTransmitir manda para o fio. O refresh do dithering roda na
+// interrupção do timer e pode cair no meio do desenho do leds_hd; por isso npWrite copia o
+// leds_hd (e a escala do limitador) para o buffer que não está sendo lido e só então troca
+// o índice. A interrupção sempre encontra um quadro inteiro, o novo ou o anterior.
+npLED16_t np_publicado[2][NUM_LEDS];
+uint32_t np_publicado_escala[2];
+volatile uint np_publicado_indice;
+
+static void NA_SRAM(npPublicar)(void) {
+ uint livre = np_publicado_indice ^ 1;
+ memcpy(np_publicado[livre], leds_hd, sizeof(leds_hd));
+ np_publicado_escala[livre] = escala_consumo();
+ np_publicado_indice = livre;
+}
+
+// Converte o quadro publicado para o buffer de transmissão e dispara o DMA.
+static void NA_SRAM(npTransmitir)(bool dither) {
+ // Espera a transmissão anterior terminar antes de mexer no buffer que o DMA lê.
+ dma_channel_wait_for_finish_blocking(np_dma);
+ busy_wait_until(np_livre_em);
+ uint atual = np_publicado_indice;
+ npEmpacotar(leds, np_publicado[atual], NUM_LEDS, np_publicado_escala[atual], erro_dither, dither);
+ dma_channel_set_read_addr(np_dma, leds, true);
+ np_livre_em = make_timeout_time_us(QUADRO_WS2812_US + RESET_WS2812_US);
+}
+
+static bool NA_SRAM(refresh_dither)(struct repeating_timer *t) {
+ npTransmitir(true);
+ return true;
+}
+
+/**
+* Liga ou desliga o dithering temporal.
+*/
+void npSetDither(bool ativo) {
+ if (ativo == dither_ativo)
+   return;
+ dither_ativo = ativo;
+ if (ativo)
+   add_repeating_timer_us(-1000000 / TAXA_DITHER_HZ, refresh_dither, NULL, &timer_dither);
+ else
+   cancel_repeating_timer(&timer_dither);
+}
+
+/**
+* Escreve os dados do buffer nos LEDs.
+*/
+void NA_SRAM(npWrite)() {
+ // Com dithering ativo o timer já retransmite o quadro publicado continuamente.
+ if (compositor_ativo)
+   compositor_mesclar();
+ npPublicar();
+ if (dither_ativo)
+   return;
+ npTransmitir(false);
 }
 
 int getIndex(int x, int y) {
@@ -164,7 +844,7 @@ int getIndex(int x, int y) {
 }
 
 //Corrige o Index pra que o LED certo seja acendido
-uint correcao_index(int index){
+uint NA_SRAM(correcao_index)(int index){
      //Caso esteja numa linha ímpar
      if((index>=5 && index<10) || (index>=15 && index<20))
      return index<10 ? index+10:index-10;
@@ -172,1657 +852,2618 @@ uint correcao_index(int index){
      return NUM_LEDS-index-1;
     }
 
-void gerar_frame(double animacao[NUM_LEDS][3]){
+//As tabelas geradas já vêm na ordem da fita, com paleta em GRB: cada LED só troca o
+//índice pela cor da paleta, que pode ser a original da animação ou uma trocada na hora
+_Static_assert(ANIMACAO_LEDS == NUM_LEDS, "animacoes.h gerado para outro tamanho de matriz");
+
+typedef uint8_t paleta_t[ANIMACAO_MAX_CORES][3];
+
+// Índice de cor do LED 'i' num quadro empacotado com 'bits' por LED (2 ou 4: nunca cruza byte)
+static inline uint indice_cor(const uint8_t *quadro, uint bits, uint i){
+ return (quadro[(i * bits) >> 3] >> ((i * bits) & 7)) & ((1u << bits) - 1);
+}
+
+static inline const uint8_t *quadro_empacotado(const animacao_t *animacao, uint quadro){
+ return animacao->indices + quadro * animacao->bytes_por_quadro;
+}
+
+void NA_SRAM(gerar_frame)(const animacao_t *animacao, uint quadro, const uint8_t (*paleta)[3]){
+     const uint8_t *indices = quadro_empacotado(animacao, quadro);
      for(int i=0;i<NUM_LEDS;i++){
-      definir_intensidade(correcao_index(i),animacao[i][0],animacao[i][1],animacao[i][2]);
+      const uint8_t *cor = paleta[indice_cor(indices, animacao->bits, i)];
+      np_desenhar(i, cor[1] << 8, cor[0] << 8, cor[2] << 8);
      }
      npWrite();
     }
 
-void gerar_animacao(double animacao[][NUM_LEDS][3], int num_frames, int delay_ms){
- for(int i=0;i<num_frames;i++){
-     gerar_frame(animacao[i]);
-     putchar('\n');
-     sleep_ms(delay_ms);
+// Interpolação entre quadros-chave: o player gera quadros intermediários na hora,
+// a FPS_INTERPOLACAO quadros por segundo, usando só os quadros já existentes nas tabelas.
+#define FPS_INTERPOLACAO 60
+
+typedef enum {
+ CURVA_LINEAR, // Mistura proporcional ao tempo
+ CURVA_SUAVE   // Smoothstep: acelera no começo e freia no fim de cada transição
+} curva_t;
+
+// Decodifica um quadro da tabela para 16 bits
+static void NA_SRAM(carregar_quadro16)(const animacao_t *animacao, uint quadro, const uint8_t (*paleta)[3], npLED16_t destino[NUM_LEDS]){
+ const uint8_t *indices = quadro_empacotado(animacao, quadro);
+ for(int i=0;i<NUM_LEDS;i++){
+     const uint8_t *cor = paleta[indice_cor(indices, animacao->bits, i)];
+     destino[i].G = cor[0] << 8;
+     destino[i].R = cor[1] << 8;
+     destino[i].B = cor[2] << 8;
     }
- npClear();
- npWrite();
 }
 
-void buttonConfig(const uint BUTTON_PIN)
-{
-    
-    gpio_init(BUTTON_PIN);                //inicializo o pino do botão
-    gpio_set_dir(BUTTON_PIN, GPIO_IN);    //defini entrada
-    gpio_pull_up(BUTTON_PIN);             //habilito o pull up interno 
+// Aplica a curva ao peso de mistura (0 a 65536)
+static uint32_t aplicar_curva(uint32_t peso, curva_t curva){
+ if(curva == CURVA_SUAVE) // 3p² - 2p³, em ponto fixo 16.16
+     return (uint32_t)(((uint64_t)peso * peso * (3ull * 65536 - 2ull * peso)) >> 32);
+ return peso;
 }
 
-//Função pra ler o teclado
-char leitura_teclado()
-{
-    char numero = 'n'; // Valor padrão para quando nenhuma tecla for pressionada
+static inline uint16_t misturar(uint16_t a, uint16_t b, uint32_t peso){
+ return a + (int32_t)(((int64_t)((int32_t)b - a) * peso) >> 16);
+}
 
-    // Desliga todos os pinos das colunas
-    for (int i = 0; i < 4; i++)
-    {
-        gpio_put(colunas[i], 1);
-    }
+// Máquina virtual de scripts: em vez de um quadro por passo, o clipe guarda um programa
+// curto (montado de scripts/*.vms, ou recebido pela serial) que desenha numa tela de
+// índices de cor. A cada tick do player a VM executa até um ESPERAR; a tela passa pela
+// paleta do player, então troca e rotação de cores funcionam como nas animações.
+// Orçamento de cada tick, para um laço sem ESPERAR não segurar o player: cada instrução
+// custa 1 e as que percorrem a tela toda custam mais VM_CUSTO_TELA (um ROLAR vale cerca
+// de 12 instruções simples). Mesmo a 40 ciclos por instrução simples, o pior tick fica
+// perto de 40 us a 125 MHz; o benchmark mede o pior caso na placa.
+#define VM_ORCAMENTO_TICK 128
+#define VM_CUSTO_TELA 12
+
+typedef struct {
+ const script_t *script;
+ uint16_t pc;
+ int16_t r[VM_REGISTRADORES];
+ uint8_t tela[NUM_LEDS]; // Índices de cor, linha a linha como a matriz é vista de frente
+ uint16_t espera;        // Ticks que ainda faltam do último ESPERAR
+ uint32_t aleatorio;     // Estado do xorshift32
+ uint16_t quadro;        // Ticks executados desde o início
+ uint16_t instrucoes;    // Instruções executadas no último tick
+ bool parado;            // FIM ou instrução inválida: a tela não muda mais
+} vm_t;
+
+static const char *const vm_operandos[VM_NUM_INSTRUCOES] = VM_OPERANDOS;
 
-    for (int coluna = 0; coluna < 4; coluna++)
-    {
-        // Ativa a coluna atual (coloca o pino da coluna como 1)
-        gpio_put(colunas[coluna], 0);
-
-        for (int linha = 0; linha < 4; linha++)
-        {
-            // Verifica o estado da linha. Se estiver em 0, a tecla foi pressionada
-            if (gpio_get(linhas[linha]) == 0)
-            {
-                numero = teclado[linha][coluna]; // Mapeia a tecla pressionada
-                // Aguarda a tecla ser liberada (debounce)
-                while (gpio_get(linhas[linha]) == 0)
-                {
-                    sleep_ms(10); // Aguarda a tecla ser liberada
-                }
-                break; // Sai do laço após detectar a tecla
+/**
+* Confere um bytecode antes de executá-lo: instruções conhecidas e completas,
+* registradores existentes e saltos para o começo de uma instrução.
+*/
+bool vm_validar(const uint8_t *codigo, uint tamanho){
+ static uint8_t inicio[SCRIPT_MAX_BYTES / 8]; //Bit de cada byte que começa uma instrução
+ if(tamanho == 0 || tamanho > SCRIPT_MAX_BYTES)
+     return false;
+ for(uint i = 0; i < sizeof(inicio); i++)
+     inicio[i] = 0;
+ for(uint pc = 0; pc < tamanho;){
+     if(codigo[pc] >= VM_NUM_INSTRUCOES)
+         return false;
+     inicio[pc >> 3] |= 1u << (pc & 7);
+     const char *op = vm_operandos[codigo[pc++]];
+     for(; *op; op++){
+         uint largura = *op == 'a' ? 2 : 1;
+         if(pc + largura > tamanho)
+             return false;
+         if(*op == 'r' && codigo[pc] >= VM_REGISTRADORES)
+             return false;
+         if(*op == 'v' && (codigo[pc] & 0x80) && (codigo[pc] & 0x7F) >= VM_REGISTRADORES)
+             return false;
+         pc += largura;
+        }
+    }
+ for(uint pc = 0; pc < tamanho;){
+     const char *op = vm_operandos[codigo[pc++]];
+     for(; *op; op++){
+         if(*op == 'a'){
+             uint destino = codigo[pc] | codigo[pc + 1] << 8;
+             if(destino >= tamanho || !(inicio[destino >> 3] & (1u << (destino & 7))))
+                 return false;
             }
+         pc += *op == 'a' ? 2 : 1;
         }
+    }
+ return true;
+}
 
-        // Desativa a coluna atual (coloca o pino da coluna como 0)
-        gpio_put(colunas[coluna], 1);
+/**
+* Prepara a VM para executar o script desde o começo, com a tela na cor 0.
+*/
+void vm_iniciar(vm_t *vm, const script_t *script){
+ vm->script = script;
+ vm->pc = 0;
+ for(int i = 0; i < VM_REGISTRADORES; i++)
+     vm->r[i] = 0;
+ for(int i = 0; i < NUM_LEDS; i++)
+     vm->tela[i] = 0;
+ vm->espera = 0;
+ vm->aleatorio = script->semente ? script->semente : 1;
+ vm->quadro = 0;
+ vm->instrucoes = 0;
+ vm->parado = false;
+}
 
-        if (numero != 'n') // Se uma tecla foi pressionada, sai do laço de colunas
-        {
-            break;
+// Operando de valor: registrador (bit 7) ou número de 7 bits com sinal
+static inline int vm_valor(const vm_t *vm, uint8_t b){
+ return b & 0x80 ? vm->r[b & (VM_REGISTRADORES - 1)] : (int8_t)(b << 1) >> 1;
+}
+
+static inline void vm_pintar(vm_t *vm, int x, int y, int cor){
+ if((uint)x < NUM_COLUNAS && (uint)y < NUM_LEDS / NUM_COLUNAS)
+     vm->tela[y * NUM_COLUNAS + x] = cor & (SCRIPT_MAX_CORES - 1);
+}
+
+// Desloca a tela; com 'rolar' o que sai por uma borda entra pela outra
+static void vm_deslocar(vm_t *vm, int dx, int dy, bool rolar){
+ const int altura = NUM_LEDS / NUM_COLUNAS;
+ uint8_t antes[NUM_LEDS];
+ for(int i = 0; i < NUM_LEDS; i++)
+     antes[i] = vm->tela[i];
+ if(rolar){ //Reduz uma vez, para o laço só precisar somar a largura quando sair pela esquerda
+     dx %= NUM_COLUNAS;
+     dy %= altura;
+    }
+ for(int y = 0; y < altura; y++){
+     int oy = y - dy;
+     if(rolar)
+         oy = oy < 0 ? oy + altura : oy >= altura ? oy - altura : oy;
+     for(int x = 0; x < NUM_COLUNAS; x++){
+         int ox = x - dx;
+         if(rolar)
+             ox = ox < 0 ? ox + NUM_COLUNAS : ox >= NUM_COLUNAS ? ox - NUM_COLUNAS : ox;
+         bool dentro = (uint)ox < NUM_COLUNAS && (uint)oy < (uint)altura;
+         vm->tela[y * NUM_COLUNAS + x] = dentro ? antes[oy * NUM_COLUNAS + ox] : 0;
         }
     }
- //printf("Chegou no fim da leitura do teclado\n");
- return numero; // Retorna a tecla pressionada
 }
 
-// Função inicial para configurar os pinos
-void configurar_pino(int pino, bool direcao, bool estado) {
-    gpio_init(pino);
-    gpio_set_dir(pino, direcao);
-    gpio_put(pino, estado);
+/**
+* Executa um tick do script: instruções até um ESPERAR, FIM ou o fim do orçamento
+* (nesse caso o script continua de onde parou no tick seguinte).
+*/
+void vm_tick(vm_t *vm){
+ vm->quadro++;
+ vm->instrucoes = 0;
+ if(vm->parado)
+     return;
+ if(vm->espera > 1){
+     vm->espera--;
+     return;
+    }
+ vm->espera = 0;
+ const uint8_t *c = vm->script->codigo;
+ const uint tamanho = vm->script->tamanho;
+ uint pc = vm->pc;
+ int orcamento = VM_ORCAMENTO_TICK;
+ uint n;
+ for(n = 0; orcamento > 0; n++, orcamento--){
+     if(pc >= tamanho){ //Só um script não validado chega aqui
+         vm->parado = true;
+         break;
+        }
+     const uint8_t *o = &c[pc + 1];
+     switch(c[pc]){
+      case VM_FIM:
+         vm->parado = true;
+         vm->instrucoes = n + 1;
+         return;
+      case VM_ESPERAR: {
+         int ticks = vm_valor(vm, o[0]);
+         vm->espera = ticks > 1 ? ticks : 1;
+         vm->pc = pc + 2;
+         vm->instrucoes = n + 1;
+         return;
+        }
+      case VM_PREENCHER: {
+         uint8_t cor = vm_valor(vm, o[0]) & (SCRIPT_MAX_CORES - 1);
+         for(int i = 0; i < NUM_LEDS; i++)
+             vm->tela[i] = cor;
+         orcamento -= VM_CUSTO_TELA;
+         pc += 2;
+         break;
+        }
+      case VM_PIXEL:
+         vm_pintar(vm, vm_valor(vm, o[0]), vm_valor(vm, o[1]), vm_valor(vm, o[2]));
+         pc += 4;
+         break;
+      case VM_RETANGULO: {
+         int x0 = vm_valor(vm, o[0]), y0 = vm_valor(vm, o[1]), cor = vm_valor(vm, o[4]);
+         int x1 = x0 + vm_valor(vm, o[2]), y1 = y0 + vm_valor(vm, o[3]);
+         //Recorta na matriz antes: com registradores o retângulo pode ser enorme
+         x0 = x0 < 0 ? 0 : x0;
+         y0 = y0 < 0 ? 0 : y0;
+         x1 = x1 > NUM_COLUNAS ? NUM_COLUNAS : x1;
+         y1 = y1 > NUM_LEDS / NUM_COLUNAS ? NUM_LEDS / NUM_COLUNAS : y1;
+         for(int y = y0; y < y1; y++)
+             for(int x = x0; x < x1; x++)
+                 vm->tela[y * NUM_COLUNAS + x] = cor & (SCRIPT_MAX_CORES - 1);
+         orcamento -= VM_CUSTO_TELA;
+         pc += 6;
+         break;
+        }
+      case VM_DESLOCAR:
+      case VM_ROLAR:
+         vm_deslocar(vm, vm_valor(vm, o[0]), vm_valor(vm, o[1]), c[pc] == VM_ROLAR);
+         orcamento -= VM_CUSTO_TELA;
+         pc += 3;
+         break;
+      case VM_DEF:
+         vm->r[o[0]] = vm_valor(vm, o[1]);
+         pc += 3;
+         break;
+      case VM_SOMA:
+         vm->r[o[0]] += vm_valor(vm, o[1]);
+         pc += 3;
+         break;
+      case VM_SUB:
+         vm->r[o[0]] -= vm_valor(vm, o[1]);
+         pc += 3;
+         break;
+      case VM_ALEAT: {
+         uint32_t x = vm->aleatorio;
+         x ^= x << 13;
+         x ^= x >> 17;
+         x ^= x << 5;
+         vm->aleatorio = x;
+         int limite = vm_valor(vm, o[1]);
+         vm->r[o[0]] = limite > 0 ? (int16_t)(x % (uint32_t)limite) : 0;
+         pc += 3;
+         break;
+        }
+      case VM_LER: {
+         int x = vm_valor(vm, o[1]), y = vm_valor(vm, o[2]);
+         bool dentro = (uint)x < NUM_COLUNAS && (uint)y < NUM_LEDS / NUM_COLUNAS;
+         vm->r[o[0]] = dentro ? vm->tela[y * NUM_COLUNAS + x] : 0;
+         pc += 4;
+         break;
+        }
+      case VM_SALTAR:
+         pc = o[0] | o[1] << 8;
+         break;
+      case VM_LACO:
+         pc = --vm->r[o[0]] ? (uint)(o[1] | o[2] << 8) : pc + 4;
+         break;
+      case VM_SE_IGUAL:
+         pc = vm_valor(vm, o[0]) == vm_valor(vm, o[1]) ? (uint)(o[2] | o[3] << 8) : pc + 5;
+         break;
+      case VM_SE_MENOR:
+         pc = vm_valor(vm, o[0]) < vm_valor(vm, o[1]) ? (uint)(o[2] | o[3] << 8) : pc + 5;
+         break;
+      default:
+         vm->parado = true;
+         vm->instrucoes = n + 1;
+         return;
+     }
+    }
+ vm->pc = pc;
+ vm->instrucoes = n;
 }
 
-typedef struct pixel_t pixel_t;
+// Converte a tela da VM em cores de 16 bits, na ordem da fita
+static void vm_carregar16(const vm_t *vm, const uint8_t (*paleta)[3], uint num_cores, npLED16_t destino[NUM_LEDS]){
+ for(int i = 0; i < NUM_LEDS; i++){
+     const uint8_t *cor = paleta[vm->tela[i] < num_cores ? vm->tela[i] : 0];
+     npLED16_t *led = &destino[correcao_index(i)];
+     led->G = cor[0] << 8;
+     led->R = cor[1] << 8;
+     led->B = cor[2] << 8;
+    }
+}
 
-// Declaração do buffer de pixels que formam a matriz.
-npLED_t leds[NUM_LEDS];
+// Player de clipes: em vez de bloquear até o fim da animação, o laço principal chama
+// player_tick, que desenha o passo atual quando chega o prazo dele e devolve o prazo do
+// próximo. Entre um passo e outro o laço principal trata as teclas, então qualquer ação
+// pode interromper a animação no próximo quadro.
+typedef struct {
+ const animacao_t *animacao;     // Quadros, paleta e tempo de quadro (gerados em animacoes.h)
+ bool interpolar;                // Crossfade entre quadros-chave a FPS_INTERPOLACAO
+ curva_t curva;
+ const musica_t *musica;         // Tocada pelo sintetizador junto com o vídeo
+ void (*ao_mostrar_quadro)(int quadro); // Efeito sincronizado com cada quadro-chave
+ const script_t *script;         // No lugar da animação: quadros desenhados pela VM
+} clip_t;
+
+// Tempo de quadro, duração e paleta vêm da animação ou do script do clipe
+static inline uint clip_quadro_ms(const clip_t *clip){
+ return clip->script ? clip->script->quadro_ms : clip->animacao->quadro_ms;
+}
 
-// Variáveis para uso da máquina PIO.
-PIO np_pio;
-uint sm;
+static inline uint clip_num_quadros(const clip_t *clip){
+ return clip->script ? clip->script->num_quadros : clip->animacao->num_quadros;
+}
 
-// Funções de teclas específicas
-void desligarTodosOsLeds() {
-   npClear();
-    npWrite();
+static inline const uint8_t (*clip_paleta(const clip_t *clip))[3]{
+ return clip->script ? clip->script->paleta : clip->animacao->paleta;
+}
 
+static inline uint clip_num_cores(const clip_t *clip){
+ return clip->script ? clip->script->num_cores : clip->animacao->num_cores;
 }
-void ligarLEDsAzuis() {
-    for (int i = 0; i < NUM_LEDS; i++) {
-        npSetLED(i,0,0,255);
-    }
-    npWrite();
+
+// O player toca itens: um clipe com número de repetições (ou uma duração, repetindo o
+// clipe até completá-la) e a transição para o item seguinte. No fim de um item o
+// seguinte começa no mesmo tick, sem quadro apagado entre os dois.
+typedef struct {
+ const clip_t *clip;
+ uint8_t repeticoes;    // Vezes seguidas que o clipe toca (0 conta como 1)
+ uint16_t duracao_ms;   // Se não for 0, substitui as repetições
+ uint16_t transicao_ms; // Crossfade para o item seguinte (0 = corte seco)
+} item_playlist_t;
+
+#define TRANSICAO_PADRAO_MS 400
+
+typedef struct {
+ item_playlist_t item;
+ uint64_t fim_us;  // Fim do item na linha do tempo
+ uint32_t passo;   // Próximo passo: quadro-chave, ou quadro intermediário se interpolar
+ int64_t segmento; // Quadro-chave (contado desde o início do item) carregado em chave_a
+ npLED16_t chave_a[NUM_LEDS], chave_b[NUM_LEDS];
+ const clip_t *seguinte; // Clipe cujo primeiro quadro já está na camada de efeito
+ uint8_t opacidade_transicao;
+ paleta_t paleta;        // Cópia da paleta da animação, que pode ser trocada ou girada
+ bool paleta_alterada;   // Redesenhar o passo atual com a paleta nova
+ vm_t vm;                // Estado do script, nos clipes com script
+ uint64_t rotacao_us;    // Próxima rotação da paleta na linha do tempo
+ bool ativo;
+} player_t;
+
+player_t player;
+
+// Playlist: itens pedidos pelo teclado (* + número) tocam primeiro; depois, com o modo
+// playlist ligado, a sequência automática roda em ciclo.
+#define TAMANHO_PLAYLIST 8
+item_playlist_t playlist[TAMANHO_PLAYLIST];
+uint8_t playlist_inicio, playlist_tamanho;
+const item_playlist_t *sequencia_automatica;
+uint8_t sequencia_tamanho, sequencia_indice;
+bool modo_playlist = false;
+
+// Item que tocará depois do atual, sem retirá-lo
+static const item_playlist_t *playlist_espiar(void){
+ if(playlist_tamanho)
+     return &playlist[playlist_inicio];
+ if(modo_playlist)
+     return &sequencia_automatica[sequencia_indice];
+ return NULL;
 }
-void ligarLEDsVermelhos() {
-    for (int i = 0; i < NUM_LEDS; i++) {
-                npSetLED(i,1,0,0);
+
+static const item_playlist_t *playlist_retirar(void){
+ const item_playlist_t *item = playlist_espiar();
+ if(playlist_tamanho){
+     playlist_inicio = (playlist_inicio + 1) % TAMANHO_PLAYLIST;
+     playlist_tamanho--;
+    }else if(item){
+     sequencia_indice = (sequencia_indice + 1) % sequencia_tamanho;
     }
-    npWrite();
+ return item;
 }
-void ligarLEDsVerdes() {
-    for (int i = 0; i < NUM_LEDS; i++) {
-                npSetLED(i,0,40,0);
-    }
-    npWrite();
+
+// Instante do passo 'k' na linha do tempo do item
+static uint64_t player_instante_us(const clip_t *clip, uint32_t k){
+ if(clip->interpolar)
+     return (uint64_t)k * 1000000 / FPS_INTERPOLACAO;
+ return (uint64_t)k * clip_quadro_ms(clip) * 1000;
 }
 
-void ligarLEDsBrancos() {
-    for (int i = 0; i < NUM_LEDS; i++) {
-        npSetLED(i,160,160,160);
-    }
-    npWrite();
+static uint64_t player_duracao_us(const clip_t *clip){
+ return (uint64_t)clip_num_quadros(clip) * clip_quadro_ms(clip) * 1000;
 }
 
-//Só funciona na animação Vinicobra, se quisesse criar uma mais geral seria um pouco mais difícil
-void gerar_animacao_com_som(double animacao[][NUM_LEDS][3], int num_frames, int delay_ms){
- for(int i=0;i<num_frames;i++){
-     gerar_frame(animacao[i]);
-     if(i==2 || i==8 || i==12){
-      nota(1000,80);
-      //printf("Tocou a nota em i=%d\n",i);
-      sleep_ms(delay_ms-80);
-     }else if(i!=19)
-     sleep_ms(delay_ms);
-     else{
-      nota(3000,80);
-      //printf("Tocou a nota em i=19\n");
-      sleep_ms(delay_ms-80);
-     }
+// Rotação de paleta: a cada ROTACAO_PALETA_MS as cores (menos a 0, o fundo) andam uma
+// posição. Custa só uma troca de cores na paleta, não importa quantos LEDs as usam.
+#define ROTACAO_PALETA_MS 150
+uint16_t rotacao_paleta_ms = 0; // 0 = desligada
+
+/**
+* Substitui a paleta da animação que está tocando (as cores que faltarem ficam como estão).
+*/
+void paleta_trocar(const uint8_t (*cores)[3], uint num_cores){
+ if(num_cores > ANIMACAO_MAX_CORES)
+     num_cores = ANIMACAO_MAX_CORES;
+ for(uint c = 0; c < num_cores; c++){
+     player.paleta[c][0] = cores[c][0];
+     player.paleta[c][1] = cores[c][1];
+     player.paleta[c][2] = cores[c][2];
     }
- npClear();
- npWrite();
+ player.paleta_alterada = true;
+}
+
+/**
+* Volta à paleta original da animação que está tocando.
+*/
+void paleta_restaurar(void){
+ if(player.ativo)
+     paleta_trocar(clip_paleta(player.item.clip), clip_num_cores(player.item.clip));
 }
-void gerar_animacao_com_som_tetris(double animacao[][NUM_LEDS][3], int num_frames){
 
- for(int i=0;i<num_frames;i++){
-     gerar_frame(animacao[i]);
-     nota(musica_tetris[i],200);
-     sleep_ms(200);//Tempo que passa na imagem sem música
+/**
+* Gira uma posição as cores de 'primeiro' até 'ultimo' (inclusive).
+*/
+void paleta_rotacionar(uint primeiro, uint ultimo){
+ if(ultimo >= ANIMACAO_MAX_CORES || primeiro >= ultimo)
+     return;
+ uint8_t ultima[3] = {player.paleta[ultimo][0], player.paleta[ultimo][1], player.paleta[ultimo][2]};
+ for(uint c = ultimo; c > primeiro; c--){
+     player.paleta[c][0] = player.paleta[c - 1][0];
+     player.paleta[c][1] = player.paleta[c - 1][1];
+     player.paleta[c][2] = player.paleta[c - 1][2];
     }
-    
- npClear();
- npWrite();
+ player.paleta[primeiro][0] = ultima[0];
+ player.paleta[primeiro][1] = ultima[1];
+ player.paleta[primeiro][2] = ultima[2];
+ player.paleta_alterada = true;
 }
 
+void indicador_ocupado(bool ocupado);
+void audio_desligar(void);
+void jogo_parar(void);
+void rede_pausar(void);
 
-void gerar_animacao_com_som_brasil(double animacao[][NUM_LEDS][3], int num_frames){
+// Esconde a camada de efeito usada pelas transições
+static void player_encerrar_transicao(void){
+ if(compositor_ativo && player.opacidade_transicao)
+     camada_configurar(CAMADA_EFEITO, MISTURA_NORMAL, 255, false);
+ player.opacidade_transicao = 0;
+}
 
- for(int i=0;i<num_frames;i++){
-     gerar_frame(animacao[i]);
-     nota(musica_hino_nacional[i],50);
-     sleep_ms(200);//Tempo que passa na imagem sem música
+/**
+* Para o clipe atual. Com 'limpar' a matriz é apagada, como no fim das animações.
+*/
+void player_parar(bool limpar){
+ if(!player.ativo)
+     return;
+ player.ativo = false;
+ if(player.item.clip->musica)
+     sintetizador_parar();
+ player_encerrar_transicao();
+ indicador_ocupado(false);
+ if(limpar){
+     npClear();
+     npWrite();
     }
-    
- npClear();
- npWrite();
 }
 
-//Animações
-//A 1ª dimensao é os frames, a 2ª o índice do LED, a 3ª a cor (RGB)
- double animacao_Bia[5][NUM_LEDS][3]={
-     { // Quadro 1
-            {0.0, 0.0, 0.0}, {0.6, 0.0, 0.2}, {0.0, 0.0, 0.0}, {0.6, 0.0, 0.2}, {0.0, 0.0, 0.0},
-            {0.6, 0.0, 0.2}, {0.6, 0.0, 0.2}, {0.6, 0.0, 0.2}, {0.6, 0.0, 0.2}, {0.6, 0.0, 0.2},
-            {0.6, 0.0, 0.2}, {0.6, 0.0, 0.2}, {0.6, 0.0, 0.2}, {0.6, 0.0, 0.2}, {0.6, 0.0, 0.2},
-            {0.0, 0.0, 0.0}, {0.6, 0.0, 0.2}, {0.6, 0.0, 0.2}, {0.6, 0.0, 0.2}, {0.0, 0.0, 0.0},
-            {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.6, 0.0, 0.2}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}
-        },
-        { // Quadro 2
-            {0.0, 0.0, 0.0}, {1.0, 0.0, 0.2}, {1.0, 0.0, 0.2}, {1.0, 0.0, 0.2}, {0.0, 0.0, 0.0},
-            {1.0, 0.0, 0.2}, {1.0, 0.0, 0.2}, {1.0, 0.0, 0.2}, {1.0, 0.0, 0.2}, {1.0, 0.0, 0.2},
-            {1.0, 0.0, 0.2}, {1.0, 0.0, 0.2}, {1.0, 0.0, 0.2}, {1.0, 0.0, 0.2}, {1.0, 0.0, 0.2},
-            {1.0, 0.0, 0.2}, {1.0, 0.0, 0.2}, {1.0, 0.0, 0.2}, {1.0, 0.0, 0.2}, {1.0, 0.0, 0.2},
-            {0.0, 0.0, 0.0}, {1.0, 0.0, 0.2}, {1.0, 0.0, 0.2}, {1.0, 0.0, 0.2}, {0.0, 0.0, 0.0}
-        },
-        { // Quadro 3
-            {0.0, 0.0, 0.0}, {1.0, 1.0, 1.0}, {1.0, 0.0, 0.2}, {1.0, 1.0, 1.0}, {0.0, 0.0, 0.0},
-            {1.0, 1.0, 1.0}, {1.0, 0.0, 0.2}, {1.0, 0.0, 0.2}, {1.0, 0.0, 0.2}, {1.0, 1.0, 1.0},
-            {1.0, 0.0, 0.2}, {1.0, 0.0, 0.2}, {1.0, 0.0, 0.2}, {1.0, 0.0, 0.2}, {1.0, 0.0, 0.2},
-            {1.0, 1.0, 1.0}, {1.0, 0.0, 0.2}, {1.0, 0.0, 0.2}, {1.0, 0.0, 0.2}, {1.0, 1.0, 1.0},
-            {0.0, 0.0, 0.0}, {1.0, 1.0, 1.0}, {1.0, 0.0, 0.2}, {1.0, 1.0, 1.0}, {0.0, 0.0, 0.0}
-        },
-        { // Quadro 4
-            {0.0, 0.0, 0.0}, {1.0, 1.0, 1.0}, {0.0, 0.0, 0.0}, {1.0, 1.0, 1.0}, {0.0, 0.0, 0.0},
-            {1.0, 1.0, 1.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 0.2}, {0.0, 0.0, 0.0}, {1.0, 1.0, 1.0},
-            {0.0, 0.0, 0.0}, {1.0, 0.0, 0.2}, {0.0, 0.0, 0.0}, {1.0, 0.0, 0.2}, {0.0, 0.0, 0.0},
-            {1.0, 1.0, 1.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 0.2}, {0.0, 0.0, 0.0}, {1.0, 1.0, 1.0},
-            {0.0, 0.0, 0.0}, {1.0, 1.0, 1.0}, {0.0, 0.0, 0.0}, {1.0, 1.0, 1.0}, {0.0, 0.0, 0.0}
-        },
-        { // Quadro 5
-            {1.0, 1.0, 1.0}, {0.0, 0.0, 0.0}, {1.0, 1.0, 1.0}, {0.0, 0.0, 0.0}, {1.0, 1.0, 1.0},
-            {0.0, 0.0, 0.0}, {1.0, 1.0, 1.0}, {0.0, 0.0, 0.0}, {1.0, 1.0, 1.0}, {0.0, 0.0, 0.0},
-            {1.0, 1.0, 1.0}, {0.0, 0.0, 0.0}, {1.0, 1.0, 1.0}, {0.0, 0.0, 0.0}, {1.0, 1.0, 1.0},
-            {0.0, 0.0, 0.0}, {1.0, 1.0, 1.0}, {0.0, 0.0, 0.0}, {1.0, 1.0, 1.0}, {0.0, 0.0, 0.0},
-            {1.0, 1.0, 1.0}, {0.0, 0.0, 0.0}, {1.0, 1.0, 1.0}, {0.0, 0.0, 0.0}, {1.0, 1.0, 1.0}
-        }
- };
+/**
+* Começa um item, substituindo o que estiver tocando (sem apagar a matriz antes).
+*/
+void player_iniciar(const item_playlist_t *item){
+ player_parar(false);
+ audio_desligar();
+ jogo_parar();
+ rede_pausar();
+ player.item = *item;
+ player.fim_us = item->duracao_ms ? (uint64_t)item->duracao_ms * 1000
+                                  : player_duracao_us(item->clip) * (item->repeticoes ? item->repeticoes : 1);
+ player.passo = 0;
+ player.segmento = -1;
+ player.seguinte = NULL;
+ player.ativo = true;
+ paleta_trocar(clip_paleta(item->clip), clip_num_cores(item->clip));
+ player.paleta_alterada = false;
+ player.rotacao_us = (uint64_t)rotacao_paleta_ms * 1000;
+ indicador_ocupado(true);
+ base_tempo_iniciar();
+ if(item->clip->musica)
+     sintetizador_tocar(item->clip->musica, base_tempo_em(0)); //A música segue sozinha, por alarmes
+}
 
- double animacao_Lorenzo[5][NUM_LEDS][3]={
-     { // Quadro 1
-            {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0},
-            {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-            {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0},
-            {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0},
-            {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0}
-        },
-        { // Quadro 2
-            {0.0, 0.0, 0.0}, {1.0, 1.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 1.0, 0.0}, {0.0, 0.0, 0.0},
-            {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-            {1.0, 1.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 1.0, 0.0},
-            {0.0, 0.0, 0.0}, {1.0, 1.0, 0.0}, {1.0, 1.0, 0.0}, {1.0, 1.0, 0.0}, {0.0, 0.0, 0.0},
-            {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}
-        },
-        { // Quadro 3
-            {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0},
-            {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-            {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-            {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0},
-            {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}
-        },
-        { // Quadro 4
-            {0.0, 0.0, 0.0}, {0.7, 0.0, 0.8}, {0.0, 0.0, 0.0}, {0.7, 0.0, 0.8}, {0.0, 0.0, 0.0},
-            {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-            {0.0, 0.0, 0.0}, {0.7, 0.0, 0.8}, {0.7, 0.0, 0.8}, {0.7, 0.0, 0.8}, {0.0, 0.0, 0.0},
-            {0.7, 0.0, 0.8}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.7, 0.0, 0.8},
-            {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}
-        },
-        { // Quadro 5
-            {0.0, 0.0, 0.0}, {1.0, 1.0, 1.0}, {0.0, 0.0, 0.0}, {1.0, 1.0, 1.0}, {0.0, 0.0, 0.0},
-            {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-            {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0},
-            {1.0, 1.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 1.0, 1.0},
-            {0.0, 0.0, 0.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {0.0, 0.0, 0.0}
+// Desenha o passo que fica no instante 't' do item
+static void player_desenhar(uint64_t t){
+ const clip_t *clip = player.item.clip;
+ const animacao_t *animacao = clip->animacao;
+ const uint64_t quadro_us = (uint64_t)clip_quadro_ms(clip) * 1000;
+ int64_t segmento = t / quadro_us;
+ int atual = segmento % clip_num_quadros(clip);
+ bool novo = segmento != player.segmento;
+ bool recarregar = novo || player.paleta_alterada;
+ player.paleta_alterada = false;
+
+ if(novo){
+     player.segmento = segmento;
+     if(atual == 0 && segmento > 0 && clip->musica) //Nova repetição: a música recomeça junto
+         sintetizador_tocar(clip->musica, base_tempo_em_us(segmento * quadro_us));
+     if(clip->ao_mostrar_quadro)
+         clip->ao_mostrar_quadro(atual);
+    }
+ if(clip->script){
+     if(novo){
+         if(atual == 0) //Cada repetição roda o script desde o começo
+             vm_iniciar(&player.vm, clip->script);
+         while(player.vm.quadro <= (uint)atual) //Se algum tick atrasou, a VM alcança o tempo
+             vm_tick(&player.vm);
         }
- };
-
-  double animacao_joao[8][NUM_LEDS][3]={
-        { // Quadro 1
-            {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-            {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0},
-            {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0},
-            {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0},
-            {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}
-        },
-        { // Quadro 2
-            {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-            {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-            {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-            {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0},
-            {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}
-        },
-        { // Quadro 3
-            {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-            {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0},
-            {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0},
-            {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0},
-            {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}
-        },
-        { // Quadro 4
-            {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-            {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0},
-            {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0},
-            {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0},
-            {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}
-        },
-        { // Quadro 5
-            {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-            {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0},
-            {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0},
-            {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0},
-            {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}
-        },
-        { // Quadro 6
-            {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-            {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-            {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0},
-            {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0},
-            {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}
-        },
-        { // Quadro 7
-            {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-            {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-            {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0},
-            {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-            {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}
-        },
-        { // Quadro 8
-            {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-            {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0},
-            {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0},
-            {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0},
-            {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}
+     if(recarregar){
+         vm_carregar16(&player.vm, player.paleta, clip_num_cores(clip), player.chave_a);
+         for(int i=0;i<NUM_LEDS;i++)
+             np_desenhar(i, player.chave_a[i].R, player.chave_a[i].G, player.chave_a[i].B);
+         npWrite();
         }
- };
-
- double animacao_vinitetris[48][NUM_LEDS][3] = {
-    {
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-    },
-
-    {
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-    },
+     return;
+    }
+ if(!clip->interpolar){
+     if(recarregar)
+         gerar_frame(animacao, atual, player.paleta);
+     return;
+    }
+ if(recarregar){
+     //Na última volta o último quadro fica parado; antes disso ele se funde com o primeiro
+     int seguinte = (uint64_t)(segmento + 1) * quadro_us < player.fim_us ? (atual + 1) % animacao->num_quadros : atual;
+     carregar_quadro16(animacao, atual, player.paleta, player.chave_a);
+     carregar_quadro16(animacao, seguinte, player.paleta, player.chave_b);
+    }
+ uint32_t peso = aplicar_curva(((t % quadro_us) << 16) / quadro_us, clip->curva);
+ for(int i=0;i<NUM_LEDS;i++){
+     npSetLED16(i, misturar(player.chave_a[i].R, player.chave_b[i].R, peso),
+                   misturar(player.chave_a[i].G, player.chave_b[i].G, peso),
+                   misturar(player.chave_a[i].B, player.chave_b[i].B, peso));
+    }
+ npWrite();
+}
 
-    {
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-    },
+// Pré-carrega o primeiro quadro do próximo item na camada de efeito (ainda escondida) e,
+// na janela final do item atual, aumenta a opacidade dela. Devolve o prazo do próximo
+// passo da transição, ou UINT64_MAX se não houver transição.
+static uint64_t player_transicao(void){
+ const item_playlist_t *proximo = playlist_espiar();
+ if(!compositor_ativo || !proximo){
+     player_encerrar_transicao();
+     return UINT64_MAX;
+    }
+ if(proximo->clip != player.seguinte){
+     player_encerrar_transicao();
+     player.seguinte = proximo->clip;
+     const animacao_t *animacao = proximo->clip->animacao;
+     if(proximo->clip->script){ //Primeiro tick numa VM à parte: a do player está em uso
+         static vm_t vm_seguinte;
+         vm_iniciar(&vm_seguinte, proximo->clip->script);
+         vm_tick(&vm_seguinte);
+         vm_carregar16(&vm_seguinte, proximo->clip->script->paleta, proximo->clip->script->num_cores, camadas[CAMADA_EFEITO].pixels);
+        }else{
+         carregar_quadro16(animacao, 0, animacao->paleta, camadas[CAMADA_EFEITO].pixels);
+        }
+     for(int i=0;i<NUM_LEDS;i++)
+         camadas[CAMADA_EFEITO].alfa[i] = 255;
+    }
 
+ uint64_t transicao_us = (uint64_t)player.item.transicao_ms * 1000;
+ if(transicao_us == 0)
+     return UINT64_MAX;
+ if(transicao_us > player.fim_us)
+     transicao_us = player.fim_us;
+ uint64_t inicio = player.fim_us - transicao_us;
+ uint64_t agora = base_tempo_decorrido_us();
+ if(agora < inicio)
+     return inicio;
+
+ uint64_t decorrido = agora - inicio;
+ uint8_t opacidade = decorrido >= transicao_us ? 255 : decorrido * 255 / transicao_us;
+ if(opacidade && opacidade != player.opacidade_transicao){
+     player.opacidade_transicao = opacidade;
+     camada_configurar(CAMADA_EFEITO, MISTURA_NORMAL, opacidade, true);
+     npWrite();
+    }
+ return agora + 1000000 / FPS_INTERPOLACAO;
+}
 
-    {
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-    },
-    {
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0},
-    },
+/**
+* Avança o item se o prazo do próximo passo já chegou e devolve em 'prazo' quando deve
+* ser chamado de novo. No fim do item começa o próximo da playlist; retorna false quando
+* não há mais nada tocando.
+*/
+bool player_tick(absolute_time_t *prazo){
+ if(!player.ativo)
+     return false;
+ const clip_t *clip = player.item.clip;
+ uint64_t t = player_instante_us(clip, player.passo);
+
+ if(rotacao_paleta_ms && time_reached(base_tempo_em_us(player.rotacao_us))){
+     paleta_rotacionar(1, clip_num_cores(clip) - 1);
+     player.rotacao_us += (uint64_t)rotacao_paleta_ms * 1000;
+    }
 
-    {
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0},
-    },
-    {
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0},
-    },
-    {
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0},
-    },
-    {
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0},
-    },
-    {
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 0.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0},
-    },
-    {
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 0.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0},
-    },
-    {
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 0.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0},
-    },
-    {
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 0.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0},
-    },
-    {
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {1.0, 0.0, 0.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0},
-    },
-    {
-        {0.0, 0.0, 0.0}, {0.5, 0.0, 0.5}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {1.0, 0.0, 0.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0},
-    },
-    {
-        {0.0, 0.0, 0.0}, {0.5, 0.0, 0.5}, {0.5, 0.0, 0.5}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.5, 0.0, 0.5}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {1.0, 0.0, 0.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0},
-    },
-    {
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.5, 0.0, 0.5}, {0.5, 0.0, 0.5}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 1.0}, {0.5, 0.0, 0.5}, {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {1.0, 0.0, 0.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0},
-    },
-    {
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 1.0}, {0.5, 0.0, 0.5}, {0.5, 0.0, 0.5}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0},
-        {0.0, 0.0, 1.0}, {0.5, 0.0, 0.5}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {1.0, 0.0, 0.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0},
-    },
-    {
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0},
-        {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0},
-        {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0},
-    },
-    {
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-    },
+ if(t < player.fim_us && time_reached(base_tempo_em_us(t))){
+     player_desenhar(t);
+     player.passo++;
+     t = player_instante_us(clip, player.passo);
+    }else if(player.paleta_alterada && player.passo > 0){
+     player_desenhar(player_instante_us(clip, player.passo - 1)); //Mesmo passo, cores novas
+    }
+ if(t > player.fim_us)
+     t = player.fim_us; //Último quadro fica até o fim nominal
+ if(rotacao_paleta_ms && player.rotacao_us < t)
+     t = player.rotacao_us;
+ uint64_t t_transicao = player_transicao();
+ if(t_transicao < t)
+     t = t_transicao;
+
+ if(time_reached(base_tempo_em_us(player.fim_us))){
+     base_tempo_relatorio(player.fim_us / 1000);
+     const item_playlist_t *proximo = playlist_retirar();
+     if(proximo){
+         player_iniciar(proximo); //O primeiro quadro do próximo sai já neste tick
+         return player_tick(prazo);
+        }
+     player_parar(true);
+     return false;
+    }
+ *prazo = base_tempo_em_us(t);
+ return true;
+}
 
-    {
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0},
-        {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0},
-        {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0},
-    },
+// Indicador de ação em andamento: um pixel azul fraco no canto, na camada de interface,
+// sobreposto a qualquer animação. Desligado por padrão para não alterar as animações.
+#define INDICADOR_OCUPADO 0
+#define PIXEL_INDICADOR 0
 
-    {
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-    },
+void indicador_ocupado(bool ocupado){
+ if(!INDICADOR_OCUPADO)
+     return;
+ camada_set_pixel(CAMADA_INTERFACE, PIXEL_INDICADOR, 0, 0, 64, ocupado ? 192 : 0);
+ npWrite();
+}
 
-    {
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0},
-        {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0},
-        {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0},
-    },
+// Modo áudio: o ADC amostra o microfone sem parar e o DMA escreve num anel, sem a CPU. A
+// AUDIO_FPS quadros por segundo as últimas AUDIO_N amostras passam por uma FFT em ponto
+// fixo (Q15) e a energia de cada faixa de frequência vira a altura de uma coluna.
+#define MIC_PIN 28            // ADC2: microfone da BitDogLab, ou qualquer sinal de 0 a 3,3 V
+#define MIC_ADC (MIC_PIN - 26)
+#define AUDIO_FS 8000         // Amostras por segundo
+#define AUDIO_BITS 7
+#define AUDIO_N (1 << AUDIO_BITS) // Pontos da FFT: 16 ms de som, faixas de 62,5 Hz
+#define AUDIO_ANEL_BITS 8
+#define AUDIO_ANEL (1 << AUDIO_ANEL_BITS)
+#define AUDIO_FPS 40
+#define AUDIO_Q4_POR_LINHA 32        // Cada linha da coluna vale 2 bits de energia (6 dB)
+#define AUDIO_REFERENCIA_MIN (20 * 16) // Abaixo disso é ruído do ADC: a matriz fica apagada
+#define AUDIO_QUEDA_REFERENCIA 1     // Ganho automático: a referência cai 1/16 de bit por quadro
+#define AUDIO_QUEDA_COLUNA 64        // Colunas descem no máximo 1/4 de linha por quadro
+
+_Static_assert(AUDIO_ANEL >= AUDIO_N, "o anel precisa guardar uma janela inteira da FFT");
+
+// Primeiro bin de cada faixa (e o fim da última), em escala logarítmica:
+// 62-187 Hz, 187-375 Hz, 375-750 Hz, 750-1500 Hz e 1500-4000 Hz
+static const uint8_t audio_faixas[NUM_COLUNAS + 1] = {1, 3, 6, 12, 24, AUDIO_N / 2};
+
+// Cor de cada linha, de baixo para cima (R, G, B)
+static const uint8_t audio_cores[NUM_LEDS / NUM_COLUNAS][3] = {
+ {0, 255, 0}, {0, 255, 0}, {160, 255, 0}, {255, 140, 0}, {255, 0, 0}};
+
+static uint16_t BUFFER_DMA("audio_anel") audio_anel[AUDIO_ANEL] __attribute__((aligned(AUDIO_ANEL * sizeof(uint16_t))));
+static const uint32_t audio_transferencias = UINT32_MAX; // 6 dias a 8 kHz; rearmado no tick
+static int16_t audio_cos[AUDIO_N / 2], audio_sen[AUDIO_N / 2], audio_janela[AUDIO_N];
+
+typedef struct {
+ bool ativo;
+ int dma;                    // Canal do ADC para o anel (-1 até o primeiro uso)
+ absolute_time_t proximo;    // Prazo do próximo quadro
+ int referencia;             // Nível (log2 em Q4) que enche uma coluna
+ int nivel[NUM_COLUNAS];     // Energia de cada faixa no último quadro, log2 em Q4
+ uint16_t altura[NUM_COLUNAS]; // Altura mostrada de cada coluna, em 1/256 de linha
+ uint32_t quadros;
+ uint64_t us_total;          // Tempo de CPU gasto nos quadros, para a carga média
+ uint32_t us_max;
+} audio_t;
+
+audio_t audio = {.dma = -1};
+
+#define DOIS_PI 6.28318531f
+
+// Fatores de giro e janela de Hann, calculados uma vez em ponto flutuante
+static void audio_tabelas(void){
+ if(audio_janela[AUDIO_N / 2]) //Já calculadas
+     return;
+ for(int k = 0; k < AUDIO_N / 2; k++){
+     audio_cos[k] = (int16_t)lroundf(32767.f * cosf(DOIS_PI * k / AUDIO_N));
+     audio_sen[k] = (int16_t)lroundf(32767.f * sinf(DOIS_PI * k / AUDIO_N));
+    }
+ for(int i = 0; i < AUDIO_N; i++)
+     audio_janela[i] = (int16_t)lroundf(32767.f * 0.5f * (1.f - cosf(DOIS_PI * i / AUDIO_N)));
+}
 
-    {
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-    },
-    {
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-    },
+// FFT radix 2 no lugar, em Q15. Cada estágio divide por 2 para não estourar, então o
+// resultado sai dividido por AUDIO_N.
+static void fft_q15(int16_t re[AUDIO_N], int16_t im[AUDIO_N]){
+ for(uint i = 1, j = 0; i < AUDIO_N; i++){ //Ordem de bits invertida
+     uint bit = AUDIO_N >> 1;
+     for(; j & bit; bit >>= 1)
+         j ^= bit;
+     j ^= bit;
+     if(i < j){
+         int16_t t = re[i]; re[i] = re[j]; re[j] = t;
+         t = im[i]; im[i] = im[j]; im[j] = t;
+        }
+    }
+ for(uint tamanho = 2, passo = AUDIO_N / 2; tamanho <= AUDIO_N; tamanho <<= 1, passo >>= 1){
+     uint meio = tamanho >> 1;
+     for(uint k = 0; k < meio; k++){
+         int32_t wr = audio_cos[k * passo], wi = -audio_sen[k * passo];
+         for(uint i = k; i < AUDIO_N; i += tamanho){
+             uint j = i + meio;
+             int32_t tr = (wr * re[j] - wi * im[j]) >> 15;
+             int32_t ti = (wr * im[j] + wi * re[j]) >> 15;
+             re[j] = (re[i] - tr) >> 1;
+             im[j] = (im[i] - ti) >> 1;
+             re[i] = (re[i] + tr) >> 1;
+             im[i] = (im[i] + ti) >> 1;
+            }
+        }
+    }
+}
 
-    {
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-    },
+// log2 em Q4 (16 = dobro da energia), 0 para 0
+static int log2_q4(uint64_t v){
+ if(!v)
+     return 0;
+ int b = 63 - __builtin_clzll(v);
+ uint fracao = b >= 4 ? (uint)(v >> (b - 4)) & 15 : (uint)(v << (4 - b)) & 15;
+ return b * 16 + fracao;
+}
 
-    {
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-    },
+/**
+* Analisa as últimas AUDIO_N amostras do anel: janela, FFT, energia por faixa e, com o
+* ganho automático, a altura de cada coluna.
+*/
+void audio_analisar(void){
+ static int16_t re[AUDIO_N], im[AUDIO_N];
+ //Posição da próxima escrita do DMA: as AUDIO_N amostras antes dela são as mais novas
+ uint escrita = (dma_channel_hw_addr(audio.dma)->write_addr - (uint32_t)(uintptr_t)audio_anel) / sizeof(uint16_t);
+ uint inicio = (escrita - AUDIO_N) & (AUDIO_ANEL - 1);
+ int32_t soma = 0;
+ for(int i = 0; i < AUDIO_N; i++){
+     re[i] = audio_anel[(inicio + i) & (AUDIO_ANEL - 1)] & 0xFFF;
+     soma += re[i];
+    }
+ int media = soma >> AUDIO_BITS; //Tira o nível DC (o microfone fica em meia escala)
+ for(int i = 0; i < AUDIO_N; i++){
+     re[i] = (int16_t)(((re[i] - media) * 16 * audio_janela[i]) >> 15); //12 bits -> Q15
+     im[i] = 0;
+    }
+ fft_q15(re, im);
+
+ int maximo = 0;
+ for(int x = 0; x < NUM_COLUNAS; x++){
+     uint64_t energia = 0;
+     for(int k = audio_faixas[x]; k < audio_faixas[x + 1]; k++)
+         energia += (uint32_t)(re[k] * re[k]) + (uint32_t)(im[k] * im[k]);
+     audio.nivel[x] = log2_q4(energia);
+     if(audio.nivel[x] > maximo)
+         maximo = audio.nivel[x];
+    }
+ //Ganho automático: sobe na hora com um som mais forte e desce devagar
+ if(maximo > audio.referencia)
+     audio.referencia = maximo;
+ else if(audio.referencia - AUDIO_QUEDA_REFERENCIA >= AUDIO_REFERENCIA_MIN)
+     audio.referencia -= AUDIO_QUEDA_REFERENCIA;
+ if(audio.referencia < AUDIO_REFERENCIA_MIN)
+     audio.referencia = AUDIO_REFERENCIA_MIN;
+
+ const int linhas = NUM_LEDS / NUM_COLUNAS;
+ for(int x = 0; x < NUM_COLUNAS; x++){
+     int altura = (audio.nivel[x] - (audio.referencia - linhas * AUDIO_Q4_POR_LINHA)) * 256 / AUDIO_Q4_POR_LINHA;
+     altura = altura < 0 ? 0 : altura > linhas * 256 ? linhas * 256 : altura;
+     if(altura < audio.altura[x] - AUDIO_QUEDA_COLUNA)
+         altura = audio.altura[x] - AUDIO_QUEDA_COLUNA;
+     audio.altura[x] = altura;
+    }
+}
 
+/**
+* Desenha as colunas: a linha de cima de cada uma acende em proporção à parte que a coluna
+* ocupa dela.
+*/
+void audio_desenhar(void){
+ const int linhas = NUM_LEDS / NUM_COLUNAS;
+ for(int x = 0; x < NUM_COLUNAS; x++){
+     for(int linha = 0; linha < linhas; linha++){
+         int cheio = audio.altura[x] - linha * 256;
+         cheio = cheio < 0 ? 0 : cheio > 256 ? 256 : cheio;
+         np_desenhar(correcao_index((linhas - 1 - linha) * NUM_COLUNAS + x), audio_cores[linha][0] * cheio,
+                     audio_cores[linha][1] * cheio, audio_cores[linha][2] * cheio);
+        }
+    }
+ npWrite();
+}
 
-    {
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-    },
-    {
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0},
-    },
+/**
+* Liga o modo áudio: ADC em modo contínuo no microfone, DMA para o anel e o primeiro
+* quadro no próximo tick.
+*/
+void audio_ligar(void){
+ if(audio.ativo)
+     return;
+ audio_tabelas();
+ adc_init();
+ adc_gpio_init(MIC_PIN);
+ adc_select_input(MIC_ADC);
+ adc_fifo_setup(true, true, 1, false, false); //FIFO com DREQ a cada amostra, 12 bits
+ adc_set_clkdiv(48000000.f / AUDIO_FS - 1.f);  //clk_adc vem do PLL USB, independe do perfil
+
+ if(audio.dma < 0)
+     audio.dma = dma_claim_unused_channel(true);
+ dma_channel_config c = dma_channel_get_default_config(audio.dma);
+ channel_config_set_transfer_data_size(&c, DMA_SIZE_16);
+ channel_config_set_read_increment(&c, false);
+ channel_config_set_write_increment(&c, true);
+ channel_config_set_ring(&c, true, AUDIO_ANEL_BITS + 1); //Anel na escrita, em bytes
+ channel_config_set_dreq(&c, DREQ_ADC);
+ for(int i = 0; i < AUDIO_ANEL; i++)
+     audio_anel[i] = 2048;
+ dma_channel_configure(audio.dma, &c, audio_anel, &adc_hw->fifo, audio_transferencias, true);
+ adc_run(true);
+
+ for(int x = 0; x < NUM_COLUNAS; x++)
+     audio.altura[x] = 0;
+ audio.referencia = AUDIO_REFERENCIA_MIN;
+ audio.quadros = 0;
+ audio.us_total = 0;
+ audio.us_max = 0;
+ audio.proximo = make_timeout_time_us(1000000 / AUDIO_FPS); //Primeira janela já cheia
+ audio.ativo = true;
+ indicador_ocupado(true);
+}
 
-    {
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0},
-    },
-    {
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0},
-    },
-    {
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0},
-    },
-    {
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0},
-    },
-    {
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 0.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0},
-    },
-    {
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 0.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0},
-    },
-    {
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 0.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0},
-    },
-    {
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 0.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0},
-    },
-    {
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {1.0, 0.0, 0.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0},
-    },
-    {
-        {0.0, 0.0, 0.0}, {0.5, 0.0, 0.5}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {1.0, 0.0, 0.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0},
-    },
-    {
-        {0.0, 0.0, 0.0}, {0.5, 0.0, 0.5}, {0.5, 0.0, 0.5}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.5, 0.0, 0.5}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {1.0, 0.0, 0.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0},
-    },
-    {
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.5, 0.0, 0.5}, {0.5, 0.0, 0.5}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 1.0}, {0.5, 0.0, 0.5}, {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {1.0, 0.0, 0.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0},
-    },
-    {
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 1.0}, {0.5, 0.0, 0.5}, {0.5, 0.0, 0.5}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0},
-        {0.0, 0.0, 1.0}, {0.5, 0.0, 0.5}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {1.0, 0.0, 0.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0},
-    },
-    {
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0},
-        {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0},
-        {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0},
-    },
-    {
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-    },
+/**
+* Desliga o modo áudio (ADC e DMA parados) e mostra a carga de CPU que ele usou.
+*/
+void audio_desligar(void){
+ if(!audio.ativo)
+     return;
+ audio.ativo = false;
+ adc_run(false);
+ dma_channel_abort(audio.dma);
+ adc_fifo_drain();
+ indicador_ocupado(false);
+ if(audio.quadros)
+     printf("Modo áudio: %lu quadros, %lu us por quadro (máx. %lu us), %lu%% de um núcleo\n",
+            (unsigned long)audio.quadros, (unsigned long)(audio.us_total / audio.quadros), (unsigned long)audio.us_max,
+            (unsigned long)(audio.us_total * AUDIO_FPS / audio.quadros / 10000));
+}
 
-    {
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0},
-        {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0},
-        {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0},
-    },
+/**
+* Como player_tick: faz o quadro se o prazo chegou e antecipa 'prazo' para o próximo.
+*/
+bool audio_tick(absolute_time_t *prazo){
+ if(!audio.ativo)
+     return false;
+ if(time_reached(audio.proximo)){
+     uint32_t inicio = time_us_32();
+     if(!dma_channel_is_busy(audio.dma)) //Fim das 2^32 transferências: continua no anel
+         dma_channel_set_trans_count(audio.dma, audio_transferencias, true);
+     audio_analisar();
+     audio_desenhar();
+     uint32_t gasto = time_us_32() - inicio;
+     audio.us_total += gasto;
+     if(gasto > audio.us_max)
+         audio.us_max = gasto;
+     audio.quadros++;
+     audio.proximo = delayed_by_us(audio.proximo, 1000000 / AUDIO_FPS);
+     if(time_reached(audio.proximo)) //Atrasou mais de um quadro: não tenta recuperar
+         audio.proximo = make_timeout_time_us(1000000 / AUDIO_FPS);
+    }
+ if(absolute_time_diff_us(audio.proximo, *prazo) > 0)
+     *prazo = audio.proximo;
+ return true;
+}
 
-    {
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-    },
+// Jogos: snake, pong e blocos, jogados no teclado. Cada jogo avança em passos de tempo
+// fixo; se o laço atrasar, os passos perdidos são feitos em seguida (até
+// JOGO_PASSOS_ATRASADOS) e o ritmo não muda. Uma tecla é aplicada assim que chega, sem
+// esperar o próximo passo, e a tela é redesenhada na hora: a resposta chega aos LEDs em
+// menos de um quadro. A grade guarda um índice de jogo_cores por célula.
+#define JOGO_LINHAS (NUM_LEDS / NUM_COLUNAS)
+#define JOGO_PASSOS_ATRASADOS 3
+#define JOGO_PISCA_MS 250      // Fim de jogo: a tela pisca JOGO_PISCADAS vezes e o jogo recomeça
+#define JOGO_PISCADAS 6
+#define JOGO_LATENCIA_LIMITE_US (1000000 / FPS_INTERPOLACAO) // Um quadro a 60 fps
+
+typedef enum {
+ COR_JOGO_FUNDO,
+ COR_JOGO_COBRA,
+ COR_JOGO_CABECA,
+ COR_JOGO_COMIDA,
+ COR_JOGO_RAQUETE,
+ COR_JOGO_CPU,
+ COR_JOGO_BOLA,
+ COR_JOGO_PECA,
+ COR_JOGO_PILHA,
+ COR_JOGO_FIM,
+ NUM_CORES_JOGO
+} cor_jogo_t;
+
+// (R, G, B)
+static const uint8_t jogo_cores[NUM_CORES_JOGO][3] = {
+ {0, 0, 0}, {0, 120, 0}, {120, 255, 0}, {255, 0, 0}, {0, 80, 255},
+ {255, 0, 160}, {255, 255, 255}, {255, 160, 0}, {0, 90, 140}, {200, 0, 0}};
+
+typedef struct {
+ const char *nome;
+ uint16_t passo_ms;
+ void (*iniciar)(void);
+ void (*passo)(void);
+ bool (*tecla)(char tecla);  // Aplica a tecla; true se a tela mudou
+ void (*desenhar)(uint8_t grade[JOGO_LINHAS][NUM_COLUNAS]);
+} jogo_def_t;
+
+typedef struct {
+ bool ativo;
+ const jogo_def_t *def;
+ absolute_time_t proximo;    // Prazo do próximo passo (ou da próxima piscada no fim)
+ uint8_t fim;                // Piscadas que faltam no fim de jogo; 0 durante a partida
+ uint32_t aleatorio;         // Estado do xorshift32
+ uint16_t pontos, recorde;
+ uint32_t passos, recuperados, descartados;
+ uint32_t entradas, latencia_max_us;
+ uint64_t latencia_total_us;
+ union {
+  struct {
+   uint8_t corpo[NUM_LEDS];  // Células (y*NUM_COLUNAS + x) da cauda à cabeça, num anel
+   uint8_t cauda, tamanho, comida;
+   int8_t dx, dy;
+  } cobra;
+  struct {
+   int8_t raquete, cpu;      // Coluna da esquerda de cada raquete (2 de largura)
+   int8_t x, y, vx, vy;      // Bola
+  } pong;
+  struct {
+   uint8_t pilha[JOGO_LINHAS]; // Bit x de cada linha: célula ocupada
+   uint8_t peca, rotacao;
+   int8_t x, y;              // Canto da caixa 3x3 da peça
+  } blocos;
+ };
+} jogo_t;
 
-    {
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0},
-        {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0},
-        {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0},
-    },
+jogo_t jogo;
 
-    {
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-    }//Tinha uma vírgula desnecessária aqui
-};
+static uint32_t jogo_sortear(uint32_t limite){
+ uint32_t x = jogo.aleatorio;
+ x ^= x << 13;
+ x ^= x >> 17;
+ x ^= x << 5;
+ jogo.aleatorio = x;
+ return x % limite;
+}
 
+static uint32_t jogo_passo_us(void){
+ return (jogo.fim ? JOGO_PISCA_MS : jogo.def->passo_ms) * 1000u;
+}
+
+// Chamada pelos jogos quando a partida acaba: começa a piscar
+static void jogo_terminar(void){
+ if(jogo.pontos > jogo.recorde)
+     jogo.recorde = jogo.pontos;
+ printf("Fim de jogo (%s): %u pontos, recorde %u\n", jogo.def->nome, jogo.pontos, jogo.recorde);
+ jogo.fim = JOGO_PISCADAS;
+ jogo.proximo = make_timeout_time_ms(JOGO_PISCA_MS);
+}
+
+// Snake: a cobra anda um passo por JOGO_COBRA_MS, ou na hora em que vira
+static void cobra_comida(void){
+ uint livre = jogo_sortear(NUM_LEDS - jogo.cobra.tamanho);
+ for(uint c = 0;; c++){
+     bool ocupada = false;
+     for(uint i = 0; i < jogo.cobra.tamanho && !ocupada; i++)
+         ocupada = jogo.cobra.corpo[(jogo.cobra.cauda + i) % NUM_LEDS] == c;
+     if(!ocupada && !livre--){
+         jogo.cobra.comida = c;
+         return;
+        }
+    }
+}
 
-   
-double animacao_ruan[5][NUM_LEDS][3] = {
-    { // Quadro 1 - Seta para a esquerda
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, .0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}
-    },
-    { // Quadro 2 - Seta para baixo
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}
-    },
-    { // Quadro 3 - Seta para a direita
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 1.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 1.0, 0.0}, {1.0, 1.0, 0.0}, {0.0, 0.0, 0.0},
-        {1.0, 1.0, 0.0}, {1.0, 1.0, 0.0}, {1.0, 1.0, 0.0}, {1.0, 1.0, 0.0}, {1.0, 1.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 1.0, 0.0}, {1.0, 1.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 1.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}
-    },
-    { // Quadro 4 - Seta para cima
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}
-    },
-    { // Quadro 5 - Seta para a esquerda novamente
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {1.0, 0.0, 1.0}, {1.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {1.0, 0.0, 1.0}, {1.0, 0.0, 1.0}, {1.0, 0.0, 1.0}, {1.0, 0.0, 1.0}, {1.0, 0.0, 1.0},
-        {0.0, 0.0, 0.0}, {1.0, 0.0, 1.0}, {1.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}
+static void cobra_iniciar(void){
+ jogo.cobra.cauda = 0;
+ jogo.cobra.tamanho = 2;
+ jogo.cobra.corpo[0] = 2 * NUM_COLUNAS + 0;
+ jogo.cobra.corpo[1] = 2 * NUM_COLUNAS + 1;
+ jogo.cobra.dx = 1;
+ jogo.cobra.dy = 0;
+ cobra_comida();
+}
+
+static void cobra_passo(void){
+ uint8_t cabeca = jogo.cobra.corpo[(jogo.cobra.cauda + jogo.cobra.tamanho - 1) % NUM_LEDS];
+ int x = cabeca % NUM_COLUNAS + jogo.cobra.dx, y = cabeca / NUM_COLUNAS + jogo.cobra.dy;
+ if(x < 0 || x >= NUM_COLUNAS || y < 0 || y >= JOGO_LINHAS){ //Bateu na borda
+     jogo_terminar();
+     return;
     }
+ uint8_t nova = y * NUM_COLUNAS + x;
+ bool comeu = nova == jogo.cobra.comida;
+ if(!comeu){ //A cauda sai antes, então a cabeça pode ocupar a célula dela
+     jogo.cobra.cauda = (jogo.cobra.cauda + 1) % NUM_LEDS;
+     jogo.cobra.tamanho--;
+    }
+ for(uint i = 0; i < jogo.cobra.tamanho; i++)
+     if(jogo.cobra.corpo[(jogo.cobra.cauda + i) % NUM_LEDS] == nova){ //Mordeu o próprio corpo
+         jogo_terminar();
+         return;
+        }
+ jogo.cobra.corpo[(jogo.cobra.cauda + jogo.cobra.tamanho) % NUM_LEDS] = nova;
+ jogo.cobra.tamanho++;
+ if(comeu){
+     jogo.pontos++;
+     if(jogo.cobra.tamanho == NUM_LEDS) //Encheu a matriz
+         jogo_terminar();
+     else
+         cobra_comida();
+    }
+}
+
+static bool cobra_tecla(char tecla){
+ int8_t dx = tecla == '4' ? -1 : tecla == '6' ? 1 : 0;
+ int8_t dy = tecla == '2' ? -1 : tecla == '8' ? 1 : 0;
+ //Só curvas: seguir em frente ou voltar por cima do corpo não faz nada
+ if((!dx && !dy) || (dx && jogo.cobra.dx) || (dy && jogo.cobra.dy))
+     return false;
+ jogo.cobra.dx = dx;
+ jogo.cobra.dy = dy;
+ //Vira na hora, e o passo seguinte vem um passo inteiro depois
+ jogo.proximo = make_timeout_time_ms(jogo.def->passo_ms);
+ cobra_passo();
+ return true;
+}
+
+static void cobra_desenhar(uint8_t grade[JOGO_LINHAS][NUM_COLUNAS]){
+ grade[jogo.cobra.comida / NUM_COLUNAS][jogo.cobra.comida % NUM_COLUNAS] = COR_JOGO_COMIDA;
+ for(uint i = 0; i < jogo.cobra.tamanho; i++){
+     uint8_t c = jogo.cobra.corpo[(jogo.cobra.cauda + i) % NUM_LEDS];
+     grade[c / NUM_COLUNAS][c % NUM_COLUNAS] = i + 1 == jogo.cobra.tamanho ? COR_JOGO_CABECA : COR_JOGO_COBRA;
+    }
+}
+
+// Pong: a raquete do jogador fica embaixo e a do computador em cima. O computador segue a
+// bola, mas às vezes hesita; a bola sai para o lado de onde bateu na raquete.
+#define PONG_HESITACAO 4 // 1 em 4 passos a raquete do computador não se mexe
+
+static void pong_saque(void){
+ jogo.pong.x = NUM_COLUNAS / 2;
+ jogo.pong.y = JOGO_LINHAS / 2;
+ jogo.pong.vx = (int8_t)jogo_sortear(3) - 1;
+ jogo.pong.vy = 1;
+}
+
+static void pong_iniciar(void){
+ jogo.pong.raquete = jogo.pong.cpu = (NUM_COLUNAS - 2) / 2;
+ pong_saque();
+}
+
+// Bola chegando à linha da raquete: rebate se a raquete cobre a coluna dela
+static bool pong_rebater(int8_t raquete, int x){
+ if(x < raquete || x > raquete + 1)
+     return false;
+ jogo.pong.vy = -jogo.pong.vy;
+ jogo.pong.vx = x == raquete ? -1 : 1;
+ return true;
+}
+
+static void pong_passo(void){
+ if(jogo.pong.vy < 0 && jogo_sortear(PONG_HESITACAO)){
+     if(jogo.pong.x < jogo.pong.cpu && jogo.pong.cpu > 0)
+         jogo.pong.cpu--;
+     else if(jogo.pong.x > jogo.pong.cpu + 1 && jogo.pong.cpu < NUM_COLUNAS - 2)
+         jogo.pong.cpu++;
+    }
+ int x = jogo.pong.x + jogo.pong.vx;
+ if(x < 0 || x >= NUM_COLUNAS){ //Parede
+     jogo.pong.vx = -jogo.pong.vx;
+     x = jogo.pong.x + jogo.pong.vx;
+    }
+ int y = jogo.pong.y + jogo.pong.vy;
+ if(y == 0 && !pong_rebater(jogo.pong.cpu, x)){ //O computador perdeu
+     jogo.pontos++;
+     pong_saque();
+     return;
+    }
+ if(y == JOGO_LINHAS - 1 && !pong_rebater(jogo.pong.raquete, x)){
+     jogo.pong.x = x;
+     jogo.pong.y = y;
+     jogo_terminar();
+     return;
+    }
+ if(y == 0 || y == JOGO_LINHAS - 1){ //Rebateu: sai na direção nova, sem entrar na linha da raquete
+     x = jogo.pong.x + jogo.pong.vx;
+     if(x < 0 || x >= NUM_COLUNAS)
+         x = jogo.pong.x - jogo.pong.vx;
+     y = jogo.pong.y + jogo.pong.vy;
+    }
+ jogo.pong.x = x;
+ jogo.pong.y = y;
+}
+
+static bool pong_tecla(char tecla){
+ int8_t raquete = jogo.pong.raquete + (tecla == '4' ? -1 : tecla == '6' ? 1 : 0);
+ if(raquete < 0 || raquete > NUM_COLUNAS - 2 || raquete == jogo.pong.raquete)
+     return false;
+ jogo.pong.raquete = raquete;
+ return true;
+}
+
+static void pong_desenhar(uint8_t grade[JOGO_LINHAS][NUM_COLUNAS]){
+ grade[0][jogo.pong.cpu] = grade[0][jogo.pong.cpu + 1] = COR_JOGO_CPU;
+ grade[JOGO_LINHAS - 1][jogo.pong.raquete] = grade[JOGO_LINHAS - 1][jogo.pong.raquete + 1] = COR_JOGO_RAQUETE;
+ grade[jogo.pong.y][jogo.pong.x] = COR_JOGO_BOLA;
+}
+
+// Blocos: peças de até 3 células caem numa caixa 3x3; linha completa some. A peça de
+// 2 células repete a última célula, para todas terem o mesmo tamanho.
+static const int8_t blocos_pecas[][3][2] = {
+ {{0, 1}, {1, 1}, {2, 1}}, //Reta
+ {{1, 1}, {2, 1}, {1, 2}}, //Canto
+ {{1, 1}, {2, 1}, {2, 1}}  //Dupla
 };
-double animacao_vini[29][NUM_LEDS][3] = {
-    {
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-    },
 
-    {
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0},
-    },
+#define NUM_PECAS (sizeof(blocos_pecas) / sizeof(blocos_pecas[0]))
 
-    {
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0},
-    },
+// Célula i da peça atual girada 'rotacao' vezes (sentido horário) dentro da caixa
+static void blocos_celula(uint8_t peca, uint8_t rotacao, uint i, int *x, int *y){
+ int cx = blocos_pecas[peca][i][0], cy = blocos_pecas[peca][i][1];
+ for(uint r = 0; r < rotacao; r++){
+     int t = cx;
+     cx = 2 - cy;
+     cy = t;
+    }
+ *x = cx;
+ *y = cy;
+}
 
-    {
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0},
-    },
+// A peça cabe na posição? Acima da tela (y < 0) não há pilha
+static bool blocos_cabe(uint8_t rotacao, int8_t x, int8_t y){
+ for(uint i = 0; i < 3; i++){
+     int cx, cy;
+     blocos_celula(jogo.blocos.peca, rotacao, i, &cx, &cy);
+     cx += x;
+     cy += y;
+     if(cx < 0 || cx >= NUM_COLUNAS || cy >= JOGO_LINHAS || (cy >= 0 && (jogo.blocos.pilha[cy] >> cx & 1)))
+         return false;
+    }
+ return true;
+}
 
-    {
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0},
-    },
+static void blocos_nova_peca(void){
+ jogo.blocos.peca = jogo_sortear(NUM_PECAS);
+ jogo.blocos.rotacao = 0;
+ jogo.blocos.x = (NUM_COLUNAS - 3) / 2;
+ jogo.blocos.y = -1; //A linha do meio da caixa aparece no topo
+ if(!blocos_cabe(0, jogo.blocos.x, jogo.blocos.y))
+     jogo_terminar();
+}
 
-    {
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0},
-    },
+static void blocos_iniciar(void){
+ for(int y = 0; y < JOGO_LINHAS; y++)
+     jogo.blocos.pilha[y] = 0;
+ blocos_nova_peca();
+}
 
-    {
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0},
-    },
+// A peça não desce mais: vai para a pilha, linhas cheias somem e vem a próxima
+static void blocos_fixar(void){
+ for(uint i = 0; i < 3; i++){
+     int cx, cy;
+     blocos_celula(jogo.blocos.peca, jogo.blocos.rotacao, i, &cx, &cy);
+     if(jogo.blocos.y + cy < 0){ //Parou para fora da tela
+         jogo_terminar();
+         return;
+        }
+     jogo.blocos.pilha[jogo.blocos.y + cy] |= 1u << (jogo.blocos.x + cx);
+    }
+ for(int y = JOGO_LINHAS - 1; y >= 0;){
+     if(jogo.blocos.pilha[y] != (1u << NUM_COLUNAS) - 1){
+         y--;
+         continue;
+        }
+     for(int acima = y; acima > 0; acima--)
+         jogo.blocos.pilha[acima] = jogo.blocos.pilha[acima - 1];
+     jogo.blocos.pilha[0] = 0;
+     jogo.pontos++;
+    }
+ blocos_nova_peca();
+}
 
-    {
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0},
-    },
+static void blocos_passo(void){
+ if(blocos_cabe(jogo.blocos.rotacao, jogo.blocos.x, jogo.blocos.y + 1))
+     jogo.blocos.y++;
+ else
+     blocos_fixar();
+}
 
-    {
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0},
-    },
+static bool blocos_tecla(char tecla){
+ switch(tecla){
+  case '4':
+  case '6': {
+     int8_t x = jogo.blocos.x + (tecla == '4' ? -1 : 1);
+     if(!blocos_cabe(jogo.blocos.rotacao, x, jogo.blocos.y))
+         return false;
+     jogo.blocos.x = x;
+     return true;
+    }
+  case '2':
+  case '5': { //Gira; encostada na parede, tenta uma coluna para cada lado
+     uint8_t rotacao = (jogo.blocos.rotacao + 1) & 3;
+     for(int8_t chute = 0; chute <= 2; chute++){
+         int8_t x = jogo.blocos.x + (chute == 1 ? -1 : chute == 2 ? 1 : 0);
+         if(blocos_cabe(rotacao, x, jogo.blocos.y)){
+             jogo.blocos.rotacao = rotacao;
+             jogo.blocos.x = x;
+             return true;
+            }
+        }
+     return false;
+    }
+  case '8': //Desce uma linha agora
+     blocos_passo();
+     return true;
+  default:
+     return false;
+ }
+}
 
-    {
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0},
-    },
+static void blocos_desenhar(uint8_t grade[JOGO_LINHAS][NUM_COLUNAS]){
+ for(int y = 0; y < JOGO_LINHAS; y++)
+     for(int x = 0; x < NUM_COLUNAS; x++)
+         if(jogo.blocos.pilha[y] >> x & 1)
+             grade[y][x] = COR_JOGO_PILHA;
+ for(uint i = 0; i < 3; i++){
+     int cx, cy;
+     blocos_celula(jogo.blocos.peca, jogo.blocos.rotacao, i, &cx, &cy);
+     if(jogo.blocos.y + cy >= 0)
+         grade[jogo.blocos.y + cy][jogo.blocos.x + cx] = COR_JOGO_PECA;
+    }
+}
 
-    {
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-    },
+const jogo_def_t jogo_cobra = {"snake", 300, cobra_iniciar, cobra_passo, cobra_tecla, cobra_desenhar};
+const jogo_def_t jogo_pong = {"pong", 250, pong_iniciar, pong_passo, pong_tecla, pong_desenhar};
+const jogo_def_t jogo_blocos = {"blocos", 600, blocos_iniciar, blocos_passo, blocos_tecla, blocos_desenhar};
 
-    {
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-    },
+/**
+* Desenha o jogo na matriz. No fim de jogo, as piscadas ímpares pintam tudo que estava
+* aceso de COR_JOGO_FIM.
+*/
+void jogo_mostrar(void){
+ uint8_t grade[JOGO_LINHAS][NUM_COLUNAS] = {{COR_JOGO_FUNDO}};
+ jogo.def->desenhar(grade);
+ for(int y = 0; y < JOGO_LINHAS; y++)
+     for(int x = 0; x < NUM_COLUNAS; x++){
+         uint8_t cor = (jogo.fim & 1) && grade[y][x] != COR_JOGO_FUNDO ? COR_JOGO_FIM : grade[y][x];
+         np_desenhar(correcao_index(y * NUM_COLUNAS + x), jogo_cores[cor][0] << 8, jogo_cores[cor][1] << 8,
+                     jogo_cores[cor][2] << 8);
+        }
+ npWrite();
+}
 
-    {
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0},
-    },
+// Começa (ou recomeça) a partida do jogo atual
+static void jogo_comecar(void){
+ jogo.fim = 0;
+ jogo.pontos = 0;
+ jogo.def->iniciar();
+ jogo.proximo = make_timeout_time_ms(jogo.def->passo_ms);
+ jogo_mostrar();
+}
 
-    {
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0},
-    },
+/**
+* Começa um jogo, no lugar do que estiver rodando.
+*/
+void jogo_iniciar(const jogo_def_t *def){
+ jogo_parar();
+ jogo.def = def;
+ jogo.aleatorio = time_us_32() | 1;
+ jogo.recorde = 0;
+ jogo.passos = jogo.recuperados = jogo.descartados = 0;
+ jogo.entradas = jogo.latencia_max_us = 0;
+ jogo.latencia_total_us = 0;
+ jogo.ativo = true;
+ indicador_ocupado(true);
+ jogo_comecar();
+ printf("Jogo: %s (passo de %u ms)\n", def->nome, def->passo_ms);
+}
 
-    {
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0},
-    },
+void jogo_cobra_iniciar(void) { jogo_iniciar(&jogo_cobra); }
+void jogo_pong_iniciar(void) { jogo_iniciar(&jogo_pong); }
+void jogo_blocos_iniciar(void) { jogo_iniciar(&jogo_blocos); }
 
-    {
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0},
-    },
+/**
+* Encerra o jogo e mostra o ritmo e a latência das teclas que ele teve.
+*/
+void jogo_parar(void){
+ if(!jogo.ativo)
+     return;
+ jogo.ativo = false;
+ indicador_ocupado(false);
+ printf("Jogo %s: recorde %u, %lu passos (%lu recuperados, %lu descartados)\n", jogo.def->nome, jogo.recorde,
+        (unsigned long)jogo.passos, (unsigned long)jogo.recuperados, (unsigned long)jogo.descartados);
+ if(jogo.entradas)
+     printf("Latência tecla -> LEDs: média %lu us, máx. %lu us (limite %d us)\n",
+            (unsigned long)(jogo.latencia_total_us / jogo.entradas), (unsigned long)jogo.latencia_max_us,
+            JOGO_LATENCIA_LIMITE_US);
+}
 
-    {
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0},
-    },
+// Do npWrite até os LEDs travarem o quadro: com dithering o quadro sai no próximo refresh
+static uint32_t jogo_latencia_saida_us(void){
+ return (dither_ativo ? 1000000 / TAXA_DITHER_HZ : 0) + QUADRO_WS2812_US + RESET_WS2812_US;
+}
 
-    {
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0},
-    },
+/**
+* Entrega uma tecla ao jogo, que a aplica e redesenha na hora. 'instante_us' é o momento
+* do evento do teclado, para medir a latência até os LEDs. Retorna false se a tecla não é
+* de jogo (só os números são), para ela seguir o caminho normal.
+*/
+bool jogo_tecla(char tecla, uint32_t instante_us){
+ if(!jogo.ativo || tecla < '0' || tecla > '9')
+     return false;
+ if(jogo.fim || !jogo.def->tecla(tecla))
+     return true;
+ jogo_mostrar();
+ uint32_t latencia = time_us_32() - instante_us + jogo_latencia_saida_us();
+ jogo.entradas++;
+ jogo.latencia_total_us += latencia;
+ if(latencia > jogo.latencia_max_us)
+     jogo.latencia_max_us = latencia;
+ return true;
+}
 
-    {
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0},
-    },
+/**
+* Como player_tick: faz os passos vencidos e antecipa 'prazo' para o próximo.
+*/
+bool jogo_tick(absolute_time_t *prazo){
+ if(!jogo.ativo)
+     return false;
+ uint passos = 0;
+ while(time_reached(jogo.proximo) && passos < JOGO_PASSOS_ATRASADOS){
+     passos++;
+     if(jogo.fim){
+         jogo.proximo = delayed_by_us(jogo.proximo, jogo_passo_us());
+         if(--jogo.fim == 0){
+             jogo_comecar();
+             passos = 0; //jogo_comecar já desenhou
+             break;
+            }
+         continue;
+        }
+     jogo.proximo = delayed_by_us(jogo.proximo, jogo_passo_us());
+     jogo.def->passo(); //Pode terminar a partida e remarcar o prazo
+     jogo.passos++;
+    }
+ if(passos > 1)
+     jogo.recuperados += passos - 1;
+ if(time_reached(jogo.proximo)){ //Atrasou mais que JOGO_PASSOS_ATRASADOS: descarta o resto
+     jogo.descartados++;
+     jogo.proximo = make_timeout_time_us(jogo_passo_us());
+    }
+ if(passos)
+     jogo_mostrar();
+ if(absolute_time_diff_us(jogo.proximo, *prazo) > 0)
+     *prazo = jogo.proximo;
+ return true;
+}
 
-    {
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-    },
+// Quadros pela rede: E1.31 (sACN) e DDP, os protocolos das mesas e programas de
+// iluminação. O pacote é lido direto do buffer onde chegou (o pbuf do lwIP na placa) para
+// o framebuffer, sem cópia intermediária: cada trio de canais vira um pixel. Cada universo
+// E1.31 leva REDE_CANAIS_UNIVERSO canais; REDE_UNIVERSO e REDE_ENDERECO dizem onde a
+// matriz começa, e no DDP o começo é o byte REDE_DDP_OFFSET. Os canais vêm em RGB, com os
+// LEDs na ordem em que a matriz é vista de frente.
+#define SACN_PORTA 5568
+#define DDP_PORTA 4048
+#define REDE_UNIVERSO 1          // Universo E1.31 do primeiro LED
+#define REDE_ENDERECO 1          // Endereço DMX (1 a 512) do primeiro LED nesse universo
+#define REDE_CANAIS_UNIVERSO 510 // 170 LEDs RGB por universo; os canais 511 e 512 ficam sem uso
+#define REDE_DDP_OFFSET 0
+#define REDE_CANAIS (NUM_LEDS * 3)
+#define REDE_UNIVERSOS ((REDE_ENDERECO - 1 + REDE_CANAIS + REDE_CANAIS_UNIVERSO - 1) / REDE_CANAIS_UNIVERSO)
+#define REDE_TIMEOUT_MS 2500     // Sem pacotes por esse tempo a fonte sumiu (perda de dados do E1.31)
+#define REDE_JANELA_SEQUENCIA 20 // E1.31: até 20 números atrás do último, o pacote é velho
+
+#define E131_VETOR_DADOS 0x00000004
+#define E131_VETOR_ESTENDIDO 0x00000008
+#define E131_VETOR_QUADRO 0x00000002
+#define E131_VETOR_SINCRONIA 0x00000001
+#define E131_PREVIA 0x80         // Opções: dados de pré-visualização, não são para mostrar
+#define E131_TERMINADO 0x40      // Opções: a fonte encerrou o fluxo
+#define E131_CABECALHO 126       // Até o primeiro canal (depois do start code)
+#define E131_SINCRONIA_TAMANHO 49
+
+#define DDP_CABECALHO 10
+#define DDP_VERSAO 0x40
+#define DDP_TEMPO 0x10           // Flags: há 4 bytes de timecode depois do cabeçalho
+#define DDP_RESPOSTA 0x04
+#define DDP_CONSULTA 0x02
+#define DDP_PUSH 0x01            // Flags: o quadro está completo, mostrar
+#define DDP_TIPO_RGB8 0x0B
+#define DDP_ID_TELA 1
+#define DDP_ID_TODOS 255
+
+typedef enum {
+ REDE_ACEITO,
+ REDE_INVALIDO,       // Não é E1.31 nem DDP bem formado
+ REDE_IGNORADO,       // Bem formado, mas não é para nós (outro universo, prévia, consulta)
+ REDE_FORA_DE_ORDEM,  // Número de sequência repetido ou velho
+ REDE_OUTRA_FONTE,    // Outra fonte E1.31 com prioridade menor ou igual
+ REDE_PAUSADO         // Um clipe ou modo local tem a matriz
+} rede_resultado_t;
+
+typedef struct {
+ bool ativo;                 // Os quadros da rede estão na matriz
+ bool pausada;               // Uma ação local assumiu: pacotes ignorados até a fonte parar
+ bool wifi;                  // Rádio ligado (só na Pico W)
+ absolute_time_t ultimo;     // Último pacote bem formado para nós
+ bool tem_fonte;             // E1.31: fonte escolhida (CID e prioridade)
+ uint8_t cid[16];
+ uint8_t prioridade;
+ uint8_t sequencia[REDE_UNIVERSOS]; // E1.31: último número de cada universo
+ bool tem_sequencia[REDE_UNIVERSOS];
+ uint8_t sequencia_ddp;      // 0 = nenhum
+ uint16_t sincronia;         // Universo de sincronia aguardado para mostrar (0 = nenhum)
+ uint32_t pacotes, quadros, fora_de_ordem, invalidos, ignorados, copias;
+} rede_t;
+
+rede_t rede;
+
+static inline uint16_t be16(const uint8_t *p) { return p[0] << 8 | p[1]; }
+static inline uint32_t be32(const uint8_t *p) { return (uint32_t)p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3]; }
+
+static const uint8_t acn_identificador[12] = {'A', 'S', 'C', '-', 'E', '1', '.', '1', '7', 0, 0, 0};
+
+// Escreve 'n' canais a partir do canal 'canal' da matriz (0 = R do primeiro LED). Canais
+// fora da matriz são pulados; um LED cortado entre dois pacotes mantém os outros canais.
+static void rede_canais(int32_t canal, const uint8_t *dados, uint32_t n){
+ if(canal < 0){
+     if((uint32_t)-canal >= n)
+         return;
+     dados -= canal;
+     n += canal;
+     canal = 0;
+    }
+ if(canal >= REDE_CANAIS)
+     return;
+ if(n > (uint32_t)(REDE_CANAIS - canal))
+     n = REDE_CANAIS - canal;
+ while(n){
+     uint led = canal / 3, cor = canal % 3;
+     uint index = correcao_index(led);
+     if(cor == 0 && n >= 3){
+         np_desenhar(index, dados[0] << 8, dados[1] << 8, dados[2] << 8);
+         dados += 3;
+         canal += 3;
+         n -= 3;
+         continue;
+        }
+     uint16_t rgb[3] = {np_alvo[index].R, np_alvo[index].G, np_alvo[index].B};
+     for(; cor < 3 && n; cor++, n--, canal++)
+         rgb[cor] = *dados++ << 8;
+     np_desenhar(index, rgb[0], rgb[1], rgb[2]);
+    }
+}
 
-    {
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-    },
+// Primeiro pacote de um fluxo: a rede assume a matriz se nada local estiver tocando
+static bool rede_assumir(void){
+ rede.ultimo = get_absolute_time();
+ if(rede.ativo)
+     return true;
+ if(rede.pausada || player.ativo || audio.ativo || jogo.ativo)
+     return false;
+ rede.ativo = true;
+ indicador_ocupado(true);
+ printf("Rede: recebendo quadros\n");
+ return true;
+}
 
-    {
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0},
-    },
+static void rede_mostrar(void){
+ npWrite();
+ rede.quadros++;
+}
 
-    {
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0},
-    },
+/**
+* Fim do fluxo (timeout ou aviso da fonte): apaga a matriz e esquece a fonte.
+*/
+void rede_encerrar(void){
+ rede.tem_fonte = false;
+ rede.sequencia_ddp = 0;
+ rede.sincronia = 0;
+ for(int u = 0; u < REDE_UNIVERSOS; u++)
+     rede.tem_sequencia[u] = false;
+ if(!rede.ativo)
+     return;
+ rede.ativo = false;
+ indicador_ocupado(false);
+ npClear();
+ npWrite();
+ printf("Rede: fim do fluxo; %lu pacotes, %lu quadros, %lu fora de ordem, %lu inválidos, %lu ignorados\n",
+        (unsigned long)rede.pacotes, (unsigned long)rede.quadros, (unsigned long)rede.fora_de_ordem,
+        (unsigned long)rede.invalidos, (unsigned long)rede.ignorados);
+}
 
-    {
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0},
-    },
+/**
+* Uma ação local (clipe, modo ou cor) assumiu a matriz: a rede para de desenhar até a
+* fonte ficar REDE_TIMEOUT_MS sem mandar nada.
+*/
+void rede_pausar(void){
+ if(!rede.ativo)
+     return;
+ rede.ativo = false;
+ rede.pausada = true;
+ indicador_ocupado(false);
+}
 
-    {
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0},
-    },
+static rede_resultado_t e131_receber(const uint8_t *p, uint tamanho){
+ if(tamanho < E131_SINCRONIA_TAMANHO || be16(p) != 0x0010 || be16(p + 2) != 0 ||
+    memcmp(p + 4, acn_identificador, sizeof(acn_identificador)))
+     return REDE_INVALIDO;
+ const uint8_t *cid = p + 22;
+ if(be32(p + 18) == E131_VETOR_ESTENDIDO){
+     if(be32(p + 40) != E131_VETOR_SINCRONIA)
+         return REDE_IGNORADO; //Descoberta de universos
+     if(!rede.tem_fonte || memcmp(cid, rede.cid, 16) || !rede.sincronia || be16(p + 45) != rede.sincronia)
+         return REDE_IGNORADO;
+     if(!rede_assumir())
+         return REDE_PAUSADO;
+     rede.sincronia = 0;
+     rede_mostrar();
+     return REDE_ACEITO;
+    }
+ if(be32(p + 18) != E131_VETOR_DADOS || tamanho < E131_CABECALHO || be32(p + 40) != E131_VETOR_QUADRO ||
+    p[117] != 0x02 || p[118] != 0xa1 || be16(p + 119) != 0 || be16(p + 121) != 1)
+     return REDE_INVALIDO;
+ uint contagem = be16(p + 123); //Start code + canais
+ if(contagem < 1 || contagem > 513 || tamanho < E131_CABECALHO - 1 + contagem)
+     return REDE_INVALIDO;
+ int universo = (int)be16(p + 113) - REDE_UNIVERSO;
+ uint8_t opcoes = p[112], prioridade = p[108], sequencia = p[111];
+ if(universo < 0 || universo >= REDE_UNIVERSOS || (opcoes & E131_PREVIA) || p[125] != 0)
+     return REDE_IGNORADO;
+
+ if(!rede.tem_fonte || memcmp(cid, rede.cid, 16)){
+     if(rede.tem_fonte && prioridade <= rede.prioridade)
+         return REDE_OUTRA_FONTE;
+     memcpy(rede.cid, cid, 16); //Fonte nova, ou de prioridade maior: recomeça as sequências
+     rede.prioridade = prioridade;
+     rede.tem_fonte = true;
+     for(int u = 0; u < REDE_UNIVERSOS; u++)
+         rede.tem_sequencia[u] = false;
+    }
+ if(opcoes & E131_TERMINADO){
+     rede_encerrar();
+     return REDE_ACEITO;
+    }
+ if(rede.tem_sequencia[universo]){
+     int8_t diferenca = (int8_t)(sequencia - rede.sequencia[universo]);
+     if(diferenca <= 0 && diferenca > -REDE_JANELA_SEQUENCIA)
+         return REDE_FORA_DE_ORDEM;
+    }
+ rede.sequencia[universo] = sequencia;
+ rede.tem_sequencia[universo] = true;
+ if(!rede_assumir())
+     return REDE_PAUSADO;
+ rede_canais(universo * REDE_CANAIS_UNIVERSO - (REDE_ENDERECO - 1), p + E131_CABECALHO, contagem - 1);
+ if(universo == REDE_UNIVERSOS - 1){ //Último universo da matriz: o quadro está completo
+     uint16_t sincronia = be16(p + 109);
+     if(sincronia)
+         rede.sincronia = sincronia; //Mostra quando chegar a sincronia
+     else
+         rede_mostrar();
+    }
+ return REDE_ACEITO;
+}
 
-    {
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-    },
+static rede_resultado_t ddp_receber(const uint8_t *p, uint tamanho){
+ if(tamanho < DDP_CABECALHO || (p[0] & 0xC0) != DDP_VERSAO)
+     return REDE_INVALIDO;
+ uint8_t flags = p[0];
+ uint cabecalho = DDP_CABECALHO + (flags & DDP_TEMPO ? 4 : 0);
+ uint32_t offset = be32(p + 4);
+ uint n = be16(p + 8);
+ if(tamanho < cabecalho + n)
+     return REDE_INVALIDO;
+ if((flags & (DDP_CONSULTA | DDP_RESPOSTA)) || (p[3] != DDP_ID_TELA && p[3] != DDP_ID_TODOS) ||
+    (p[2] != 0 && p[2] != 1 && p[2] != DDP_TIPO_RGB8))
+     return REDE_IGNORADO;
+ uint8_t sequencia = p[1] & 0x0F; //1 a 15; 0 = sem sequência
+ if(sequencia && rede.sequencia_ddp){
+     uint diferenca = (sequencia - rede.sequencia_ddp + 15) % 15;
+     if(diferenca == 0 || diferenca > 7)
+         return REDE_FORA_DE_ORDEM;
+    }
+ if(sequencia)
+     rede.sequencia_ddp = sequencia;
+ if(!rede_assumir())
+     return REDE_PAUSADO;
+ rede_canais((int32_t)(offset - REDE_DDP_OFFSET), p + cabecalho, n);
+ if(flags & DDP_PUSH)
+     rede_mostrar();
+ return REDE_ACEITO;
+}
 
-    {
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-    },
+/**
+* Trata um pacote UDP que chegou na 'porta' (SACN_PORTA ou DDP_PORTA). O pacote é lido no
+* lugar; nada é guardado depois que a função volta.
+*/
+rede_resultado_t rede_receber(const uint8_t *pacote, uint tamanho, uint porta){
+ rede_resultado_t r = porta == SACN_PORTA ? e131_receber(pacote, tamanho)
+                    : porta == DDP_PORTA  ? ddp_receber(pacote, tamanho) : REDE_IGNORADO;
+ rede.pacotes++;
+ if(r == REDE_INVALIDO)
+     rede.invalidos++;
+ else if(r == REDE_FORA_DE_ORDEM)
+     rede.fora_de_ordem++;
+ else if(r != REDE_ACEITO)
+     rede.ignorados++;
+ if(r == REDE_PAUSADO || r == REDE_FORA_DE_ORDEM)
+     rede.ultimo = get_absolute_time(); //A fonte continua mandando
+ return r;
+}
 
-    {
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-    },
+#if REDE_WIFI
+// Na Pico W o lwIP roda no modo poll: cyw43_arch_poll no laço principal chama os
+// callbacks de recepção, então o pacote é desenhado no mesmo contexto que o player.
+#define REDE_POLL_MS 10 // Intervalo máximo entre chamadas a cyw43_arch_poll (timers do lwIP)
+struct udp_pcb *rede_pcb_sacn, *rede_pcb_ddp;
+bool rede_conectada;
+
+static void rede_udp_recebido(void *arg, struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *endereco, u16_t porta){
+ static uint8_t montagem[1500];
+ uint porta_local = (uint)(uintptr_t)arg;
+ if(p->len == p->tot_len){
+     rede_receber(p->payload, p->len, porta_local);
+    }else if(p->tot_len <= sizeof(montagem)){ //Pacote em vários pbufs: única cópia
+     rede.copias++;
+     pbuf_copy_partial(p, montagem, p->tot_len, 0);
+     rede_receber(montagem, p->tot_len, porta_local);
+    }
+ pbuf_free(p);
+}
 
-    {
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-    },
-};
+static struct udp_pcb *rede_abrir(uint porta){
+ struct udp_pcb *pcb = udp_new();
+ if(!pcb || udp_bind(pcb, IP_ANY_TYPE, porta) != ERR_OK)
+     panic("Rede: porta UDP %u indisponível", porta);
+ udp_recv(pcb, rede_udp_recebido, (void *)(uintptr_t)porta);
+ return pcb;
+}
 
-double animacao_vinicobra[28][NUM_LEDS][3]={   
-    {//0
-        {1.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {1.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {1.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {1.0, 1.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {1.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-    },
-
-   {//1
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {1.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {1.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {1.0, 1.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {1.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {1.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-    },
-
-   {//2
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {1.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {1.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {1.0, 1.0, 1.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 0.0},
-        {1.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {1.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-    },
-
-   {//3
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {1.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {1.0, 1.0, 1.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 0.0},
-        {1.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {1.0, 0.0, 1.0}, {1.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-    },
-
-   {//4
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 1.0, 1.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 0.0},
-        {1.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {1.0, 0.0, 1.0}, {1.0, 0.0, 1.0}, {1.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-    },
-
-   {//5
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 1.0, 1.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {1.0, 0.0, 1.0}, {1.0, 0.0, 1.0}, {1.0, 0.0, 1.0}, {1.0, 0.0, 1.0}, {0.0, 0.0, 0.0},
-    },
-
-   {//6
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 1.0, 1.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {1.0, 0.0, 1.0}, {1.0, 0.0, 1.0}, {1.0, 0.0, 1.0}, {1.0, 0.0, 1.0},
-    },
-
-   {//7
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 1.0, 1.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 1.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 1.0}, {1.0, 0.0, 1.0}, {1.0, 0.0, 1.0},
-    },
-
-
-   {//8
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 1.0, 1.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 1.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 1.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 1.0}, {1.0, 0.0, 1.0}, {1.0, 0.0, 1.0},
-    },
-
-   {//9
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 1.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 1.0, 1.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 1.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 1.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 1.0}, {1.0, 0.0, 1.0},
-    },
-
-   {
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 1.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 1.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 1.0, 1.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 1.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 1.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 1.0},
-    },
-
-   {
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 1.0}, {1.0, 0.0, 1.0}, 
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 1.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 1.0, 1.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 1.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 1.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-    },
-
-   {
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 1.0}, {1.0, 0.0, 1.0}, {1.0, 0.0, 1.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 1.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 1.0, 1.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 1.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 1.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-    },
-
-   {
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 1.0}, {1.0, 0.0, 1.0}, {1.0, 0.0, 1.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 1.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 1.0, 1.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 1.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-    },
-
-   {
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 1.0}, {1.0, 0.0, 1.0}, {1.0, 0.0, 1.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 1.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 1.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-    },
-
-   {
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 1.0}, {1.0, 0.0, 1.0}, {1.0, 0.0, 1.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 1.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-    },
-
-
-   {
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 1.0}, {1.0, 0.0, 1.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 1.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-    },
-
-
-   {
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 1.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-    },
-
-
-   {
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 1.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-    },
-
-
-   {
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 1.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-    },
-
-
-   {
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 1.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0},
-    },
-
-
-   {
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 1.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0},
-        {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0},
-    },
-
-
-   {
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0},
-        {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0},
-        {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0},
-    },
-
-
-   {
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0},
-        {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0},
-        {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0},
-        {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0},
-    },
-
-
-   {
-        {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0},
-        {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0},
-        {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0},
-        {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0},
-        {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0},
-    },
-
-
-   {
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-    },
-};
+/**
+* Liga o rádio e começa a conexão com WIFI_SSID sem esperar; o resto acontece em
+* rede_tick.
+*/
+void rede_iniciar(void){
+ if(cyw43_arch_init()){
+     printf("Rede: falha ao iniciar o rádio\n");
+     return;
+    }
+ cyw43_arch_enable_sta_mode();
+ cyw43_arch_wifi_connect_async(WIFI_SSID, WIFI_PASSWORD, CYW43_AUTH_WPA2_AES_PSK);
+ rede_pcb_sacn = rede_abrir(SACN_PORTA);
+ rede_pcb_ddp = rede_abrir(DDP_PORTA);
+ rede.wifi = true;
+}
 
+// Conectou: entra nos grupos multicast dos universos da matriz (239.255.<universo>)
+static void rede_conectou(void){
+ for(int u = 0; u < REDE_UNIVERSOS; u++){
+     ip4_addr_t grupo;
+     IP4_ADDR(&grupo, 239, 255, (REDE_UNIVERSO + u) >> 8, (REDE_UNIVERSO + u) & 0xFF);
+     igmp_joingroup(IP4_ADDR_ANY4, &grupo);
+    }
+ printf("Rede: conectada em %s, E1.31 na porta %d (universo %d) e DDP na %d\n",
+        ip4addr_ntoa(netif_ip4_addr(netif_default)), SACN_PORTA, REDE_UNIVERSO, DDP_PORTA);
+}
+#endif
 
+/**
+* Como player_tick: atende o rádio, encerra o fluxo que parou e antecipa 'prazo'. Retorna
+* true enquanto os quadros da rede estão na matriz.
+*/
+bool rede_tick(absolute_time_t *prazo){
+#if REDE_WIFI
+ if(rede.wifi){
+     cyw43_arch_poll();
+     bool conectada = cyw43_tcpip_link_status(&cyw43_state, CYW43_ITF_STA) == CYW43_LINK_UP;
+     if(conectada && !rede_conectada)
+         rede_conectou();
+     rede_conectada = conectada;
+     absolute_time_t atender = make_timeout_time_ms(REDE_POLL_MS); //Timers do lwIP
+     if(absolute_time_diff_us(atender, *prazo) > 0)
+         *prazo = atender;
+    }
+#endif
+ if(!rede.ativo && !rede.pausada && !rede.tem_fonte)
+     return false;
+ absolute_time_t fim = delayed_by_ms(rede.ultimo, REDE_TIMEOUT_MS);
+ if(time_reached(fim)){
+     rede.pausada = false;
+     rede_encerrar();
+     return false;
+    }
+ if(absolute_time_diff_us(fim, *prazo) > 0)
+     *prazo = fim;
+ return rede.ativo;
+}
 
-double animacao_vinibrasil[30][NUM_LEDS][3] = {
-    {
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0},
-    },    
+void buttonConfig(const uint BUTTON_PIN)
+{
+    
+    gpio_init(BUTTON_PIN);                //inicializo o pino do botão
+    gpio_set_dir(BUTTON_PIN, GPIO_IN);    //defini entrada
+    gpio_pull_up(BUTTON_PIN);             //habilito o pull up interno 
+}
 
-    {
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0},
-    },    
+// Teclado: uma varredura completa da matriz a cada milissegundo, por timer. Cada tecla
+// tem debounce próprio e o estado das 16 é acompanhado ao mesmo tempo, o que permite
+// acordes de duas teclas, toque longo e repetição automática. Os eventos recebem o
+// instante em que aconteceram e vão para uma fila lida pelo laço principal.
+// Com TECLADO_PIO a varredura é feita por uma máquina PIO, que só interrompe a CPU
+// quando o mapa muda; o timer então só roda enquanto há mudança a confirmar ou tecla
+// segura, e apenas consome o último mapa recebido.
+#define TECLADO_PIO 1
+#define TECLADO_PERIODO_US 1000
+#define TECLADO_FREQ_VARREDURA (1000000.f / TECLADO_PERIODO_US)
+#define TECLADO_ASSENTAMENTO_US 2      // Espera entre ativar a coluna e ler as linhas
+#define TECLADO_DEBOUNCE_VARREDURAS 5  // Varreduras iguais para aceitar uma mudança
+#define TECLA_LONGA_MS 600
+#define TECLA_REPETICAO_MS 150
+#define TECLADO_FILA 16
+
+typedef enum {
+ TECLA_PRESSIONADA,
+ TECLA_SOLTA,
+ TECLA_LONGA,      // Segurada por TECLA_LONGA_MS
+ TECLA_REPETICAO,  // Continua segurada depois do toque longo
+ TECLA_ACORDE      // Segunda tecla pressionada enquanto outra está segura (tecla2 + tecla)
+} tipo_evento_tecla_t;
+
+typedef struct {
+ uint32_t instante_us;
+ char tecla;
+ char tecla2; // Só em TECLA_ACORDE: a tecla que já estava segura
+ uint8_t tipo;
+} evento_tecla_t;
+
+evento_tecla_t fila_teclas[TECLADO_FILA];
+volatile uint8_t fila_teclas_inicio, fila_teclas_fim;
+
+// Bit (linha*4 + coluna) de cada tecla
+volatile uint16_t teclas_seguras;
+uint16_t teclas_longas;
+uint8_t debounce_teclas[16];
+uint32_t tecla_pressionada_em[16], tecla_proxima_repeticao[16];
+uint32_t teclado_varredura_max_us, teclado_fantasmas, teclado_descartados;
+struct repeating_timer timer_teclado;
+bool teclado_rodando = false;
+
+PIO teclado_pio;
+uint teclado_sm;
+bool teclado_pio_ativo = false;
+volatile uint16_t teclado_pio_mapa;  // Último mapa enviado pela máquina PIO
+volatile bool teclado_pio_mudou;
+
+static void teclado_enfileirar(uint8_t tipo, int k, int k2, uint32_t agora) {
+ uint8_t proximo = (fila_teclas_fim + 1) % TECLADO_FILA;
+ if (proximo == fila_teclas_inicio) { // Fila cheia: descarta o evento novo
+   teclado_descartados++;
+   return;
+ }
+ fila_teclas[fila_teclas_fim] = (evento_tecla_t){agora, teclado[k / 4][k % 4], k2 < 0 ? 0 : teclado[k2 / 4][k2 % 4], tipo};
+ fila_teclas_fim = proximo;
+ __sev(); // Acorda o laço principal se ele estiver esperando o próximo quadro
+}
 
-    {
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0},
-    },    
+// Lê as 16 teclas: ativa uma coluna por vez (nível baixo) e lê as 4 linhas de uma vez
+static uint16_t teclado_varrer(void) {
+ uint16_t mapa = 0;
+ for (int c = 0; c < 4; c++) {
+   gpio_clr_mask(1u << colunas[c]);
+   busy_wait_us_32(TECLADO_ASSENTAMENTO_US);
+   uint32_t pinos = gpio_get_all();
+   gpio_set_mask(1u << colunas[c]);
+   for (int l = 0; l < 4; l++)
+     if (!(pinos & (1u << linhas[l])))
+       mapa |= 1u << (l * 4 + c);
+ }
+ return mapa;
+}
 
-    {
-        {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {1.0, 1.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0},
-    },    
+// Sem diodos, três teclas nos cantos de um retângulo fazem o quarto canto parecer
+// pressionado. Se duas linhas têm duas ou mais colunas em comum, a leitura é ambígua.
+static bool teclado_tem_fantasma(uint16_t mapa) {
+ for (int l1 = 0; l1 < 4; l1++)
+   for (int l2 = l1 + 1; l2 < 4; l2++) {
+     uint8_t comum = (mapa >> (4 * l1)) & (mapa >> (4 * l2)) & 0xF;
+     if (comum & (comum - 1))
+       return true;
+   }
+ return false;
+}
 
-    {
-        {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0},
-        {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {1.0, 1.0, 0.0},
-        {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {1.0, 1.0, 0.0}, {0.0, 0.0, 1.0},
-        {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {1.0, 1.0, 0.0},
-        {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0},
-    },    
+static bool teclado_tick(struct repeating_timer *t) {
+ uint32_t agora = time_us_32();
+ uint16_t bruto = teclado_pio_ativo ? teclado_pio_mapa : teclado_varrer();
+ uint32_t custo = time_us_32() - agora;
+ if (custo > teclado_varredura_max_us)
+   teclado_varredura_max_us = custo;
 
-    {
-        {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0},
-        {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {1.0, 1.0, 0.0}, {1.0, 1.0, 0.0},
-        {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {1.0, 1.0, 0.0}, {1.0, 1.0, 0.0}, {0.0, 0.0, 1.0},
-        {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {1.0, 1.0, 0.0}, {1.0, 1.0, 0.0},
-        {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0},
-    },    
+ if (teclado_tem_fantasma(bruto)) { // Mantém o estado anterior até a leitura ficar clara
+   teclado_fantasmas++;
+   bruto = teclas_seguras;
+ }
 
-    {
-        {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0},
-        {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {1.0, 1.0, 0.0}, {1.0, 1.0, 0.0}, {1.0, 1.0, 0.0},
-        {0.0, 1.0, 0.0}, {1.0, 1.0, 0.0}, {1.0, 1.0, 0.0}, {0.0, 0.0, 1.0}, {1.0, 1.0, 0.0},
-        {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {1.0, 1.0, 0.0}, {1.0, 1.0, 0.0}, {1.0, 1.0, 0.0},
-        {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0},
-    },    
+ uint16_t seguras = teclas_seguras;
+ for (int k = 0; k < 16; k++) {
+   uint16_t bit = 1u << k;
+   if ((bruto ^ seguras) & bit) {
+     if (++debounce_teclas[k] < TECLADO_DEBOUNCE_VARREDURAS)
+       continue;
+     debounce_teclas[k] = 0;
+     if (bruto & bit) {
+       // Com exatamente uma outra tecla segura, é um acorde
+       uint16_t outras = seguras & ~bit;
+       if (outras && !(outras & (outras - 1)))
+         teclado_enfileirar(TECLA_ACORDE, k, __builtin_ctz(outras), agora);
+       else
+         teclado_enfileirar(TECLA_PRESSIONADA, k, -1, agora);
+       seguras |= bit;
+       tecla_pressionada_em[k] = agora;
+     } else {
+       teclado_enfileirar(TECLA_SOLTA, k, -1, agora);
+       seguras &= ~bit;
+       teclas_longas &= ~bit;
+     }
+   } else {
+     debounce_teclas[k] = 0;
+     if (!(seguras & bit))
+       continue;
+     if (!(teclas_longas & bit)) {
+       if (agora - tecla_pressionada_em[k] >= TECLA_LONGA_MS * 1000) {
+         teclas_longas |= bit;
+         tecla_proxima_repeticao[k] = agora + TECLA_REPETICAO_MS * 1000;
+         teclado_enfileirar(TECLA_LONGA, k, -1, agora);
+       }
+     } else if ((int32_t)(agora - tecla_proxima_repeticao[k]) >= 0) {
+       tecla_proxima_repeticao[k] += TECLA_REPETICAO_MS * 1000;
+       teclado_enfileirar(TECLA_REPETICAO, k, -1, agora);
+     }
+   }
+ }
+ teclas_seguras = seguras;
 
-    {
-        {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0},
-        {0.0, 1.0, 0.0}, {1.0, 1.0, 0.0}, {1.0, 1.0, 0.0}, {1.0, 1.0, 0.0}, {0.0, 1.0, 0.0},
-        {1.0, 1.0, 0.0}, {1.0, 1.0, 0.0}, {0.0, 0.0, 1.0}, {1.0, 1.0, 0.0}, {1.0, 1.0, 0.0},
-        {0.0, 1.0, 0.0}, {1.0, 1.0, 0.0}, {1.0, 1.0, 0.0}, {1.0, 1.0, 0.0}, {0.0, 1.0, 0.0},
-        {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0},
-    },    
+ // Com a PIO varrendo, o timer para sozinho quando não há nada a acompanhar
+ if (teclado_pio_ativo && !teclado_pio_mudou && bruto == seguras && seguras == 0) {
+   teclado_rodando = false;
+   return false;
+ }
+ teclado_pio_mudou = false;
+ return true;
+}
 
-    {
-        {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0},
-        {1.0, 1.0, 0.0}, {1.0, 1.0, 0.0}, {1.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0},
-        {1.0, 1.0, 0.0}, {0.0, 0.0, 1.0}, {1.0, 1.0, 0.0}, {1.0, 1.0, 0.0}, {0.0, 1.0, 0.0},
-        {1.0, 1.0, 0.0}, {1.0, 1.0, 0.0}, {1.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0},
-        {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0},
-    },    
+void ocioso_sinalizar_tecla(void);
 
-    {
-        {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0},
-        {1.0, 1.0, 0.0}, {1.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0},
-        {0.0, 0.0, 1.0}, {1.0, 1.0, 0.0}, {1.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0},
-        {1.0, 1.0, 0.0}, {1.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0},
-        {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0},
-    },    
+static void teclado_pio_irq(void) {
+ while (!pio_sm_is_rx_fifo_empty(teclado_pio, teclado_sm))
+   teclado_pio_mapa = teclado_isr_para_mapa(pio_sm_get(teclado_pio, teclado_sm));
+ teclado_pio_mudou = true;
+ ocioso_sinalizar_tecla();
+ if (!teclado_rodando) {
+   teclado_rodando = true;
+   add_repeating_timer_us(-TECLADO_PERIODO_US, teclado_tick, NULL, &timer_teclado);
+ }
+}
 
-    {
-        {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0},
-        {1.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0},
-        {1.0, 1.0, 0.0}, {1.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0},
-        {1.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0},
-    },    
+// Tenta colocar a varredura em uma máquina PIO (uma única vez)
+static void teclado_pio_init(void) {
+ static bool tentou = false;
+ uint offset;
+ if (tentou || !TECLADO_PIO)
+   return;
+ tentou = true;
+ if (!pio_reservar(&teclado_program, &teclado_pio, &teclado_sm, &offset))
+   return; // Sem máquina livre: fica a varredura pela CPU
+ teclado_program_init(teclado_pio, teclado_sm, offset, colunas[0], linhas[0], TECLADO_FREQ_VARREDURA);
+ teclado_pio_mapa = 0;
+ pio_set_irqn_source_enabled(teclado_pio, 1, pio_get_rx_fifo_not_empty_interrupt_source(teclado_sm), true);
+ irq_set_exclusive_handler(pio_get_irq_num(teclado_pio, 1), teclado_pio_irq);
+ irq_set_enabled(pio_get_irq_num(teclado_pio, 1), true);
+ teclado_pio_ativo = true;
+}
 
-    {
-        {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {1.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-    },    
+/**
+* Começa (ou retoma) a varredura periódica do teclado.
+*/
+void teclado_iniciar(void) {
+ teclado_pio_init();
+ if (teclado_rodando)
+   return;
+ if (!teclado_pio_ativo)
+   for (int c = 0; c < 4; c++)
+     gpio_put(colunas[c], 1);
+ add_repeating_timer_us(-TECLADO_PERIODO_US, teclado_tick, NULL, &timer_teclado);
+ teclado_rodando = true;
+}
 
-    {
-        {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-    },    
+/**
+* Para a varredura pela CPU (usado pelo modo ocioso, que assume o controle das colunas).
+* Com a PIO varrendo não há nada a pausar: a própria interrupção da PIO acorda a CPU.
+*/
+void teclado_pausar(void) {
+ if (!teclado_rodando || teclado_pio_ativo)
+   return;
+ cancel_repeating_timer(&timer_teclado);
+ teclado_rodando = false;
+}
 
-    {
-        {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-    },    
+/**
+* Retira o evento mais antigo da fila. Retorna false se a fila estiver vazia.
+*/
+bool teclado_proximo_evento(evento_tecla_t *ev) {
+ if (fila_teclas_inicio == fila_teclas_fim)
+   return false;
+ *ev = fila_teclas[fila_teclas_inicio];
+ fila_teclas_inicio = (fila_teclas_inicio + 1) % TECLADO_FILA;
+ return true;
+}
 
-    {
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-    },
+// Nenhuma tecla segura (não há toque longo ou repetição para acompanhar)
+bool teclado_solto(void) {
+ return teclas_seguras == 0;
+}
 
+//Função pra ler o teclado: devolve a próxima tecla pressionada da fila, ou 'n'
+char leitura_teclado()
+{
+    evento_tecla_t ev;
+    while (teclado_proximo_evento(&ev))
     {
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0},
-    },    
+        if (ev.tipo == TECLA_PRESSIONADA)
+            return ev.tecla;
+    }
+    return 'n'; // Valor padrão para quando nenhuma tecla for pressionada
+}
 
-    {
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0},
-    },    
+// Perfis de clock: clk_sys baixo quando ocioso e alto para renderização pesada. Tudo que
+// tira um divisor de clk_sys é recalculado na troca: as máquinas PIO da matriz e do teclado,
+// o meio período do tom e o timer de DMA que dita a taxa de amostragem do sintetizador. O
+// PWM do sintetizador fica com divisor 1: a portadora (clk_sys / PWM_TOPO) continua acima
+// de 46 kHz em todos os perfis. O timer do sistema vem do clk_ref e não muda.
+typedef enum {
+ PERFIL_ECONOMIA, // Ocioso ou só mostrando quadros prontos
+ PERFIL_NORMAL,   // Padrão do SDK
+ PERFIL_TURBO,    // Renderização procedural pesada ou várias fitas
+ NUM_PERFIS_CLOCK
+} perfil_clock_t;
+
+typedef struct {
+ const char *nome;
+ uint32_t khz;
+ enum vreg_voltage tensao; // Acima de 133 MHz o núcleo precisa de 1,15 V
+} perfil_clock_info_t;
+
+const perfil_clock_info_t perfis_clock[NUM_PERFIS_CLOCK] = {
+ {"economia", 48000, VREG_VOLTAGE_DEFAULT},
+ {"normal", 125000, VREG_VOLTAGE_DEFAULT},
+ {"turbo", 200000, VREG_VOLTAGE_1_15},
+};
 
-    {
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0},
-    },    
+#define VREG_ASSENTAR_US 1000 // Espera depois de subir a tensão, como o SDK no boot
 
-    {
-        {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {1.0, 1.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0},
-    },    
+perfil_clock_t perfil_clock_atual = PERFIL_NORMAL;
 
-    {
-        {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0},
-        {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {1.0, 1.0, 0.0},
-        {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {1.0, 1.0, 0.0}, {0.0, 0.0, 1.0},
-        {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {1.0, 1.0, 0.0},
-        {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0},
-    },    
+// Recalcula os divisores de tudo que está rodando para o clk_sys atual
+static void clock_reajustar_divisores(void) {
+ pio_sm_set_clkdiv(np_pio, sm, ws2818b_clkdiv(800000.f));
+ if (teclado_pio_ativo)
+   pio_sm_set_clkdiv(teclado_pio, teclado_sm, teclado_clkdiv(TECLADO_FREQ_VARREDURA));
+ if (tom_disponivel && tom_frequencia)
+   pio_sm_put(tom_pio, tom_sm, tom_ciclos_meio_periodo(tom_frequencia));
+ if (synth_dma[0] >= 0)
+   dma_timer_set_fraction(synth_timer_dma, 1, clock_get_hz(clk_sys) / TAXA_AMOSTRAGEM);
+}
 
-    {
-        {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0},
-        {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {1.0, 1.0, 0.0}, {1.0, 1.0, 0.0},
-        {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {1.0, 1.0, 0.0}, {1.0, 1.0, 0.0}, {0.0, 0.0, 1.0},
-        {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {1.0, 1.0, 0.0}, {1.0, 1.0, 0.0},
-        {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0},
-    },    
+/**
+* Troca o clock do sistema entre quadros: com as interrupções desligadas, espera o quadro em
+* andamento e o reset do fio, muda clk_sys e recalcula os divisores. As esperas ficam dentro
+* da seção crítica para o refresh do dithering não começar outro quadro no meio da troca.
+* Retorna false (sem mudar nada) se o PLL não gerar a frequência do perfil.
+*/
+bool clock_perfil_aplicar(perfil_clock_t perfil) {
+ if (perfil == perfil_clock_atual)
+   return true;
+ const perfil_clock_info_t *novo = &perfis_clock[perfil];
+
+ uint32_t estado = save_and_disable_interrupts();
+ dma_channel_wait_for_finish_blocking(np_dma);
+ busy_wait_until(np_livre_em);
+
+ bool subindo = novo->khz > perfis_clock[perfil_clock_atual].khz;
+ if (subindo && novo->tensao != perfis_clock[perfil_clock_atual].tensao) {
+   vreg_set_voltage(novo->tensao);
+   busy_wait_us_32(VREG_ASSENTAR_US);
+ }
+ bool ok = set_sys_clock_khz(novo->khz, false);
+ if (ok) {
+   // O SDK liga clk_peri ao clk_sys; no PLL USB a UART não depende do perfil
+   clock_configure(clk_peri, 0, CLOCKS_CLK_PERI_CTRL_AUXSRC_VALUE_CLKSRC_PLL_USB, 48 * MHZ, 48 * MHZ);
+#if LIB_PICO_STDIO_UART
+   uart_set_baudrate(uart_default, PICO_DEFAULT_UART_BAUD_RATE);
+#endif
+   clock_reajustar_divisores();
+   if (!subindo)
+     vreg_set_voltage(novo->tensao);
+   perfil_clock_atual = perfil;
+ } else if (subindo) {
+   vreg_set_voltage(perfis_clock[perfil_clock_atual].tensao);
+ }
+ restore_interrupts(estado);
+ return ok;
+}
 
-    {
-        {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0},
-        {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {1.0, 1.0, 0.0}, {1.0, 1.0, 0.0}, {1.0, 1.0, 0.0},
-        {0.0, 1.0, 0.0}, {1.0, 1.0, 0.0}, {1.0, 1.0, 0.0}, {0.0, 0.0, 1.0}, {1.0, 1.0, 0.0},
-        {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {1.0, 1.0, 0.0}, {1.0, 1.0, 0.0}, {1.0, 1.0, 0.0},
-        {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0},
-    },    
+// Perfil para o que está rodando: a FFT do modo áudio, os jogos e os clipes desenhados pela
+// VM geram cada quadro na hora e ficam no turbo; o resto (quadros prontos, rede) no normal.
+// O modo ocioso passa para a economia por conta própria.
+perfil_clock_t perfil_para_carga(void) {
+ if (audio.ativo || jogo.ativo || (player.ativo && player.item.clip->script))
+   return PERFIL_TURBO;
+ return PERFIL_NORMAL;
+}
 
-    {
-        {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0},
-        {0.0, 1.0, 0.0}, {1.0, 1.0, 0.0}, {1.0, 1.0, 0.0}, {1.0, 1.0, 0.0}, {0.0, 1.0, 0.0},
-        {1.0, 1.0, 0.0}, {1.0, 1.0, 0.0}, {0.0, 0.0, 1.0}, {1.0, 1.0, 0.0}, {1.0, 1.0, 0.0},
-        {0.0, 1.0, 0.0}, {1.0, 1.0, 0.0}, {1.0, 1.0, 0.0}, {1.0, 1.0, 0.0}, {0.0, 1.0, 0.0},
-        {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0},
-    },    
+// Modo ocioso: sem animação nem som tocando, as colunas ficam em nível baixo (qualquer
+// tecla puxa sua linha para 0), as linhas armam interrupção de borda de descida e o
+// processador dorme em __wfi com os clocks dos periféricos sem uso desligados.
+volatile bool ocioso_acordou;
+volatile uint64_t ocioso_instante_irq;
+
+// Clocks desligados durante o sono (periféricos que o projeto não usa)
+#define OCIOSO_CLOCKS_EN0 (CLOCKS_SLEEP_EN0_CLK_SYS_SPI1_BITS | CLOCKS_SLEEP_EN0_CLK_PERI_SPI1_BITS | \
+                           CLOCKS_SLEEP_EN0_CLK_SYS_SPI0_BITS | CLOCKS_SLEEP_EN0_CLK_PERI_SPI0_BITS | \
+                           CLOCKS_SLEEP_EN0_CLK_SYS_RTC_BITS | CLOCKS_SLEEP_EN0_CLK_RTC_RTC_BITS | \
+                           CLOCKS_SLEEP_EN0_CLK_SYS_PWM_BITS | CLOCKS_SLEEP_EN0_CLK_SYS_JTAG_BITS | \
+                           CLOCKS_SLEEP_EN0_CLK_SYS_I2C1_BITS | CLOCKS_SLEEP_EN0_CLK_SYS_I2C0_BITS | \
+                           CLOCKS_SLEEP_EN0_CLK_SYS_ADC_BITS | CLOCKS_SLEEP_EN0_CLK_ADC_ADC_BITS)
+#define OCIOSO_CLOCKS_EN1 (CLOCKS_SLEEP_EN1_CLK_SYS_UART1_BITS | CLOCKS_SLEEP_EN1_CLK_PERI_UART1_BITS | \
+                           CLOCKS_SLEEP_EN1_CLK_SYS_TBMAN_BITS)
+
+// Chamada pelas interrupções de teclado (linhas ou PIO) e da serial para encerrar o sono
+void ocioso_sinalizar_tecla(void){
+    if(!ocioso_acordou)
+        ocioso_instante_irq = time_us_64();
+    ocioso_acordou = true;
+}
 
-    {
-        {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0},
-        {1.0, 1.0, 0.0}, {1.0, 1.0, 0.0}, {1.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0},
-        {1.0, 1.0, 0.0}, {0.0, 0.0, 1.0}, {1.0, 1.0, 0.0}, {1.0, 1.0, 0.0}, {0.0, 1.0, 0.0},
-        {1.0, 1.0, 0.0}, {1.0, 1.0, 0.0}, {1.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0},
-        {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0},
-    },    
+static void ocioso_irq_linha(uint gpio, uint32_t events){
+    ocioso_sinalizar_tecla();
+}
 
-    {
-        {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0},
-        {1.0, 1.0, 0.0}, {1.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0},
-        {0.0, 0.0, 1.0}, {1.0, 1.0, 0.0}, {1.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0},
-        {1.0, 1.0, 0.0}, {1.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0},
-        {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0},
-    },    
+// Dorme até alguma tecla ser pressionada. Mede a latência entre a interrupção e a volta.
+void ocioso_aguardar_tecla(void){
+    bool dither_antes = dither_ativo;
 
-    {
-        {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0},
-        {1.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0},
-        {1.0, 1.0, 0.0}, {1.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0},
-        {1.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0},
-    },    
+    // Sem dithering a matriz não precisa de refresh: envia um quadro final e para o timer
+    npSetDither(false);
+    npWrite();
+    perfil_clock_t perfil_antes = perfil_clock_atual;
+    clock_perfil_aplicar(PERFIL_ECONOMIA);
+
+    ocioso_acordou = false;
+    if (!teclado_pio_ativo) { // Com a PIO varrendo, a interrupção dela acorda a CPU
+        teclado_pausar();
+        for (int i = 0; i < 4; i++)
+            gpio_put(colunas[i], 0); // Estaciona as colunas em nível baixo
+        for (int i = 0; i < 4; i++){
+            gpio_set_irq_enabled_with_callback(linhas[i], GPIO_IRQ_EDGE_FALL, true, ocioso_irq_linha);
+            if (gpio_get(linhas[i]) == 0) // Tecla já pressionada: não dorme
+                ocioso_acordou = true;
+        }
+    }
 
-    {
-        {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {1.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-    },    
+    uint32_t sleep_en0 = clocks_hw->sleep_en0, sleep_en1 = clocks_hw->sleep_en1;
+    clocks_hw->sleep_en0 = sleep_en0 & ~OCIOSO_CLOCKS_EN0;
+    clocks_hw->sleep_en1 = sleep_en1 & ~OCIOSO_CLOCKS_EN1;
+    scb_hw->scr |= M0PLUS_SCR_SLEEPDEEP_BITS;
+
+    uint64_t inicio = time_us_64();
+    uint32_t estado = save_and_disable_interrupts();
+    while (!ocioso_acordou) {
+        __wfi(); // Acorda com a interrupção pendente mesmo com elas mascaradas
+        restore_interrupts(estado); // Deixa a interrupção (teclado, USB, timer) ser atendida
+        estado = save_and_disable_interrupts();
+    }
+    restore_interrupts(estado);
+    uint64_t volta = time_us_64();
+
+    scb_hw->scr &= ~M0PLUS_SCR_SLEEPDEEP_BITS;
+    clocks_hw->sleep_en0 = sleep_en0;
+    clocks_hw->sleep_en1 = sleep_en1;
+
+    if (!teclado_pio_ativo)
+        for (int i = 0; i < 4; i++)
+            gpio_set_irq_enabled(linhas[i], GPIO_IRQ_EDGE_FALL, false);
+    clock_perfil_aplicar(perfil_antes);
+    teclado_iniciar(); // Recoloca as colunas em nível alto e volta a varrer
+    npSetDither(dither_antes);
+
+    if (volta > ocioso_instante_irq && ocioso_instante_irq >= inicio)
+        printf("Ocioso por %llu ms, latência de despertar %llu us, varredura do teclado até %lu us\n",
+               (unsigned long long)(volta - inicio) / 1000, (unsigned long long)(volta - ocioso_instante_irq),
+               (unsigned long)teclado_varredura_max_us);
+}
 
-    {
-        {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-    },    
+// Função inicial para configurar os pinos
+void configurar_pino(int pino, bool direcao, bool estado) {
+    gpio_init(pino);
+    gpio_set_dir(pino, direcao);
+    gpio_put(pino, estado);
+}
 
-    {
-        {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-    },    
+// Declaração do buffer de pixels que formam a matriz.
+npLED_t leds[NUM_LEDS];
 
-    {
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-    },
-};    
-
-double animacao_filipe_pong[17][NUM_LEDS][3]={
-    { // Quadro 1
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}
-    },
-    { // Quadro 2
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}
-    },
-    { // Quadro 3
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}
-    },
-    { // Quadro 4
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}
-    },
-    { // Quadro 5
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}
-    },
-    { // Quadro 6
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}
-    },
-    { // Quadro 7
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}
-    },
-    { // Quadro 8
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}
-    },
-    { // Quadro 9
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}
-    },
-    { // Quadro 10
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}
-    },
-    { // Quadro 11
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}
-    },
-    { // Quadro 12
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 1.0, 0.0}
-    },
-    { // Quadro 13
-        {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0},
-        {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0},
-        {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0},
-        {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0},
-        {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}
-    },
-    { // Quadro 14
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}
-    },
-    { // Quadro 15
-        {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0},
-        {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0},
-        {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0},
-        {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0},
-        {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}
-    },
-    { // Quadro 16
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}
-    },
-    { // Quadro 17
-        {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0},
-        {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0},
-        {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0},
-        {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0},
-        {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}
-    },
+// Variáveis para uso da máquina PIO.
+PIO np_pio;
+uint sm;
+
+// Funções de teclas específicas
+void desligarTodosOsLeds() {
+   npClear();
+    npWrite();
+
+}
+void ligarLEDsAzuis() {
+    for (int i = 0; i < NUM_LEDS; i++) {
+        npSetLED(i,0,0,255);
+    }
+    npWrite();
+}
+void ligarLEDsVermelhos() {
+    for (int i = 0; i < NUM_LEDS; i++) {
+                npSetLED(i,1,0,0);
+    }
+    npWrite();
+}
+void ligarLEDsVerdes() {
+    for (int i = 0; i < NUM_LEDS; i++) {
+                npSetLED(i,0,40,0);
+    }
+    npWrite();
+}
+
+void ligarLEDsBrancos() {
+    for (int i = 0; i < NUM_LEDS; i++) {
+        npSetLED(i,160,160,160);
+    }
+    npWrite();
+}
+
+//Só funciona na animação Vinicobra: bipes quando a cobra come e quando o jogo acaba
+void som_vinicobra(int quadro){
+ if(quadro==2 || quadro==8 || quadro==12){
+  tom_tocar_por(1000,80);
+  //printf("Tocou a nota em i=%d\n",quadro);
+ }else if(quadro==19){
+  tom_tocar_por(3000,80);
+  //printf("Tocou a nota em i=19\n");
+ }
+}
+
+// Fila de ações das teclas. Cada ação tem uma prioridade:
+typedef enum {
+ PRIORIDADE_FILA,      // Entra na playlist e toca quando as anteriores terminarem
+ PRIORIDADE_SUBSTITUI, // Substitui o clipe atual no próximo quadro; a playlist continua depois
+ PRIORIDADE_IMEDIATA   // Interrompe o clipe e esvazia a playlist (cores sólidas e apagar)
+} prioridade_t;
+
+typedef struct {
+ prioridade_t prioridade;
+ const clip_t *clip;     // Clipe a tocar, ou NULL
+ void (*executar)(void); // Ação instantânea (cor sólida, apagar), ou NULL
+} acao_t;
+
+/**
+* Aplica uma ação conforme a prioridade dela.
+*/
+void acao_enviar(acao_t acao){
+ item_playlist_t item = {acao.clip, 1, 0, TRANSICAO_PADRAO_MS};
+ switch(acao.prioridade){
+  case PRIORIDADE_IMEDIATA:
+     playlist_tamanho = 0;
+     modo_playlist = false;
+     player_parar(false);
+     audio_desligar();
+     jogo_parar();
+     rede_pausar();
+     break;
+  case PRIORIDADE_SUBSTITUI:
+     break;
+  case PRIORIDADE_FILA:
+     if(player.ativo){
+         if(playlist_tamanho < TAMANHO_PLAYLIST){
+             playlist[(playlist_inicio + playlist_tamanho) % TAMANHO_PLAYLIST] = item;
+             playlist_tamanho++;
+            }
+         return;
+        }
+     break;
+ }
+ if(acao.clip)
+     player_iniciar(&item);
+ if(acao.executar)
+     acao.executar();
+}
+
+/**
+* Liga o modo playlist: a sequência toca em ciclo até alguma ação imediata (cor ou apagar).
+*/
+void modo_playlist_ligar(const item_playlist_t *sequencia, uint8_t tamanho){
+ sequencia_automatica = sequencia;
+ sequencia_tamanho = tamanho;
+ sequencia_indice = 0;
+ modo_playlist = true;
+ if(!player.ativo)
+     player_iniciar(playlist_retirar());
+}
+
+void modo_playlist_desligar(void){
+ modo_playlist = false; //O item atual termina normalmente
+}
+
+//Clipes: animação (com o tempo de cada quadro) e som
+const clip_t clip_Bia = {&anim_bia, .interpolar = true, .curva = CURVA_SUAVE};
+const clip_t clip_Lorenzo = {&anim_lorenzo};
+const clip_t clip_vini = {&anim_vini};
+const clip_t clip_ruan = {&anim_ruan};
+const clip_t clip_vinicobra = {&anim_vinicobra, .ao_mostrar_quadro = som_vinicobra};
+const clip_t clip_vinitetris = {&anim_vinitetris, .musica = &musica_tetris}; //200 ms de nota + 200 ms sem música
+const clip_t clip_joao = {&anim_joao};
+const clip_t clip_vinibrasil = {&anim_vinibrasil, .musica = &musica_hino_nacional}; //50 ms de nota + 200 ms sem música
+const clip_t clip_filipe_bubble = {&anim_filipe_bubble};
+const clip_t clip_filipe_pong = {&anim_filipe_pong};
+const clip_t clip_pong = {.script = &script_pong};   //Desenhados pela VM (scripts/*.vms)
+const clip_t clip_chuva = {.script = &script_chuva};
+
+// Sequência do modo playlist: clipe, repetições, duração (0 = pelas repetições) e transição
+#define MODO_PLAYLIST_AO_LIGAR 0 //1 para painéis sem ninguém: a sequência começa sozinha
+const item_playlist_t sequencia_padrao[] = {
+ {&clip_Bia, 2, 0, 400},
+ {&clip_Lorenzo, 1, 0, 400},
+ {&clip_vini, 1, 0, 400},
+ {&clip_ruan, 1, 0, 400},
+ {&clip_vinicobra, 1, 0, 400},
+ {&clip_vinitetris, 1, 0, 400},
+ {&clip_joao, 2, 0, 400},
+ {&clip_vinibrasil, 1, 0, 400},
+ {&clip_filipe_bubble, 0, 15000, 400},
+ {&clip_filipe_pong, 2, 0, 400}
 };
 
-double animacao_filipe_bubble[18][NUM_LEDS][3]={
-    { // Quadro 1
-        {0.0, 1.0, 0.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {0.0, 1.0, 0.0},
-        {0.0, 0.0, 1.0}, {0.0, 1.0, 0.0}, {1.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 1.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}
-    },
-    { // Quadro 2
-        {0.0, 1.0, 0.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {0.0, 1.0, 0.0},
-        {0.0, 0.0, 1.0}, {0.0, 1.0, 0.0}, {1.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 1.0},
-        {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}
-    },
-    { // Quadro 3
-        {0.0, 1.0, 0.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {0.0, 1.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {1.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 1.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}
-    },
-    { // Quadro 4
-        {0.0, 1.0, 0.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {0.0, 1.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {1.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 1.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}
-    },
-    { // Quadro 5
-        {0.0, 1.0, 0.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {0.0, 1.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {1.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 1.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 1.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}
-    },
-    { // Quadro 6
-        {0.0, 1.0, 0.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {0.0, 1.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {1.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}
-    },
-    { // Quadro 7
-        {0.0, 1.0, 0.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {0.0, 1.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {1.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}
-    },
-    { // Quadro 8
-        {0.0, 1.0, 0.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {0.0, 1.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {1.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}
-    },
-    { // Quadro 9
-        {0.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}
-    },
-    { // Quadro 10
-        {0.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}
-    },
-    { // Quadro 11
-        {0.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}
-    },
-    { // Quadro 12
-        {0.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}
-    },
-    { // Quadro 13
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}
-    },
-    { // Quadro 14
-        {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0},
-        {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0},
-        {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0},
-        {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0},
-        {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}
-    },
-    { // Quadro 15
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}
-    },
-    { // Quadro 16
-        {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0},
-        {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0},
-        {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0},
-        {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0},
-        {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}
-    },
-    { // Quadro 17
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0},
-        {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}
-    },
-    { // Quadro 18
-        {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0},
-        {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0},
-        {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0},
-        {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0},
-        {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}, {1.0, 1.0, 1.0}
-    },
+// Clipe de cada tecla numérica
+const clip_t *clip_da_tecla(char tecla){
+ switch (tecla) {
+  case '1': return &clip_Bia;
+  case '2': return &clip_Lorenzo;
+  case '3': return &clip_vini;
+  case '4': return &clip_ruan;
+  case '5': return &clip_vinicobra;
+  case '6': return &clip_vinitetris;
+  case '7': return &clip_joao;
+  case '8': return &clip_vinibrasil;
+  case '9': return &clip_filipe_bubble;
+  case '0': return &clip_filipe_pong;
+  default: return NULL;
+ }
+}
+
+// Transforma os eventos do teclado em ações
+void tratar_tecla(const evento_tecla_t *ev){
+    char tecla = ev->tipo == TECLA_PRESSIONADA ? ev->tecla : 'n';
+
+    // Com um jogo rodando, os números são os controles (segurar repete o movimento)
+    if (jogo.ativo && ev->tipo != TECLA_SOLTA && !(ev->tipo == TECLA_ACORDE && ev->tecla2 == '*') &&
+        jogo_tecla(ev->tecla, ev->instante_us))
+        return;
+
+    if (ev->tipo == TECLA_LONGA && ev->tecla == '*') { // Segurar * evita gravar por engano
+        printf("Reiniciando para modo de gravação...\n");
+        reset_usb_boot(0, 0);
+    }else if (ev->tipo == TECLA_LONGA && ev->tecla == 'D') { // Segurar D liga o modo áudio
+        acao_enviar((acao_t){PRIORIDADE_IMEDIATA, NULL, audio_ligar});
+        printf("Modo áudio ligado\n");
+    }else if (ev->tipo == TECLA_LONGA && (ev->tecla == 'A' || ev->tecla == 'B' || ev->tecla == 'C')) {
+        // Segurar A, B ou C começa o snake, o pong ou os blocos
+        acao_enviar((acao_t){PRIORIDADE_IMEDIATA, NULL,
+                             ev->tecla == 'A' ? jogo_cobra_iniciar : ev->tecla == 'B' ? jogo_pong_iniciar : jogo_blocos_iniciar});
+    }else if (ev->tipo == TECLA_ACORDE && ev->tecla2 == '*' && ev->tecla == 'A') {
+        npSetDither(!dither_ativo); // * + A liga e desliga o dithering temporal
+        printf("Dithering %s\n", dither_ativo ? "ligado" : "desligado");
+    }else if (ev->tipo == TECLA_ACORDE && ev->tecla2 == '*' && ev->tecla == 'C') {
+        rotacao_paleta_ms = rotacao_paleta_ms ? 0 : ROTACAO_PALETA_MS; // * + C liga e desliga a rotação de cores
+        player.rotacao_us = base_tempo_decorrido_us();
+        if (!rotacao_paleta_ms)
+            paleta_restaurar();
+    }else if (ev->tipo == TECLA_ACORDE && ev->tecla2 == '*' && ev->tecla == '#') {
+        if (modo_playlist) // * + # liga e desliga o modo playlist
+            modo_playlist_desligar();
+        else
+            modo_playlist_ligar(sequencia_padrao, sizeof(sequencia_padrao) / sizeof(item_playlist_t));
+        printf("Modo playlist %s\n", modo_playlist ? "ligado" : "desligado");
+    }else if (ev->tipo == TECLA_ACORDE && ev->tecla2 == '*' && (ev->tecla == 'B' || ev->tecla == 'D')) {
+        // * + B e * + D tocam os scripts da VM
+        acao_enviar((acao_t){PRIORIDADE_SUBSTITUI, ev->tecla == 'B' ? &clip_pong : &clip_chuva, NULL});
+    }else if (ev->tipo == TECLA_ACORDE && ev->tecla2 == '*' && clip_da_tecla(ev->tecla)) {
+        printf("Na playlist: %c\n", ev->tecla); // * + número põe a animação na playlist
+        acao_enviar((acao_t){PRIORIDADE_FILA, clip_da_tecla(ev->tecla), NULL});
+    }else if (tecla != 'n' && tecla != '*'){
+        printf("Tecla pressionada: %c\n", tecla);
+        // Executa ações baseadas na tecla
+        switch (tecla) {
+        case 'A':
+            acao_enviar((acao_t){PRIORIDADE_IMEDIATA, NULL, desligarTodosOsLeds});
+            break;
+        case 'B':
+            acao_enviar((acao_t){PRIORIDADE_IMEDIATA, NULL, ligarLEDsAzuis});
+            break;
+        case 'C':
+            acao_enviar((acao_t){PRIORIDADE_IMEDIATA, NULL, ligarLEDsVermelhos});
+            break;
+        case 'D':
+            acao_enviar((acao_t){PRIORIDADE_IMEDIATA, NULL, ligarLEDsVerdes});
+            break;
+        case '#':
+            acao_enviar((acao_t){PRIORIDADE_IMEDIATA, NULL, ligarLEDsBrancos});
+            break;
+        default: // Números: a animação substitui a que estiver tocando
+            acao_enviar((acao_t){PRIORIDADE_SUBSTITUI, clip_da_tecla(tecla), NULL});
+            break;
+        }
+    }
+}
+
+// Script pela serial: uma linha "vm <quadro_ms> <quadros> <semente> <cores> <bytecode>",
+// com as cores em RRGGBB separadas por vírgula e o bytecode em hexadecimal, como a que
+// scripts/montar_scripts.py --serial imprime. O script é conferido, fica na RAM até
+// chegar outro e substitui o clipe que estiver tocando. A linha "boot" mostra a linha do
+// tempo do boot, e "consumo" mostra o consumo estimado do quadro atual.
+#define LINHA_SERIAL_MAX (2 * SCRIPT_MAX_BYTES + 32 + 7 * SCRIPT_MAX_CORES)
+void boot_relatorio(void);
+
+char linha_serial[LINHA_SERIAL_MAX];
+uint linha_serial_tamanho;
+bool linha_serial_estourou;
+uint8_t script_serial_codigo[SCRIPT_MAX_BYTES];
+uint8_t script_serial_paleta[SCRIPT_MAX_CORES][3];
+script_t script_serial = {.nome = "serial", .codigo = script_serial_codigo, .paleta = script_serial_paleta};
+const clip_t clip_script_serial = {.script = &script_serial};
+
+static int hex_digito(char c){
+ if(c >= '0' && c <= '9') return c - '0';
+ if(c >= 'a' && c <= 'f') return c - 'a' + 10;
+ if(c >= 'A' && c <= 'F') return c - 'A' + 10;
+ return -1;
+}
+
+// Lê um byte em hexadecimal; false se não houver dois dígitos
+static bool hex_byte(const char **p, uint8_t *byte){
+ int alto = hex_digito((*p)[0]), baixo = alto < 0 ? -1 : hex_digito((*p)[1]);
+ if(baixo < 0)
+     return false;
+ *byte = alto << 4 | baixo;
+ *p += 2;
+ return true;
+}
+
+/**
+* Carrega no script_serial a linha recebida; false se ela estiver mal formada ou o
+* bytecode não passar em vm_validar.
+*/
+bool script_serial_carregar(const char *linha){
+ unsigned quadro_ms, quadros;
+ unsigned long semente;
+ int pos = 0;
+ if(sscanf(linha, "vm %u %u %lu %n", &quadro_ms, &quadros, &semente, &pos) != 3 || !pos)
+     return false;
+ if(quadro_ms < 1 || quadro_ms > 65535 || quadros < 1 || quadros > 65535)
+     return false;
+ if(player.ativo && player.item.clip == &clip_script_serial)
+     player_parar(false); //O código vai ser sobrescrito
+ script_serial.tamanho = 0;
+
+ const char *p = linha + pos;
+ uint num_cores = 0;
+ do{
+     if(num_cores == SCRIPT_MAX_CORES)
+         return false;
+     uint8_t rgb[3];
+     for(int c = 0; c < 3; c++)
+         if(!hex_byte(&p, &rgb[c]))
+             return false;
+     script_serial_paleta[num_cores][0] = rgb[1]; //Paleta em GRB, como as geradas
+     script_serial_paleta[num_cores][1] = rgb[0];
+     script_serial_paleta[num_cores][2] = rgb[2];
+     num_cores++;
+    }while(*p++ == ',');
+ if(p[-1] != ' ')
+     return false;
+
+ uint tamanho = 0;
+ while(hex_digito(*p) >= 0){
+     if(tamanho == SCRIPT_MAX_BYTES || !hex_byte(&p, &script_serial_codigo[tamanho]))
+         return false;
+     tamanho++;
+    }
+ if(*p != '\0' || !vm_validar(script_serial_codigo, tamanho))
+     return false;
+ script_serial.tamanho = tamanho;
+ script_serial.num_cores = num_cores;
+ script_serial.quadro_ms = quadro_ms;
+ script_serial.num_quadros = quadros;
+ script_serial.semente = semente;
+ return true;
+}
+
+/**
+* Lê o que chegou pela serial, sem esperar, e trata cada linha completa.
+*/
+void serial_receber(void){
+ int c;
+ while((c = getchar_timeout_us(0)) != PICO_ERROR_TIMEOUT){
+     if(c != '\r' && c != '\n'){
+         if(linha_serial_tamanho < LINHA_SERIAL_MAX - 1)
+             linha_serial[linha_serial_tamanho++] = c;
+         else
+             linha_serial_estourou = true;
+         continue;
+        }
+     if(!linha_serial_tamanho)
+         continue;
+     linha_serial[linha_serial_tamanho] = '\0';
+     if(linha_serial_estourou){
+         printf("Linha longa demais (máximo %d caracteres)\n", LINHA_SERIAL_MAX - 1);
+        }else if(!strncmp(linha_serial, "vm ", 3)){
+         if(script_serial_carregar(linha_serial)){
+             printf("Script carregado: %u bytes\n", script_serial.tamanho);
+             acao_enviar((acao_t){PRIORIDADE_SUBSTITUI, &clip_script_serial, NULL});
+            }else{
+             printf("Script inválido\n");
+            }
+        }else if(!strcmp(linha_serial, "boot")){
+         boot_relatorio();
+        }else if(!strcmp(linha_serial, "consumo")){
+         printf("Consumo estimado: %lu mA (limite %d mA)\n", (unsigned long)consumo_estimado_ma(), LIMITE_CORRENTE_MA);
+        }
+     linha_serial_tamanho = 0;
+     linha_serial_estourou = false;
+    }
+}
+
+// Chamada pela stdio quando chegam caracteres: acorda o modo ocioso como uma tecla
+static void serial_chegou(void *param){
+ ocioso_sinalizar_tecla();
+}
+
+// Boot: o quadro de boot vai para o fio logo depois de npInit, antes da USB e do rádio. O
+// que é lento fica para boot_tick, que roda no laço principal uma etapa por volta, depois
+// que o quadro já travou nos LEDs. Cada passo deixa uma marca com o instante em us desde
+// que o timer começou a contar (na inicialização do SDK, antes do main; só a ROM e o boot2
+// ficam de fora).
+#define BOOT_MARCAS_MAX 12
+#define BOOT_CLIPE NULL //Ou um clipe (&clip_chuva, por exemplo) para tocar logo depois do quadro
+
+// Quadro de boot em RGB, como a matriz é vista de frente. Fraco de propósito: antes de a
+// USB enumerar, a porta do computador só garante 100 mA
+static const uint8_t quadro_boot[NUM_LEDS][3] = {
+ {0, 0, 24}, {0, 0, 24}, {0, 0, 24}, {0, 0, 24}, {0, 0, 24},
+ {0, 0, 24}, {0, 0, 0},  {0, 0, 0},  {0, 0, 0},  {0, 0, 24},
+ {0, 0, 24}, {0, 0, 0},  {16, 16, 16}, {0, 0, 0}, {0, 0, 24},
+ {0, 0, 24}, {0, 0, 0},  {0, 0, 0},  {0, 0, 0},  {0, 0, 24},
+ {0, 0, 24}, {0, 0, 24}, {0, 0, 24}, {0, 0, 24}, {0, 0, 24},
 };
 
-//Função principal
-int main() {
-     char tecla;
+typedef enum {
+ BOOT_CLIPE_INICIAL, // Clipe de boot ou playlist: barato, e a matriz já começa a animar
+ BOOT_STDIO,         // USB (CDC) e UART
+ BOOT_REDE,          // cyw43_arch_init carrega o firmware do rádio e segura o laço
+ BOOT_PRONTO
+} boot_etapa_t;
+
+typedef struct {
+ const char *nome;
+ uint32_t instante_us;
+} boot_marca_t;
+
+boot_marca_t boot_marcas[BOOT_MARCAS_MAX];
+uint boot_num_marcas;
+boot_etapa_t boot_etapa;
+absolute_time_t boot_luz; // Quando o quadro de boot termina de travar nos LEDs
+bool boot_luz_marcada;
+
+void boot_marcar_em(const char *nome, uint32_t instante_us){
+ if(boot_num_marcas < BOOT_MARCAS_MAX)
+     boot_marcas[boot_num_marcas++] = (boot_marca_t){nome, instante_us};
+}
+
+void boot_marcar(const char *nome){
+ boot_marcar_em(nome, time_us_32());
+}
+
+/**
+* Desenha o quadro de boot e o manda para o fio. Chamada antes de ligar o dithering e o
+* compositor, então npWrite dispara o DMA na hora.
+*/
+void boot_quadro_mostrar(void){
+ for(uint i = 0; i < NUM_LEDS; i++)
+     np_desenhar(correcao_index(i), quadro_boot[i][0] << 8, quadro_boot[i][1] << 8, quadro_boot[i][2] << 8);
+ npWrite();
+ boot_luz = np_livre_em;
+ boot_marcar("quadro de boot no fio");
+}
+
+/**
+* Mostra na serial a linha do tempo do boot.
+*/
+void boot_relatorio(void){
+ for(uint i = 0; i < boot_num_marcas; i++)
+     printf("Boot: %8lu us  %s\n", (unsigned long)boot_marcas[i].instante_us, boot_marcas[i].nome);
+}
+
+/**
+* Como player_tick: executa uma etapa da inicialização adiada por volta do laço, depois que
+* o quadro de boot travou nos LEDs. Retorna true enquanto falta alguma.
+*/
+bool boot_tick(absolute_time_t *prazo){
+ if(boot_etapa == BOOT_PRONTO)
+     return false;
+ if(!time_reached(boot_luz)){
+     if(absolute_time_diff_us(boot_luz, *prazo) > 0)
+         *prazo = boot_luz;
+     return true;
+    }
+ if(!boot_luz_marcada){
+     boot_marcar_em("quadro de boot nos LEDs", (uint32_t)to_us_since_boot(boot_luz));
+     boot_luz_marcada = true;
+    }
+ switch(boot_etapa){
+ case BOOT_CLIPE_INICIAL:
+     if(MODO_PLAYLIST_AO_LIGAR)
+         modo_playlist_ligar(sequencia_padrao, sizeof(sequencia_padrao) / sizeof(item_playlist_t));
+     else if(BOOT_CLIPE)
+         acao_enviar((acao_t){PRIORIDADE_SUBSTITUI, BOOT_CLIPE, NULL});
+     boot_marcar("clipe de boot");
+     break;
+ case BOOT_STDIO:
      stdio_init_all();
+     stdio_set_chars_available_callback(serial_chegou, NULL);
+     boot_marcar("stdio");
+     break;
+ case BOOT_REDE:
+#if REDE_WIFI
+     rede_iniciar();
+     boot_marcar("rede");
+#endif
+     break;
+ default:
+     break;
+    }
+ boot_etapa++;
+ if(boot_etapa != BOOT_PRONTO){
+     *prazo = get_absolute_time(); //A próxima etapa na volta seguinte, depois das teclas
+     return true;
+    }
+ boot_marcar("pronto");
+ boot_relatorio();
+ return false;
+}
+
+//Função principal (ferramentas como o benchmark incluem este arquivo com LED_MATRIX_SEM_MAIN
+//e usam o próprio main)
+#ifndef LED_MATRIX_SEM_MAIN
+int main() {
+     boot_marcar("main");
      npInit(MATRIZ_PIN);
+     boot_quadro_mostrar(); //Antes de tudo: a matriz acende poucos ms depois do reset
+     npSetDither(DITHER_ATIVO_PADRAO);
+     compositor_ativar();
+     camada_configurar(CAMADA_INTERFACE, MISTURA_NORMAL, 255, true);
 
      gpio_init(BUZZER); // Inicializa o pino do buzzer
      gpio_set_dir(BUZZER, GPIO_OUT);
+     tomInit(BUZZER);
 
      // Configuração dos pinos das colunas como saídas digitais
     for (int i = 0; i < 4; i++)
@@ -1842,65 +3483,31 @@ int main() {
 
 
     
+    teclado_iniciar();
+    boot_marcar("teclado");
+    // USB, rádio e playlist ficam para boot_tick, já no laço
+    
     while (true) {
-        tecla = leitura_teclado();
-
-        // Lê a tecla pressionada
-        if (tecla == '*') {
-        printf("Reiniciando para modo de gravação...\n");
-        reset_usb_boot(0, 0);
-        }else if (tecla != 'n'){
-            printf("Tecla pressionada: %c\n", tecla);
-                // Executa ações baseadas na tecla 
-                switch (tecla) {
-                case '1': //printf("Yay, caso 1\n");
-                    gerar_animacao(animacao_Bia, 5, 500); //Nome da aniimação, n de frames, fps , pio, sn
-                    break;
-                case '2': 
-                    gerar_animacao(animacao_Lorenzo, 5, 1000); //Nome da aniimação, n de frames, fps , pio, sn
-                    break;
-                case '3': 
-                    gerar_animacao(animacao_vini, 29, 500); //Nome da aniimação, n de frames, fps , pio, sn
-                    break;
-                case '4':
-                    gerar_animacao(animacao_ruan, 5, 1000); //Nome da aniimação, n de frames, fps , pio, sn
-                    break;
-                case '5':
-                    gerar_animacao_com_som(animacao_vinicobra, 26, 400); //Nome da aniimação, n de frames, fps , pio, sn
-                    break;
-                case '6':
-                    gerar_animacao_com_som_tetris(animacao_vinitetris, 48);
-                    break;
-                case '7':
-                    gerar_animacao(animacao_joao, 8, 500); //Nome da aniimação, n de frames, fps , pio, sn
-                    break;
-                case '8':
-                    gerar_animacao_com_som_brasil(animacao_vinibrasil, 30); //Nome da aniimação, n de frames, fps , pio, sn
-                    break;
-                case '9':
-                    gerar_animacao(animacao_filipe_bubble, 18, 500); //Nome da animação, n de frames, fps , pio, sn
-                    break;
-                case '0':
-                    gerar_animacao(animacao_filipe_pong, 17, 500); //Nome da animação, n de frames, fps , pio, sn
-                    break;
-                case 'A':
-                    desligarTodosOsLeds();
-                    break;
-                case 'B':
-                    ligarLEDsAzuis();
-                    break;
-                case 'C':
-                    ligarLEDsVermelhos();
-                    break;
-                case 'D':
-                    ligarLEDsVerdes();
-                    break;
-                case '#': 
-                    ligarLEDsBrancos();
-                default: break;
-                }
-            }
-     sleep_ms(150);
+        evento_tecla_t ev;
+        while (teclado_proximo_evento(&ev))
+            tratar_tecla(&ev);
+        serial_receber();
+
+        // Avança a animação; quando ela termina, o player já emenda a próxima da playlist
+        absolute_time_t prazo = at_the_end_of_time;
+        bool iniciando = boot_tick(&prazo);
+        player_tick(&prazo);
+        audio_tick(&prazo);
+        jogo_tick(&prazo);
+        rede_tick(&prazo);
+        clock_perfil_aplicar(perfil_para_carga()); // Só troca quando a carga muda
+
+        // Com o rádio ligado não dá para parar os clocks: o laço só espera
+        if (!iniciando && !player.ativo && !audio.ativo && !jogo.ativo && !rede.ativo && !rede.wifi && teclado_solto())
+            ocioso_aguardar_tecla(); // Nada tocando: dorme até a próxima tecla
+        else
+            best_effort_wfe_or_timeout(prazo); // Acorda no próximo quadro ou no próximo evento
     }
  return 0;//Teoricamente, nunca chega aqui por causa do loop infinito
-}
\ No newline at end of file
+}
+#endif
@@ -0,0 +1,38 @@
+#ifndef _LWIPOPTS_H
+#define _LWIPOPTS_H
+
+// lwIP da entrada de quadros pela rede (E1.31 e DDP): sem sistema operacional, chamado
+// pelo laço principal (pico_cyw43_arch_lwip_poll). Só UDP, DHCP e IGMP para o multicast
+// dos universos E1.31; sem TCP.
+#define NO_SYS                      1
+#define LWIP_SOCKET                 0
+#define LWIP_NETCONN                0
+#define MEM_LIBC_MALLOC             0
+#define MEM_ALIGNMENT               4
+#define MEM_SIZE                    4000
+#define PBUF_POOL_SIZE              16
+#define MEMP_NUM_UDP_PCB            4
+#define MEMP_NUM_ARP_QUEUE          10
+
+#define LWIP_ARP                    1
+#define LWIP_ETHERNET               1
+#define LWIP_IPV4                   1
+#define LWIP_ICMP                   1
+#define LWIP_RAW                    1
+#define LWIP_UDP                    1
+#define LWIP_TCP                    0
+#define LWIP_DHCP                   1
+#define LWIP_IGMP                   1
+#define DHCP_DOES_ARP_CHECK         0
+#define LWIP_DHCP_DOES_ACD_CHECK    0
+
+#define LWIP_NETIF_STATUS_CALLBACK  1
+#define LWIP_NETIF_LINK_CALLBACK    1
+#define LWIP_NETIF_HOSTNAME         1
+#define LWIP_NETIF_TX_SINGLE_PBUF   1
+#define LWIP_CHKSUM_ALGORITHM       3
+
+#define LWIP_STATS                  0
+#define LWIP_DEBUG                  0
+
+#endif
@@ -0,0 +1,337 @@
+#!/usr/bin/env python3
+"""Monta os scripts de animação (.vms) em bytecode para a máquina virtual do firmware.
+
+Uso: montar_scripts.py <pasta de saída> <arquivo.vms>...
+     montar_scripts.py --serial <arquivo.vms>
+
+Na primeira forma gera scripts.c/.h, com um script const (fica na flash) por arquivo e o
+formato das instruções que o firmware usa para conferir scripts recebidos. Com --serial
+imprime a linha que carrega o script pela serial, sem regravar o firmware.
+
+Em vez de guardar cada quadro, o script desenha: a cada tick do player a VM executa
+instruções até um ESPERAR, e o que estiver na tela vira o quadro. Formato do .vms (o que
+vem depois de '#' ou ';' é comentário):
+
+    quadro_ms 150         duração de um tick
+    quadros 200           duração do clipe, em ticks (o script recomeça a cada repetição)
+    semente 7             semente do gerador aleatório (mesma semente, mesmos quadros)
+    cor . 000000          símbolo e cor RRGGBB; a ordem é a da paleta (índice 0, 1, ...)
+    rotulo:               destino de saltos
+    pixel r0, 4, g        instrução e operandos separados por vírgula
+
+Operandos: r0..r7 (registradores de 16 bits), números de -64 a 63 e símbolos de cor. Em
+coordenadas, x vai da esquerda para a direita e y de cima para baixo, de 0 a 4, como a
+matriz é vista de frente; o que cair fora da matriz é ignorado.
+
+Instruções:
+
+    fim                   para o script; o último quadro fica até o fim do clipe
+    esperar n             termina o tick e dorme n ticks (1 = volta no próximo)
+    preencher c           pinta a tela toda com a cor c
+    pixel x, y, c         pinta um LED
+    retangulo x, y, l, a, c
+    deslocar dx, dy       move a tela; o que entra pela borda fica com a cor 0
+    rolar dx, dy          move a tela; o que sai por uma borda entra pela outra
+    def r, v              r = v
+    soma r, v             r = r + v
+    sub r, v              r = r - v
+    aleat r, n            r = número aleatório de 0 a n - 1
+    ler r, x, y           r = cor do LED (0 fora da matriz)
+    saltar rotulo
+    laco r, rotulo        r = r - 1; salta se r não chegou a 0
+    se_igual a, b, rotulo salta se a == b
+    se_menor a, b, rotulo salta se a < b
+
+No bytecode cada instrução é um byte de código seguido dos operandos: um byte por valor
+(bit 7 ligado: registrador nos bits 0-2; desligado: número de 7 bits com sinal) e dois
+bytes, menos significativo primeiro, por rótulo.
+"""
+
+import os
+import re
+import sys
+
+LADO = 5
+MAX_CORES = 16
+MAX_BYTES = 1024
+REGISTRADORES = 8
+
+# Código e operandos de cada instrução: r = registrador, v = valor, a = endereço. A ordem
+# define o número da instrução, usado pelo firmware através do enum gerado.
+INSTRUCOES = [
+    ("fim", ""),
+    ("esperar", "v"),
+    ("preencher", "v"),
+    ("pixel", "vvv"),
+    ("retangulo", "vvvvv"),
+    ("deslocar", "vv"),
+    ("rolar", "vv"),
+    ("def", "rv"),
+    ("soma", "rv"),
+    ("sub", "rv"),
+    ("aleat", "rv"),
+    ("ler", "rvv"),
+    ("saltar", "a"),
+    ("laco", "ra"),
+    ("se_igual", "vva"),
+    ("se_menor", "vva"),
+]
+CODIGOS = {nome: (n, operandos) for n, (nome, operandos) in enumerate(INSTRUCOES)}
+
+
+class ErroScript(Exception):
+    pass
+
+
+class Script:
+    def __init__(self, caminho):
+        self.caminho = caminho
+        base = os.path.splitext(os.path.basename(caminho))[0]
+        if not re.fullmatch(r"[a-z][a-z0-9_]*", base):
+            raise ErroScript(f"{caminho}: nome deve ser um identificador C em minúsculas")
+        self.nome = base
+        self.quadro_ms = None
+        self.num_quadros = None
+        self.semente = 1
+        self.cores = {}
+        self.instrucoes = []  # (linha, nome, [operandos em texto])
+        self.rotulos = {}
+        self.codigo = []
+
+    def erro(self, linha, mensagem):
+        raise ErroScript(f"{self.caminho}:{linha}: erro: {mensagem}")
+
+    def ler(self):
+        endereco = 0
+        with open(self.caminho, encoding="utf-8") as arquivo:
+            for numero, texto in enumerate(arquivo, 1):
+                texto = re.split(r"[#;]", texto, 1)[0].strip()
+                while True:
+                    rotulo = re.match(r"([A-Za-z_][A-Za-z0-9_]*):\s*", texto)
+                    if not rotulo:
+                        break
+                    if rotulo.group(1) in self.rotulos:
+                        self.erro(numero, f"rótulo '{rotulo.group(1)}' definido duas vezes")
+                    self.rotulos[rotulo.group(1)] = endereco
+                    texto = texto[rotulo.end():]
+                if not texto:
+                    continue
+                palavras = texto.split(None, 1)
+                comando = palavras[0].lower()
+                resto = palavras[1] if len(palavras) > 1 else ""
+
+                if comando == "quadro_ms":
+                    self.quadro_ms = self.inteiro(numero, comando, resto, 1, 65535)
+                elif comando == "quadros":
+                    self.num_quadros = self.inteiro(numero, comando, resto, 1, 65535)
+                elif comando == "semente":
+                    self.semente = self.inteiro(numero, comando, resto, 1, 0xFFFFFFFF)
+                elif comando == "cor":
+                    campos = resto.split()
+                    if len(campos) != 2 or not re.fullmatch(r"[0-9a-fA-F]{6}", campos[1]):
+                        self.erro(numero, "uso: cor <símbolo> <RRGGBB>")
+                    if campos[0] in self.cores:
+                        self.erro(numero, f"cor '{campos[0]}' definida duas vezes")
+                    if len(self.cores) == MAX_CORES:
+                        self.erro(numero, f"mais de {MAX_CORES} cores na paleta")
+                    valor = int(campos[1], 16)
+                    self.cores[campos[0]] = ((valor >> 16) & 0xFF, (valor >> 8) & 0xFF, valor & 0xFF)
+                elif comando in CODIGOS:
+                    operandos = [o.strip() for o in resto.split(",")] if resto.strip() else []
+                    formato = CODIGOS[comando][1]
+                    if len(operandos) != len(formato):
+                        self.erro(numero, f"'{comando}' espera {len(formato)} operandos, recebeu {len(operandos)}")
+                    self.instrucoes.append((numero, comando, operandos))
+                    endereco += 1 + sum(2 if f == "a" else 1 for f in formato)
+                else:
+                    self.erro(numero, f"comando desconhecido '{comando}'")
+        if self.quadro_ms is None:
+            self.erro("fim", "falta quadro_ms")
+        if self.num_quadros is None:
+            self.erro("fim", "falta quadros")
+        if not self.cores:
+            self.erro("fim", "falta ao menos uma cor")
+        if not self.instrucoes:
+            self.erro("fim", "script sem instruções")
+        if endereco > MAX_BYTES:
+            self.erro("fim", f"bytecode com {endereco} bytes, o máximo é {MAX_BYTES}")
+        self.montar()
+
+    def inteiro(self, numero, comando, texto, minimo, maximo):
+        if not texto.strip().isdigit():
+            self.erro(numero, f"uso: {comando} <número>")
+        valor = int(texto)
+        if not minimo <= valor <= maximo:
+            self.erro(numero, f"{comando} fora do intervalo {minimo}..{maximo}")
+        return valor
+
+    def registrador(self, numero, texto):
+        encontrado = re.fullmatch(r"r([0-9]+)", texto.lower())
+        if not encontrado or int(encontrado.group(1)) >= REGISTRADORES:
+            return None
+        return int(encontrado.group(1))
+
+    def valor(self, numero, texto):
+        registrador = self.registrador(numero, texto)
+        if registrador is not None:
+            return 0x80 | registrador
+        if texto in self.cores:
+            return list(self.cores).index(texto)
+        if not re.fullmatch(r"-?[0-9]+", texto):
+            self.erro(numero, f"operando inválido '{texto}'")
+        valor = int(texto)
+        if not -64 <= valor <= 63:
+            self.erro(numero, f"número {valor} fora do intervalo -64..63 (use um registrador)")
+        return valor & 0x7F
+
+    def montar(self):
+        for numero, comando, operandos in self.instrucoes:
+            codigo, formato = CODIGOS[comando]
+            self.codigo.append(codigo)
+            for tipo, texto in zip(formato, operandos):
+                if tipo == "r":
+                    registrador = self.registrador(numero, texto)
+                    if registrador is None:
+                        self.erro(numero, f"'{texto}' não é um registrador (r0..r{REGISTRADORES - 1})")
+                    self.codigo.append(registrador)
+                elif tipo == "v":
+                    self.codigo.append(self.valor(numero, texto))
+                else:
+                    if texto not in self.rotulos:
+                        self.erro(numero, f"rótulo '{texto}' não definido")
+                    destino = self.rotulos[texto]
+                    self.codigo += [destino & 0xFF, destino >> 8]
+
+    def paleta_grb(self):
+        return [(g, r, b) for (r, g, b) in self.cores.values()]
+
+    def linha_serial(self):
+        """Linha do protocolo de carga: vm <quadro_ms> <quadros> <semente> <cores> <bytecode>."""
+        cores = ",".join(f"{r:02x}{g:02x}{b:02x}" for (r, g, b) in self.cores.values())
+        bytecode = "".join(f"{b:02x}" for b in self.codigo)
+        return f"vm {self.quadro_ms} {self.num_quadros} {self.semente} {cores} {bytecode}"
+
+
+def gerar_cabecalho(scripts):
+    saida = [
+        "// Gerado por scripts/montar_scripts.py a partir de scripts/*.vms. Não editar.",
+        "#ifndef SCRIPTS_H",
+        "#define SCRIPTS_H",
+        "",
+        "#include <stdint.h>",
+        "",
+        f"#define SCRIPT_MAX_CORES {MAX_CORES}",
+        f"#define SCRIPT_MAX_BYTES {MAX_BYTES}",
+        f"#define VM_REGISTRADORES {REGISTRADORES}",
+        "",
+        "// Instruções da máquina virtual (a descrição de cada uma está em scripts/montar_scripts.py)",
+        "typedef enum {",
+    ]
+    saida += [f"    VM_{nome.upper()} = {n}," for n, (nome, _) in enumerate(INSTRUCOES)]
+    saida += [
+        f"    VM_NUM_INSTRUCOES = {len(INSTRUCOES)}",
+        "} vm_instrucao_t;",
+        "",
+        "// Operandos de cada instrução: r = registrador, v = valor, a = endereço (2 bytes)",
+        "#define VM_OPERANDOS { " + ", ".join(f'"{f}"' for _, f in INSTRUCOES) + " }",
+        "",
+        "typedef struct {",
+        "    const char *nome;",
+        "    const uint8_t *codigo;",
+        "    uint16_t tamanho;           // Bytes de código",
+        "    const uint8_t (*paleta)[3]; // Cores em G, R, B",
+        "    uint8_t num_cores;",
+        "    uint16_t quadro_ms;         // Duração de um tick",
+        "    uint16_t num_quadros;       // Duração do clipe, em ticks",
+        "    uint32_t semente;",
+        "} script_t;",
+    ]
+    for s in scripts:
+        saida += ["", f"extern const script_t script_{s.nome};"]
+    saida += [
+        "",
+        "// Todos os scripts, em ordem alfabética (para ferramentas que percorrem todos)",
+        f"#define NUM_SCRIPTS {len(scripts)}",
+        "extern const script_t *const scripts[NUM_SCRIPTS];",
+        "",
+        "#endif",
+        "",
+    ]
+    return "\n".join(saida)
+
+
+def gerar_fonte(scripts):
+    saida = [
+        "// Gerado por scripts/montar_scripts.py a partir de scripts/*.vms. Não editar.",
+        '#include "scripts.h"',
+    ]
+    for s in scripts:
+        saida += ["", f"static const uint8_t paleta_script_{s.nome}[{len(s.cores)}][3] = {{"]
+        for simbolo, (g, r, b) in zip(s.cores, s.paleta_grb()):
+            saida.append(f"    {{0x{g:02X}, 0x{r:02X}, 0x{b:02X}}}, // '{simbolo}'")
+        saida += ["};", "", f"static const uint8_t codigo_script_{s.nome}[{len(s.codigo)}] = {{"]
+        for i in range(0, len(s.codigo), 16):
+            saida.append("    " + ", ".join(f"0x{b:02X}" for b in s.codigo[i:i + 16]) + ",")
+        saida += [
+            "};",
+            "",
+            f"const script_t script_{s.nome} = {{",
+            f"    .nome = \"{s.nome}\",",
+            f"    .codigo = codigo_script_{s.nome},",
+            f"    .tamanho = {len(s.codigo)},",
+            f"    .paleta = paleta_script_{s.nome},",
+            f"    .num_cores = {len(s.cores)},",
+            f"    .quadro_ms = {s.quadro_ms},",
+            f"    .num_quadros = {s.num_quadros},",
+            f"    .semente = {s.semente}u,",
+            "};",
+        ]
+    saida += ["", "const script_t *const scripts[NUM_SCRIPTS] = {"]
+    saida += [f"    &script_{s.nome}," for s in scripts]
+    saida += ["};", ""]
+    return "\n".join(saida)
+
+
+def escrever_se_mudou(caminho, conteudo):
+    # Não mexe na data do arquivo quando nada mudou, para não recompilar à toa
+    try:
+        with open(caminho, encoding="utf-8") as arquivo:
+            if arquivo.read() == conteudo:
+                return
+    except FileNotFoundError:
+        pass
+    with open(caminho, "w", encoding="utf-8") as arquivo:
+        arquivo.write(conteudo)
+
+
+def main(argv):
+    if len(argv) == 3 and argv[1] == "--serial":
+        try:
+            script = Script(argv[2])
+            script.ler()
+        except ErroScript as erro:
+            print(erro, file=sys.stderr)
+            return 1
+        print(script.linha_serial())
+        return 0
+    if len(argv) < 3:
+        print("\n".join(__doc__.splitlines()[2:4]), file=sys.stderr)
+        return 2
+    pasta = argv[1]
+    try:
+        scripts = []
+        for caminho in sorted(argv[2:]):
+            script = Script(caminho)
+            script.ler()
+            scripts.append(script)
+    except ErroScript as erro:
+        print(erro, file=sys.stderr)
+        return 1
+    os.makedirs(pasta, exist_ok=True)
+    escrever_se_mudou(os.path.join(pasta, "scripts.h"), gerar_cabecalho(scripts))
+    escrever_se_mudou(os.path.join(pasta, "scripts.c"), gerar_fonte(scripts))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))